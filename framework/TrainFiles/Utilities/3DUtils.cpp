@@ -24,6 +24,7 @@
 #include <GL/glu.h>
 
 #include "3DUtils.H"
+#include "Mat4.h"
 
 #include <vector>
 using std::vector;
@@ -226,20 +227,36 @@ int getMouseLine(double& x1, double& y1, double& z1,
 								 double& x2, double& y2, double& z2)
 //===============================================================================
 {
-  int x = Fl::event_x();
-  int iy = Fl::event_y();
-
-  double mat1[16],mat2[16];		// we have to deal with the projection matrices
+  float mat1[16],mat2[16];		// we have to deal with the projection matrices
   int viewport[4];
 
   glGetIntegerv(GL_VIEWPORT, viewport);
-  glGetDoublev(GL_MODELVIEW_MATRIX,mat1);
-  glGetDoublev(GL_PROJECTION_MATRIX,mat2);
+  glGetFloatv(GL_MODELVIEW_MATRIX,mat1);
+  glGetFloatv(GL_PROJECTION_MATRIX,mat2);
+
+  return getMouseLine(Mat4(mat1), Mat4(mat2), viewport, x1, y1, z1, x2, y2, z2);
+}
+
+//*************************************************************************
+//
+// The same, from matrices the caller kept - no OpenGL calls at all
+//===============================================================================
+int getMouseLine(const Mat4& modelview, const Mat4& projection, const int viewport[4],
+								 double& x1, double& y1, double& z1,
+								 double& x2, double& y2, double& z2)
+//===============================================================================
+{
+  int x = Fl::event_x();
+  int iy = Fl::event_y();
 
   int y = viewport[3] - iy; // originally had an extra -1?
 
-  int i1 = gluUnProject((double) x, (double) y, .25, mat1, mat2, viewport, &x1, &y1, &z1);
-  int i2 = gluUnProject((double) x, (double) y, .75, mat1, mat2, viewport, &x2, &y2, &z2);
+  Vec3f p1, p2;
+  bool i1 = unProject(Vec3f((float) x, (float) y, .25f), modelview, projection, viewport, p1);
+  bool i2 = unProject(Vec3f((float) x, (float) y, .75f), modelview, projection, viewport, p2);
+
+  x1 = p1.x(); y1 = p1.y(); z1 = p1.z();
+  x2 = p2.x(); y2 = p2.y(); z2 = p2.z();
 
   return i1 && i2;
 }
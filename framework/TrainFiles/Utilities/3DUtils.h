@@ -100,6 +100,12 @@ void unsetupShadows(void);
 // this function gets that ray for you (well, it gets 2 points on the line)
 int getMouseLine(double& p1x, double& p1y, double& p1z,
 								 double& p2x, double& p2y, double& p2z);
+// the same, but from a camera you kept yourself rather than the one in
+// OpenGL, so it doesn't have to wait for the driver to read it back
+class Mat4;
+int getMouseLine(const Mat4& modelview, const Mat4& projection, const int viewport[4],
+								 double& p1x, double& p1y, double& p1z,
+								 double& p2x, double& p2y, double& p2z);
 			  
 //************************************************************************
 //
@@ -24,6 +24,7 @@
 *************************************************************************/
 
 #include "ArcBallCam.H"
+#include "Mat4.h"
 #include <math.h>
 
 #include <windows.h>
@@ -73,23 +74,42 @@ void ArcBallCam::setup(Fl_Gl_Window* _wind, float _fieldOfView, float _eyeZ,
 }
 
 
-void ArcBallCam::setProjection(bool doClear)
+void ArcBallCam::setProjection(bool doClear, double aspect)
 {
   glMatrixMode(GL_PROJECTION);
   if (doClear)
 	  glLoadIdentity();
 
   // Compute the aspect ratio so we don't distort things
-  double aspect = ((double) wind->w()) / ((double) wind->h());
-  gluPerspective(fieldOfView, aspect, .1, 1000);
+  if (aspect <= 0.0)
+	  aspect = ((double) wind->w()) / ((double) wind->h());
+  glMultMatrixf(getProjection(aspect).data());
 
   // Put the camera where we want it to be
   glMatrixMode(GL_MODELVIEW);
-  glLoadIdentity();
+  glLoadMatrixf(getModelview().data());
+}
+
+//**************************************************************************
+//
+// the perspective setProjection uses
+//==========================================================================
+Mat4 ArcBallCam::getProjection(double aspect) const
+//==========================================================================
+{
+	return Mat4::perspective(fieldOfView, (float) aspect, .1f, 1000.f);
+}
 
-  // Use the transformation in the ArcBall
-  glTranslatef(-eyeX, -eyeY, -eyeZ);
-  multMatrix();
+//**************************************************************************
+//
+// the camera position, then the rotation in the ArcBall
+//==========================================================================
+Mat4 ArcBallCam::getModelview() const
+//==========================================================================
+{
+	HMatrix m;
+	getMatrix(m);
+	return Mat4::translation(Vec3f(-eyeX, -eyeY, -eyeZ)) * Mat4((float*) m);
 }
 
 int ArcBallCam::handle(int e)
@@ -1,4 +1,5 @@
 #include "World.H"
+#include "TrackParser.h"
 
 #include <FL/fl_ask.h>
 
@@ -65,50 +66,32 @@ void breakString(char* str, std::vector<const char*>& words) {
 // first line: an integer with the number of control points
 // other lines: one line per control point
 // either 3 (X,Y,Z) numbers on the line, or 6 numbers (X,Y,Z, orientation)
+// the parsing is shared with the main program (see TrackParser.h), which
+// also allows # comments and doesn't limit the number of points
 void World::readPoints(const char* filename)
 {
-	FILE* fp = fopen(filename,"r");
-	if (!fp) {
-		fl_alert("Can't Open File!\n");
-	} else {
-		char buf[512];
-
-		// first line = number of points
-		fgets(buf,512,fp);
-		size_t npts = (size_t) atoi(buf);
+	try {
+		TrackParser parser(filename);
+
+		// read into a new list so a bad file leaves the old points alone
+		vector<ControlPoint> newPoints;
+		newPoints.reserve(parser.pointsToReserve());
+
+		TrackRow row;
+		while( parser.next(row) ) {
+			Pnt3f pos(row.pos);
+			Pnt3f orient(row.orient);
+			orient.normalize();
+			newPoints.push_back(ControlPoint(pos,orient));
+		}
 
-		if( (npts<4) || (npts>65535)) {
+		if (newPoints.size() < 4) {
 			fl_alert("Illegal Number of Points Specified in File");
 		} else {
-			points.clear();
-			// get lines until EOF or we have enough points
-			while( (points.size() < npts) && fgets(buf,512,fp) ) {
-				Pnt3f pos,orient;
-				vector<const char*> words;
-				breakString(buf,words);
-				if (words.size() >= 3) {
-					pos.x = (float) strtod(words[0],0);
-					pos.y = (float) strtod(words[1],0);
-					pos.z = (float) strtod(words[2],0);
-				} else {
-					pos.x=0;
-					pos.y=0;
-					pos.z=0;
-				}
-				if (words.size() >= 6) {
-					orient.x = (float) strtod(words[3],0);
-					orient.y = (float) strtod(words[4],0);
-					orient.z = (float) strtod(words[5],0);
-				} else {
-					orient.x = 0;
-					orient.y = 1;
-					orient.z = 0;
-				}
-				orient.normalize();
-				points.push_back(ControlPoint(pos,orient));
-			}
+			points.swap(newPoints);
 		}
-		fclose(fp);
+	} catch(TrackParseError& e) {
+		fl_alert("%s", e.what());
 	}
 	trainU = 0;
 }
@@ -0,0 +1,15 @@
+#pragma once
+/*
+ * AllocationCounter.h
+ *
+ * Debug mode for finding heap allocations in the frame path,
+ * build with TRACK_ALLOCATIONS defined to replace the global
+ * operator new with one that counts every call. Each thread has
+ * its own count, so the worker, simulation and writer threads
+ * don't show up in the frames the interface thread draws
+ */
+
+/* numAllocations() - Number of global operator new calls made so */
+/* far by the calling thread (always 0 unless built with --------- */
+/* TRACK_ALLOCATIONS) -------------------------------------------- */
+long numAllocations();
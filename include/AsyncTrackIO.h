@@ -0,0 +1,82 @@
+#pragma once
+/*
+ * AsyncTrackIO.h
+ *
+ * Loads and saves track files on a worker thread so the UI keeps
+ * drawing, the UI thread polls for completion between frames
+ */
+#include "Curve.h"
+#include "Threads.h"
+
+#include <string>
+
+
+/* ==================================================================
+ * AsyncTrackIO class
+ *
+ * Loads build a complete new Curve (points and segments) on the
+ * worker, which poll() swaps into the live curve in one step.
+ * Saves write a snapshot of the points taken when they start,
+ * so the live curve can keep being edited while they run.
+ * Only one load or save runs at a time.
+ * ==================================================================
+ */
+class AsyncTrackIO
+{
+public:
+	enum Result
+	{
+		idle = 0,  // nothing was running
+		running,
+		loaded,    // 'curve' was swapped with the loaded curve
+		saved,
+		failed     // see getError()
+	};
+
+private:
+	enum Operation { noOperation, loadOperation, saveOperation };
+
+	Thread        worker;
+	Operation     operation;
+	volatile long finished;     // set by the worker once its results are written
+	volatile long progress;     // thousandths of the file read
+	volatile long building;     // set while the loaded curve's segments are built
+
+	std::string filename;
+	std::string error;
+
+	Curve *loadedCurve;
+
+	// Save snapshot
+	ControlPointVector points;
+	CurveType          curveType;
+	float              tension;
+
+	AsyncTrackIO(const AsyncTrackIO&);
+	AsyncTrackIO& operator=(const AsyncTrackIO&);
+
+	static void run(void *pIO);
+	void load();
+	void save();
+
+public:
+	AsyncTrackIO();
+	~AsyncTrackIO();
+
+	bool startLoad(const std::string& filename, const Curve& current);
+	bool startSave(const std::string& filename, const Curve& curve);
+
+	Result poll(Curve& curve);
+
+	bool  isBusy() const;
+	bool  isLoading() const;
+	float getProgress() const;
+
+	const std::string& getFilename() const;
+	const std::string& getError() const;
+};
+
+inline bool AsyncTrackIO::isBusy()    const { return operation != noOperation; }
+inline bool AsyncTrackIO::isLoading() const { return operation == loadOperation; }
+inline const std::string& AsyncTrackIO::getFilename() const { return filename; }
+inline const std::string& AsyncTrackIO::getError()    const { return error; }
@@ -47,3 +47,15 @@ void pointRollMoreButtonCallback( Fl_Widget *widget, MainWindow *window );
 void pointRollLessButtonCallback( Fl_Widget *widget, MainWindow *window );
 
 void tensionSliderCallback(Fl_Widget *widget, MainWindow *window);
+
+void undoButtonCallback(Fl_Widget *widget, MainWindow *window);
+
+void redoButtonCallback(Fl_Widget *widget, MainWindow *window);
+
+void saveTraceButtonCallback(Fl_Widget *widget, MainWindow *window);
+
+void exportMeshButtonCallback(Fl_Widget *widget, MainWindow *window);
+
+void lodButtonCallback(Fl_Widget *widget, MainWindow *window);
+
+void clearanceButtonCallback(Fl_Widget *widget, MainWindow *window);
@@ -0,0 +1,114 @@
+#pragma once
+/*
+ * ClearanceChecker.h
+ *
+ * Finds places where the track passes too close to itself
+ */
+#include "CurveSnapshot.h"
+#include "Frustum.h"
+#include "JobSystem.h"
+#include "SegmentTree.h"
+#include "Vec3f.h"
+
+#include <vector>
+
+
+/* ClearanceViolation struct - the closest approach of two segments */
+struct ClearanceViolation
+{
+	int   segmentA, segmentB;   // segmentA < segmentB
+	float tA, tB;               // where they're closest
+	Vec3f pointA, pointB;
+	float distance;             // between the center lines
+	bool  intersecting;         // the rails touch, see ClearanceChecker
+};
+
+
+/* ==================================================================
+ * ClearanceChecker class
+ *
+ * Checks a published snapshot of the curve on the job system, so
+ * the interface thread only starts a check and polls for it, and
+ * shows the last finished result meanwhile. Only one check runs at
+ * a time, the caller starts the next once it's done.
+ *
+ * Builds a SegmentTree over the segments' bounds, padded by half
+ * the reach, so only segments whose boxes overlap are compared.
+ * Each segment queries the tree for its neighbors in parallel, then
+ * the center lines of each candidate pair are sampled and their
+ * closest points found. That's O(n log n) for a track that doesn't
+ * pile up on itself.
+ *
+ * A pair is recorded if it comes within the clearance, or if the
+ * rails touch: the other center line is within the width of the
+ * track to the side and within the rails' height above or below,
+ * measured across the first segment at the closest points.
+ *
+ * Adjacent segments share an end point so are never compared, and
+ * points that are less than a hairpin's length apart along the
+ * track (half a turn whose diameter is the clearance) don't count:
+ * they're close because they follow each other, not because the
+ * track doubles back.
+ * ==================================================================
+ */
+class ClearanceChecker
+{
+public:
+	static const float defaultClearance;   // the train's height
+	static const float trackHalfWidth;     // center line to a rail's outer edge
+
+private:
+	// Work for one range of segments, so threads don't share anything
+	struct Chunk
+	{
+		ClearanceChecker *checker;
+		int first, last;   // segments
+		std::vector<ClearanceViolation> found;
+		std::vector<int>   stack;
+		std::vector<float> paramsA, paramsB;
+		std::vector<Vec3f> pointsA, pointsB;
+	};
+
+	SegmentTree              tree;
+	std::vector<BoundingBox> boxes;    // padded, per segment
+	std::vector<float>       starts;   // distance along the track to each segment
+	std::vector<float>       lengths;  // of each segment, roughly
+	std::vector<Chunk>       chunks;
+	std::vector<Job>         jobs;     // one per chunk, children of 'root'
+	Job                      root;     // prepares the check
+
+	std::vector<ClearanceViolation> violations;   // of the last finished check
+
+	CurveSnapshotPtr curve;          // being checked
+	bool             running;
+	unsigned int     revision;       // of the curve the violations are for
+	float            clearance;
+	float            reach;          // pairs further apart than this can't count
+	float            trackLength;
+
+	ClearanceChecker(const ClearanceChecker&);
+	ClearanceChecker& operator=(const ClearanceChecker&);
+
+	void prepare();
+	void query(const int segment, Chunk& chunk);
+	void compare(const int a, const int b, Chunk& chunk);
+	float separation(const int a, const float ta, const int b, const float tb) const;
+	static void prepareTask(void *pChecker);
+	static void chunkTask(void *pChunk);
+
+public:
+	ClearanceChecker();
+	~ClearanceChecker();
+
+	bool start(const CurveSnapshotPtr& curve, const float clearance=defaultClearance);
+	bool poll();
+
+	bool isBusy() const;
+	unsigned int getRevision() const;
+	const std::vector<ClearanceViolation>& getViolations() const;
+	size_t numIntersections() const;
+};
+
+inline bool ClearanceChecker::isBusy() const { return running; }
+inline unsigned int ClearanceChecker::getRevision() const { return revision; }
+inline const std::vector<ClearanceViolation>& ClearanceChecker::getViolations() const { return violations; }
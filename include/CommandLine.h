@@ -0,0 +1,15 @@
+#pragma once
+/*
+ * CommandLine.h
+ *
+ * Batch modes run from the command line rather than the window:
+ * converting, meshing, fitting and exporting frames of tracks, and
+ * the benchmarks of the curve code. Each exits non-zero on failure
+ */
+
+/* isCommand() - True if 'arg' names a batch mode, such as -export */
+bool isCommand(const char *arg);
+
+/* runCommand() - Runs the batch mode named by argv[1], returns the */
+/* program's exit code --------------------------------------------- */
+int runCommand(int argc, char* argv[]);
@@ -4,12 +4,16 @@
  */
 #include "CtrlPoint.h"
 #include "CurveSegments.h"
+#include "CurveSnapshot.h"
 
 #include <stdexcept>
 #include <string>
 #include <vector>
 #include <map>
 
+class EditJournal;
+class UndoHistory;
+
 typedef std::vector<CtrlPoint>             ControlPointVector;
 typedef ControlPointVector::iterator       ControlPointVectorIter;
 typedef ControlPointVector::const_iterator ControlPointVectorConstIter;
@@ -24,6 +28,17 @@ typedef CurveSegmentVector::const_iterator CurveSegmentVectorConstIter;
 /* -----------                                                          */
 /* Stores a vector of control points and a curve type specifier         */
 /* and uses these to build a vector of corresponding segments           */
+/*                                                                      */
+/* Edits regenerate only the segments they affect. Wrapping several     */
+/* edits in beginEdit()/commitEdit() defers regeneration until the      */
+/* outermost commit, so bulk changes regenerate exactly once.           */
+/*                                                                      */
+/* Single point edits and setting changes are also recorded to the      */
+/* journal and undo history, if they're set. Bulk changes (add, clear,  */
+/* assign, swap) are not, they're only made while building a curve.     */
+/*                                                                      */
+/* Only the thread that owns the curve may touch it. It publishes       */
+/* immutable snapshots that any other thread can read instead.          */
 /************************************************************************/
 class Curve
 {
@@ -32,6 +47,24 @@ private:
 	ControlPointVector controlPoints;
 	CurveSegmentVector segments;
 
+	// Pending edit state, flushed when editDepth returns to 0
+	int  editDepth;
+	int  dirtyFirst, dirtyLast;
+	bool structureChanged;
+
+	EditJournal *journal; // nullptr if edits aren't journaled
+	UndoHistory *history; // nullptr if edits can't be undone
+
+	Tessellation tessellation;
+
+	Frustum frustum;              // segments outside it aren't drawn
+	int     numDrawnSegments;     // by the last unshadowed draw()
+	int     numCulledSegments;
+
+	unsigned int revision;        // changes whenever the segments do
+
+	SnapshotSlot snapshots;       // the latest published version
+
 public:
 	// TODO: make private?
 	int selectedPoint;
@@ -44,18 +77,40 @@ public:
 
 	void regenerateSegments();
 
+	void beginEdit();
+	void commitEdit();
+
+	void swap(Curve& other);
+	void setJournal(EditJournal *editJournal);
+	void setHistory(UndoHistory *undoHistory);
+	void setTessellation(const Tessellation& settings);
+	const Tessellation& getTessellation() const;
+	void setFrustum(const Frustum& viewFrustum);
+	int  getNumDrawnSegments() const;
+	int  getNumCulledSegments() const;
+	unsigned int getRevision() const;
+
+	void publish();
+	CurveSnapshotPtr getSnapshot() const;
+
 	void draw(bool drawPoints, bool isShadowed);
 	void drawPoint(int index, bool isShadowed);
 	void drawPoints(bool isShadowed) const;
 	void drawSelectedSegment(bool drawPoints, bool isShadowed);
 
 	void setCurveType(const CurveType& curveType);
+	void setTension(const float newTension);
 
 	int numSegments() const;
 	int numControlPoints() const; 
 	int addControlPoint(const CtrlPoint& point);
+	int insertControlPoint(const int id, const CtrlPoint& point);
 	void clearPoints();
 	void delControlPoint(const int id);
+	void moveControlPoint(const int id, const Vec3f& pos);
+	void orientControlPoint(const int id, const Vec3f& orient);
+	void assignPoints(ControlPointVectorConstIter first, ControlPointVectorConstIter last);
+	void swapPoints(ControlPointVector& points);
 
 	Vec3f getPosition (const float t) const;
 	Vec3f getDirection(const float t) const;
@@ -64,17 +119,36 @@ public:
 	CurveType  getCurveType() const;
 	CurveSegment* getSegment(const int number);
 	ControlPointVector& getControlPoints(); 
+	const ControlPointVector& getControlPoints() const;
 
 	class NoSuchPoint : public std::runtime_error { public: NoSuchPoint(const std::string& what_arg) : std::runtime_error(what_arg) { } };
 
 private:
 	void drawSegment(const int number, bool isShadowed);
 
-	void regenerateLineSegments();
-	void regenerateCurveSegments();
+	void markPointsDirty(const int first, const int last);
+	void markStructureChanged();
+	void flushEdits();
+
+	void regenerateSegmentsForPoints(const int first, const int last);
+	CurveSegment* makeSegment(const int number);
+
+	static void rebuildTask(const int index, void *pRebuild);
+	static void boundsTask(const int index, void *pCurve);
+	static void snapshotTask(const int index, void *pGather);
 };
 
 inline int Curve::numSegments()        const { return segments.size(); }
 inline int Curve::numControlPoints()   const { return controlPoints.size(); }
 inline CurveType Curve::getCurveType() const { return type; }
+inline void Curve::setJournal(EditJournal *j) { journal = j; }
+inline void Curve::setHistory(UndoHistory *h) { history = h; }
+inline void Curve::setTessellation(const Tessellation& t) { tessellation = t; }
+inline const Tessellation& Curve::getTessellation() const { return tessellation; }
+inline void Curve::setFrustum(const Frustum& f) { frustum = f; }
+inline int  Curve::getNumDrawnSegments()  const { return numDrawnSegments; }
+inline int  Curve::getNumCulledSegments() const { return numCulledSegments; }
+inline unsigned int Curve::getRevision()  const { return revision; }
+inline CurveSnapshotPtr Curve::getSnapshot() const { return snapshots.acquire(); }
 inline ControlPointVector& Curve::getControlPoints()   { return controlPoints; }
+inline const ControlPointVector& Curve::getControlPoints() const { return controlPoints; }
@@ -3,7 +3,13 @@
  * CurveSegments.h
  */
 #include "CtrlPoint.h"
+#include "ForwardDifferencer.h"
 #include "Vec3f.h"
+#include "LevelOfDetail.h"
+#include "Frustum.h"
+
+#include <memory>
+#include <vector>
 
 enum CurveType {
 	lines = 0,
@@ -14,8 +20,47 @@ enum CurveType {
 
 extern std::string CurveTypeNames[];
 
+/* segmentBasis() - Coefficients of 1, t, t^2, t^3 in the weight of */
+/* each of a segment's control points (previous, start, end, next) */
+void segmentBasis(const CurveType type, const float tension, float basis[4][4]);
+
+/* bezierPoints() - The Bezier control points of a cubic, which ---- */
+/* hold the whole cubic for t in [0,1] in their hull --------------- */
+void bezierPoints(const CubicCoefficients& cubic, Vec3f points[4]);
+
 class Curve;
 
+struct SegmentSnapshot;
+typedef std::shared_ptr<const SegmentSnapshot> SegmentSnapshotPtr;
+
+
+/* ==================================================================
+ * Tessellation struct
+ *
+ * How finely segments are sampled for drawing: each is subdivided
+ * until its rails stay within a tolerance of the true curve. With
+ * level of detail on (the LOD button) the tolerance is in pixels
+ * and is turned into a distance for each segment from how far it
+ * is from the camera, and segments drop their ties, then a rail,
+ * as they get smaller. Otherwise everything is drawn in full.
+ * ==================================================================
+ */
+struct Tessellation
+{
+	static const float defaultTolerance;       // track units
+	static const float defaultPixelTolerance;
+
+	float tolerance;       // track units, without level of detail
+	float pixelTolerance;
+	bool  levelOfDetail;
+
+	ScreenProjection view; // the camera, set each frame for level of detail
+
+	Tessellation();
+
+	float toleranceAt(const Vec3f& point, const float current=0.f) const;
+};
+
 
 /* ==================================================================
  * CurveSegment base class
@@ -23,29 +68,62 @@ class Curve;
  */
 class CurveSegment
 {
-protected:
+public:
+	// Fixed samples per segment (the ties are still stepped by it),
+	// rail distance from the center and the rails' cross section,
+	// also used by the mesh exporter and the clearance check
 	static const int   numLines;
 	static const float step;
 	static const float radius;
+	static const float railHalfWidth;
+	static const float railHeight;
 
-	Curve& parentCurve;
+	// Adaptive sampling starts from minSpans even spans and halves
+	// them at most maxDepth times, so every sample lies on a grid of
+	// sampleGrid even steps
+	static const int minSpans;
+	static const int maxDepth;
+	static const int sampleGrid;
+
+protected:
+	Curve *parentCurve;
 	int number;
 	CurveType curveType;
 	CtrlPoint startPoint, endPoint;
 	CtrlPoint control1, control2;
 
+	// Adaptive samples and detail to draw with, only changed by
+	// updateSamples(), so drawing never writes to the segment
+	std::vector<float> samples;
+	float samplesTolerance;
+	float samplesTension;
+
+	DetailLevel detail;
+
+	BoundingBox       bounds;   // of everything draw() draws
+	CubicCoefficients cubic;    // of the position, kept with the bounds
+
+	SegmentSnapshotPtr snapshot;   // made when first published, until the bounds change
+
 public:
 	CurveSegment(Curve& parentCurve,
 				 const int number, const CurveType& curveType,
 				 const CtrlPoint& startPoint, const CtrlPoint& endPoint, 
 				 const CtrlPoint& control1,   const CtrlPoint& control2)
-		: parentCurve(parentCurve)
+		: parentCurve(&parentCurve)
 		, number(number)
 		, curveType(curveType)
 		, startPoint(startPoint)
 		, endPoint(endPoint)
 		, control1(control1)
 		, control2(control2)
+		, samples()
+		, samplesTolerance(0.f)
+		, samplesTension(0.f)
+		, detail(detailHigh)
+		, bounds()
+		, cubic()
+		, snapshot()
 	{ }
 
 	virtual void draw(bool drawPoints=false, bool isShadowed=false);
@@ -54,7 +132,24 @@ public:
 	virtual Vec3f getDirection (float t) = 0;;
 	virtual Vec3f getOrientation(float t);
 
+	void computeSamples(const float tolerance, std::vector<float>& params);
+	void updateSamples(const Tessellation& tessellation);
+	const std::vector<float>& getSamples() const;
+	DetailLevel getDetail() const;
+
+	void tessellateCurve(const std::vector<float>& params, const int numSteps,
+						 std::vector<Vec3f>& center) const;
+	void tessellateRails(const std::vector<float>& params, const int numSteps,
+						 std::vector<Vec3f>& left, std::vector<Vec3f>& right) const;
+
+	void updateBounds();
+	const BoundingBox& getBounds() const;
+	const CubicCoefficients& getCubic() const;
+	SegmentSnapshotPtr getSnapshot();
+
 	int	      getNumber    () const;
+
+	void setParentCurve(Curve& curve);
 	CurveType getCurveType () const;
 
 	CtrlPoint& getStartPoint ();
@@ -64,6 +159,12 @@ public:
 };
 
 
+inline const std::vector<float>& CurveSegment::getSamples() const { return samples; }
+inline DetailLevel CurveSegment::getDetail() const { return detail; }
+inline const BoundingBox& CurveSegment::getBounds() const { return bounds; }
+inline const CubicCoefficients& CurveSegment::getCubic() const { return cubic; }
+
+
 /* ==================================================================
  * LineSegment class
  * ==================================================================
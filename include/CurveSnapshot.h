@@ -0,0 +1,127 @@
+#pragma once
+/*
+ * CurveSnapshot.h
+ *
+ * Immutable, reference counted versions of a curve that other
+ * threads can read while it's being edited
+ */
+#include "CtrlPoint.h"
+#include "CurveSegments.h"
+#include "ForwardDifferencer.h"
+#include "Frustum.h"
+#include "Threads.h"
+#include "Vec3f.h"
+
+#include <memory>
+#include <vector>
+
+
+/* ==================================================================
+ * SegmentSnapshot struct
+ *
+ * One segment as it was when published: its cubic, which already
+ * has the tension in it, and its end points. Never changed once
+ * made, so versions of a curve share the segments an edit didn't
+ * touch.
+ * ==================================================================
+ */
+struct SegmentSnapshot
+{
+	CubicCoefficients cubic;
+	BoundingBox       bounds;
+	CtrlPoint         startPoint, endPoint;
+
+	Vec3f getPosition   (const float t) const;
+	Vec3f getDirection  (const float t) const;
+	Vec3f getOrientation(const float t) const;
+
+	// Like CurveSegment::computeSamples(), defined with it
+	void computeSamples(const float tolerance, std::vector<float>& params) const;
+};
+
+typedef std::shared_ptr<const SegmentSnapshot> SegmentSnapshotPtr;
+
+
+/* ==================================================================
+ * CurveSnapshot class
+ *
+ * A whole curve as it was when published. Its t runs over [0, n)
+ * for n segments and wraps around outside that, like the train.
+ * ==================================================================
+ */
+class CurveSnapshot
+{
+private:
+	CurveType    type;
+	float        tension;
+	unsigned int revision;   // the curve's when it was published
+
+	std::vector<SegmentSnapshotPtr> segments;
+
+	const SegmentSnapshot& segmentAt(const float t, float& tUnit) const;
+
+public:
+	CurveSnapshot(const CurveType type, const float tension, const unsigned int revision,
+				  std::vector<SegmentSnapshotPtr>& segments);
+
+	CurveType    getCurveType() const;
+	float        getTension()   const;
+	unsigned int getRevision()  const;
+
+	int numSegments() const;
+	const SegmentSnapshot& getSegment(const int number) const;
+	const CtrlPoint&       getPoint(const int id) const;
+
+	Vec3f getPosition   (const float t) const;
+	Vec3f getDirection  (const float t) const;
+	Vec3f getOrientation(const float t) const;
+};
+
+typedef std::shared_ptr<const CurveSnapshot> CurveSnapshotPtr;
+
+inline CurveType    CurveSnapshot::getCurveType() const { return type; }
+inline float        CurveSnapshot::getTension()   const { return tension; }
+inline unsigned int CurveSnapshot::getRevision()  const { return revision; }
+inline int          CurveSnapshot::numSegments()  const { return segments.size(); }
+
+inline const SegmentSnapshot& CurveSnapshot::getSegment(const int number) const { return *segments[number]; }
+
+// Segment i starts at point i
+inline const CtrlPoint& CurveSnapshot::getPoint(const int id) const { return segments[id]->startPoint; }
+
+
+/* ==================================================================
+ * SnapshotSlot class
+ *
+ * Holds the latest published snapshot. Readers take a reference to
+ * it without locking: each one counts itself in for the current
+ * epoch while it copies the pointer. Publishing swaps the pointer
+ * atomically, then moves to the other epoch and waits for the
+ * readers counted in the one it left, twice over. Any reader that
+ * could have seen the old pointer was counted in one of the two,
+ * so after that it's safe to drop the slot's reference. Readers
+ * arriving meanwhile count in the new epoch, so the waits are only
+ * ever for copies already under way. An old snapshot is freed when
+ * the last reader lets go of it.
+ * ==================================================================
+ */
+class SnapshotSlot
+{
+private:
+	CurveSnapshotPtr * volatile current;
+	volatile long               epoch;
+	mutable volatile long       readers[2];   // per epoch, copying 'current'
+	Mutex                       publishing;   // one publisher at a time
+
+	void nextEpoch();
+
+	SnapshotSlot(const SnapshotSlot&);
+	SnapshotSlot& operator=(const SnapshotSlot&);
+
+public:
+	SnapshotSlot();
+	~SnapshotSlot();
+
+	CurveSnapshotPtr acquire() const;
+	void publish(const CurveSnapshotPtr& snapshot);
+};
@@ -0,0 +1,131 @@
+#pragma once
+/*
+ * EditJournal.h
+ *
+ * Append-only log of curve edits kept beside a track file, so each
+ * edit is persisted as it happens at a cost proportional to the edit,
+ * and replayed the next time the track is loaded
+ *
+ * <track>.journal layout (little-endian):
+ *   JournalHeader    identifies the track file the records apply to,
+ *                    and the snapshot they apply on top of if any
+ *   JournalRecord[]  one per edit, each with its own checksum so a
+ *                    record torn by a crash is dropped on replay
+ *
+ * A compacted journal builds on <track>.snapshot.trk, a binary track
+ * file holding the curve as it was when the journal was compacted,
+ * so the user's own track file is never written without being asked.
+ * Version 1 journals have no snapshot.
+ */
+#include "CtrlPoint.h"
+#include "CurveSegments.h"
+#include "Vec3f.h"
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+class Curve;
+
+
+#pragma pack(push, 1)
+struct JournalHeader
+{
+	char             magic[4];        // "TJNL"
+	unsigned int     version;
+	unsigned __int64 trackSize;       // size and last write time of the
+	unsigned __int64 trackWriteTime;  // track file the records apply to
+
+	// Version 2
+	unsigned __int64 snapshotSize;       // size and last write time of the
+	unsigned __int64 snapshotWriteTime;  // snapshot they apply on top of, 0 if none
+};
+
+struct JournalRecord
+{
+	unsigned int op;         // JournalOp
+	int          index;      // control point index, or the curve type
+	float        values[6];
+	unsigned int checksum;   // of the fields above
+};
+#pragma pack(pop)
+
+enum JournalOp {
+	journalMove = 1,   // index, position
+	journalOrient,     // index, orientation
+	journalInsert,     // index, position and orientation
+	journalDelete,     // index
+	journalTension,    // tension
+	journalCurveType   // curve type in index
+};
+
+static const char         journalMagic[4]    = { 'T', 'J', 'N', 'L' };
+static const unsigned int journalVersion     = 2;
+static const unsigned int journalV1Size      = 24; // header size in version 1
+static const char         journalExtension[] = ".journal";
+static const char         snapshotExtension[] = ".snapshot.trk";
+
+
+/* ==================================================================
+ * EditJournal class
+ *
+ * Records are flushed to the OS as they're appended, so a crash of
+ * the program loses nothing. Compacting is done by saving the curve
+ * to newSnapshotFilename() and then calling compact(), which starts
+ * a new journal on that snapshot holding only the records made since
+ * the save started, then moves the snapshot in. Saving the track
+ * itself is followed by rebase(), which does the same on the track
+ * file and drops the snapshot.
+ * Throws TrackFileError if a journal can't be read or written
+ * ==================================================================
+ */
+class EditJournal
+{
+private:
+	std::string                trackFilename;
+	FILE                      *file;     // open for appending, nullptr if closed
+	std::vector<JournalRecord> records;  // in the journal file
+
+	// The snapshot the records apply on top of, both 0 if none
+	unsigned __int64 snapshotSize;
+	unsigned __int64 snapshotWriteTime;
+
+	EditJournal(const EditJournal&);
+	EditJournal& operator=(const EditJournal&);
+
+	void append(const JournalOp op, const int index, const float *values, const int numValues);
+	void rewrite(const size_t firstRecord);
+	bool findSnapshot(const JournalHeader& header);
+
+public:
+	EditJournal();
+	~EditJournal();
+
+	static std::string journalFilename(const std::string& trackFilename);
+	static std::string snapshotFilename(const std::string& trackFilename);
+	static std::string newSnapshotFilename(const std::string& trackFilename);
+
+	int  open(const std::string& trackFilename, Curve& curve);
+	void start(const std::string& trackFilename);
+	void rebase(const std::string& trackFilename, const size_t firstRecord);
+	void compact(const size_t firstRecord);
+	void close();
+
+	bool   isOpen() const;
+	bool   hasSnapshot() const;
+	size_t numRecords() const;
+	bool   needsCompaction(const int numPoints) const;
+	const std::string& getTrackFilename() const;
+
+	void recordMove(const int index, const Vec3f& pos);
+	void recordOrient(const int index, const Vec3f& orient);
+	void recordInsert(const int index, const CtrlPoint& point);
+	void recordDelete(const int index);
+	void recordTension(const float tension);
+	void recordCurveType(const CurveType type);
+};
+
+inline bool   EditJournal::isOpen()     const { return file != nullptr; }
+inline size_t EditJournal::numRecords() const { return records.size(); }
+inline bool   EditJournal::hasSnapshot() const { return snapshotSize != 0 || snapshotWriteTime != 0; }
+inline const std::string& EditJournal::getTrackFilename() const { return trackFilename; }
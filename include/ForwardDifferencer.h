@@ -0,0 +1,86 @@
+#pragma once
+/*
+ * ForwardDifferencer.h
+ *
+ * Steps along a segment's cubic at even intervals of t
+ */
+#include "Vec3f.h"
+
+
+/* CubicCoefficients struct - p(t) = c[0] + c[1] t + c[2] t^2 + c[3] t^3 */
+/* one row per axis ------------------------------------------------- */
+struct CubicCoefficients
+{
+	float c[3][4];
+};
+
+
+/* ==================================================================
+ * ForwardDifferencer class
+ *
+ * A cubic's value at even steps of t can be had by adding its
+ * forward differences together: three adds per axis for the
+ * position, two for the derivative and one for the orientation,
+ * which is a straight blend between the ends. The differences
+ * are kept in doubles, so over a few hundred steps they drift
+ * from evaluating the cubic directly by far less than the floats
+ * they're handed out as.
+ * ==================================================================
+ */
+class ForwardDifferencer
+{
+private:
+	double position[3], dPosition[3], ddPosition[3], dddPosition[3];
+	double derivative[3], dDerivative[3], ddDerivative[3];
+	double orientation[3], dOrientation[3];
+	int    step;
+
+public:
+	ForwardDifferencer(const CubicCoefficients& cubic,
+					   const Vec3f& startOrient, const Vec3f& endOrient,
+					   const int numSteps);
+
+	void advance();
+
+	int   getStep()        const;
+	Vec3f getPosition()    const;
+	Vec3f getDirection()   const;   // not normalized
+	Vec3f getOrientation() const;   // not normalized
+};
+
+inline void ForwardDifferencer::advance()
+{
+	for(int axis = 0; axis < 3; ++axis)
+	{
+		position[axis]    += dPosition[axis];
+		dPosition[axis]   += ddPosition[axis];
+		ddPosition[axis]  += dddPosition[axis];
+		derivative[axis]  += dDerivative[axis];
+		dDerivative[axis] += ddDerivative[axis];
+		orientation[axis] += dOrientation[axis];
+	}
+	++step;
+}
+
+inline int ForwardDifferencer::getStep() const { return step; }
+
+inline Vec3f ForwardDifferencer::getPosition() const
+{
+	return Vec3f(static_cast<float>(position[0]),
+				 static_cast<float>(position[1]),
+				 static_cast<float>(position[2]));
+}
+
+inline Vec3f ForwardDifferencer::getDirection() const
+{
+	return Vec3f(static_cast<float>(derivative[0]),
+				 static_cast<float>(derivative[1]),
+				 static_cast<float>(derivative[2]));
+}
+
+inline Vec3f ForwardDifferencer::getOrientation() const
+{
+	return Vec3f(static_cast<float>(orientation[0]),
+				 static_cast<float>(orientation[1]),
+				 static_cast<float>(orientation[2]));
+}
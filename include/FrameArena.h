@@ -0,0 +1,51 @@
+#pragma once
+/*
+ * FrameArena.h
+ *
+ * A bump allocator for scratch data that only lives for one frame
+ */
+#include <cstddef>
+#include <vector>
+
+
+/* ==================================================================
+ * FrameArena class
+ *
+ * Allocations come out of a single block and are all released
+ * at once by reset(). If a frame needs more than the block holds
+ * the extra comes from the heap, and the next reset() grows the
+ * block so steady-state frames never touch the heap.
+ * ==================================================================
+ */
+class FrameArena
+{
+private:
+	char   *block;
+	size_t  capacity;
+	size_t  used;
+	size_t  overflowBytes;
+
+	std::vector<char*> overflow;
+
+	FrameArena(const FrameArena&);
+	FrameArena& operator=(const FrameArena&);
+
+public:
+	explicit FrameArena(const size_t capacity=16 * 1024);
+	~FrameArena();
+
+	void* allocate(const size_t bytes, const size_t alignment=8);
+	void  reset();
+
+	template<typename T>
+	T* allocate(const size_t count)
+	{
+		return static_cast<T*>(allocate(count * sizeof(T), __alignof(T)));
+	}
+
+	size_t getCapacity() const;
+	size_t getUsed()     const;
+};
+
+inline size_t FrameArena::getCapacity() const { return capacity; }
+inline size_t FrameArena::getUsed()     const { return used + overflowBytes; }
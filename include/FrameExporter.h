@@ -0,0 +1,132 @@
+#pragma once
+/*
+ * FrameExporter.h
+ *
+ * Renders the MainView scene without a visible window
+ * and writes each frame of a lap out to image files
+ */
+#include "Threads.h"
+
+#ifndef WIN32
+#define EGL_NO_X11
+#include <EGL/egl.h>
+#endif
+
+#include <string>
+#include <vector>
+
+class MainView;
+
+
+/* ==================================================================
+ * OffscreenContext class
+ *
+ * An OpenGL context that renders into a framebuffer object.
+ * On Windows it's a WGL context on a hidden window, which still
+ * needs a desktop to be created on, so it won't run from a service,
+ * and a graphics driver with framebuffer objects, since the software
+ * renderer Windows falls back to without one doesn't have them.
+ * Elsewhere it's an EGL context on a pbuffer, on Mesa's surfaceless
+ * platform when there's no display server, so it runs on a machine
+ * with no display or GPU at all using Mesa's software renderer.
+ * ==================================================================
+ */
+class OffscreenContext
+{
+private:
+#ifdef WIN32
+	HWND  hwnd;
+	HDC   hdc;
+	HGLRC hglrc;
+#else
+	EGLDisplay display;
+	EGLSurface surface;
+	EGLContext context;
+#endif
+
+	unsigned int framebuffer;
+	unsigned int colorBuffer;
+	unsigned int depthBuffer;
+
+	int width, height;
+
+	OffscreenContext(const OffscreenContext&);
+	OffscreenContext& operator=(const OffscreenContext&);
+
+	bool createContext();
+	void destroyContext();
+	bool hasContext() const;
+
+public:
+	OffscreenContext();
+	~OffscreenContext();
+
+	bool create(const int width, const int height);
+	void destroy();
+
+	void readPixels(unsigned char *bgra) const;
+
+	int getWidth()  const;
+	int getHeight() const;
+};
+
+inline int OffscreenContext::getWidth()  const { return width; }
+inline int OffscreenContext::getHeight() const { return height; }
+
+
+/* ==================================================================
+ * FrameWriter class
+ *
+ * Owns a small ring of frame buffers, frames are filled by the
+ * render thread and encoded/written to disk on a worker thread
+ * so file output runs in parallel with rendering the next frame
+ * ==================================================================
+ */
+class FrameWriter
+{
+private:
+	struct Frame
+	{
+		std::vector<unsigned char> pixels;
+		std::string filename;
+	};
+
+	const int width, height;
+
+	std::vector<Frame> frames;
+	int nextFill;
+	int nextWrite;
+	int numWritten;
+
+	Semaphore freeFrames;
+	Semaphore filledFrames;
+	Thread    worker;
+
+	static void run(void *pWriter);
+	void writeFrames();
+
+public:
+	FrameWriter(const int width, const int height, const int numBuffers=4);
+	~FrameWriter();
+
+	unsigned char* acquire();
+	void submit(const std::string& filename);
+	int  finish();
+};
+
+
+/* ==================================================================
+ * FrameExporter class
+ * ==================================================================
+ */
+class FrameExporter
+{
+private:
+	MainView& view;
+
+public:
+	FrameExporter(MainView& view);
+
+	int exportLap(const std::string& directory, const int numFrames,
+				  const int width, const int height);
+};
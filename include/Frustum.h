@@ -0,0 +1,54 @@
+#pragma once
+/*
+ * Frustum.h
+ *
+ * Axis aligned bounding boxes and the view frustum they're culled
+ * against
+ */
+#include "Vec3f.h"
+
+
+/* ==================================================================
+ * BoundingBox struct
+ * ==================================================================
+ */
+struct BoundingBox
+{
+	Vec3f minimum, maximum;
+
+	BoundingBox();
+
+	bool isEmpty() const;
+	void add(const Vec3f& point);
+	void add(const BoundingBox& box);
+	void pad(const float amount);
+
+	Vec3f center() const;
+	Vec3f extents() const;
+};
+
+inline bool BoundingBox::isEmpty() const { return minimum.x() > maximum.x(); }
+
+
+/* ==================================================================
+ * Frustum class
+ *
+ * The six clip planes of a view, taken from the modelview and
+ * projection matrices. A default constructed frustum holds every box.
+ * ==================================================================
+ */
+class Frustum
+{
+private:
+	float planes[6][4];   // a, b, c, d with a*x + b*y + c*z + d >= 0 inside
+	bool  valid;
+
+public:
+	Frustum();
+	Frustum(const float modelview[16], const float projection[16]);
+
+	bool isValid() const;
+	bool intersects(const BoundingBox& box) const;
+};
+
+inline bool Frustum::isValid() const { return valid; }
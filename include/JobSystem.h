@@ -0,0 +1,107 @@
+#pragma once
+/*
+ * JobSystem.h
+ *
+ * A pool of worker threads that share out small jobs by stealing
+ * them from each other
+ */
+#include "LockFree.h"
+#include "Profiler.h"
+#include "Threads.h"
+
+
+/* ==================================================================
+ * Job struct
+ *
+ * One call of 'function' with 'data'. A job isn't finished until
+ * its function has returned and every child added under it has
+ * finished too, then its continuation, if it has one, is run. Jobs
+ * belong to whoever made them and have to outlive the wait on them.
+ * ==================================================================
+ */
+typedef void (*JobFunction)(void *pData);
+
+struct Job
+{
+	JobFunction    function;
+	void          *data;
+	Job           *parent;
+	Job           *continuation;
+	ProfileStage   stage;        // numProfileStages if it isn't timed
+	volatile long  unfinished;   // itself plus its unfinished children
+};
+
+
+/* ==================================================================
+ * JobSystem class
+ *
+ * One worker per hardware thread beyond the first, each with its own
+ * deque of jobs. A worker runs the jobs it queued itself newest
+ * first, so children run while their data is still in cache, and
+ * when it runs out it steals the oldest job from another deque,
+ * which tends to be the biggest piece of work left. Threads that
+ * aren't workers, like the interface thread, queue onto a shared
+ * deque instead and help run jobs while they wait for theirs.
+ * Idle workers sleep until more jobs are queued.
+ * ==================================================================
+ */
+class JobSystem
+{
+public:
+	static const int maxWorkers = 32;
+	static const int dequeSize  = 1024;   // jobs queued per thread before they're run inline
+
+private:
+	typedef StealingDeque<Job, dequeSize> JobDeque;
+
+	struct WorkerStart
+	{
+		JobSystem *system;
+		int        number;   // of its deque
+	};
+
+	// deques[0] is shared by every thread that isn't a worker
+	JobDeque      deques[maxWorkers + 1];
+	Mutex         sharedLock;   // serializes the owner's end of deques[0]
+	Thread        workers[maxWorkers];
+	WorkerStart   starts[maxWorkers];
+	int           numWorkers;
+	DWORD         workerSlot;   // thread local, a worker's deque number
+
+	Semaphore     wakeups;
+	volatile long sleeping;
+	volatile long stopping;
+
+	JobSystem();
+	~JobSystem();
+	JobSystem(const JobSystem&);
+	JobSystem& operator=(const JobSystem&);
+
+	static void workerMain(void *pStart);
+	void work(const int number);
+
+	int  currentDeque() const;
+	void push(Job *job);
+	Job* next(const int number);
+	void execute(Job *job);
+	void finish(Job *job);
+
+public:
+	static JobSystem& get();
+
+	void init(Job& job, JobFunction function, void *pData,
+			  Job *parent=nullptr, const ProfileStage stage=stageJobs);
+	void setContinuation(Job& job, Job& continuation);
+
+	void run(Job& job);
+	void wait(const Job& job);
+	bool isDone(const Job& job) const;
+
+	void parallelFor(const int count, ParallelForFunction function, void *pData,
+					 const ProfileStage stage=stageJobs);
+
+	int getNumWorkers() const;
+};
+
+inline bool JobSystem::isDone(const Job& job) const { return job.unfinished == 0; }
+inline int  JobSystem::getNumWorkers()        const { return numWorkers; }
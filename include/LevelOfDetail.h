@@ -0,0 +1,72 @@
+#pragma once
+/*
+ * LevelOfDetail.h
+ *
+ * Picks how much detail to draw things with from how big they
+ * are on screen
+ */
+#include "Vec3f.h"
+
+
+/* ==================================================================
+ * ScreenProjection struct
+ *
+ * Enough of the camera to tell how big something is on screen,
+ * taken from the modelview and projection matrices once a frame
+ * ==================================================================
+ */
+struct ScreenProjection
+{
+	bool  perspective;
+	Vec3f eye;
+	float pixelSize;   // world size of a pixel, at a distance of 1 if perspective
+
+	ScreenProjection();
+	ScreenProjection(const float modelview[16], const float projection[16], const int viewportHeight);
+
+	bool  isValid() const;
+	float worldPerPixel(const Vec3f& point) const;
+	float pixelsAcross(const Vec3f& center, const float radius) const;
+};
+
+inline bool ScreenProjection::isValid() const { return pixelSize > 0.f; }
+
+
+enum DetailLevel
+{
+	detailHigh = 0,
+	detailMedium,
+	detailLow,
+	numDetailLevels
+};
+
+
+/* ==================================================================
+ * LevelOfDetail class
+ *
+ * Maps a size in pixels to a detail level. Changing level needs the
+ * size to clear the threshold by a margin, so things sitting right
+ * on a threshold don't pop back and forth as the camera moves
+ * ==================================================================
+ */
+class LevelOfDetail
+{
+public:
+	static const float defaultHysteresis;
+
+private:
+	float highPixels;    // at least this many pixels across draws in high detail
+	float mediumPixels;  // at least this many draws in medium detail
+	float hysteresis;    // fraction of a threshold to clear before changing level
+
+	DetailLevel levelFor(const float pixels) const;
+
+public:
+	LevelOfDetail(const float highPixels, const float mediumPixels,
+				  const float hysteresis=defaultHysteresis);
+
+	DetailLevel select(const float pixels, const DetailLevel current) const;
+	float getHysteresis() const;
+};
+
+inline float LevelOfDetail::getHysteresis() const { return hysteresis; }
@@ -0,0 +1,180 @@
+#pragma once
+/*
+ * LockFree.h
+ *
+ * Hand-offs between threads that never block any of them
+ */
+#include <Windows.h>
+#define WIN32_LEAN_AND_MEAN
+
+
+/* ==================================================================
+ * TripleBuffer class
+ *
+ * Passes the latest value from a writer thread to a reader thread.
+ * Each side owns a slot and the third sits between them: the writer
+ * fills its slot and swaps it for the middle one, marking it fresh,
+ * and the reader swaps its own for the middle one when it's fresh.
+ * Neither ever waits, values the reader didn't get to in time are
+ * just overwritten.
+ * ==================================================================
+ */
+template<typename T>
+class TripleBuffer
+{
+private:
+	enum { indexMask = 3, freshBit = 4 };
+
+	T slots[3];
+	volatile long middle;   // slot index, with freshBit if the writer has filled it since
+	int back;               // the writer's
+	int front;              // the reader's
+
+	TripleBuffer(const TripleBuffer&);
+	TripleBuffer& operator=(const TripleBuffer&);
+
+public:
+	TripleBuffer() : middle(1), back(0), front(2) { }
+
+	// Writer thread
+	T& getBack() { return slots[back]; }
+	void publish() { back = InterlockedExchange(&middle, back | freshBit) & indexMask; }
+
+	// Reader thread, acquire() returns false if nothing was published
+	// since the last time and getFront() is still the same value
+	bool isFresh() const { return (middle & freshBit) != 0; }
+	bool acquire()
+	{
+		if( !isFresh() )
+			return false;
+		front = InterlockedExchange(&middle, front) & indexMask;
+		return true;
+	}
+	const T& getFront() const { return slots[front]; }
+};
+
+
+/* ==================================================================
+ * SpscQueue class
+ *
+ * A bounded first in, first out queue from one producer thread to
+ * one consumer thread. Each side only writes its own index, after
+ * the item it covers, so no locks are needed. 'capacity' must be a
+ * power of two.
+ * ==================================================================
+ */
+template<typename T, int capacity>
+class SpscQueue
+{
+private:
+	T items[capacity];
+	volatile long head;   // next to pop, written by the consumer
+	volatile long tail;   // next to push, written by the producer
+
+	SpscQueue(const SpscQueue&);
+	SpscQueue& operator=(const SpscQueue&);
+
+public:
+	SpscQueue() : head(0), tail(0) { }
+
+	// Producer thread, returns false if the queue is full
+	bool push(const T& item)
+	{
+		const long t = tail;
+		if( t - head == capacity )
+			return false;
+		items[t & (capacity - 1)] = item;
+		InterlockedExchange(&tail, t + 1);
+		return true;
+	}
+
+	// Consumer thread, returns false if the queue is empty
+	bool pop(T& item)
+	{
+		const long h = head;
+		if( h == tail )
+			return false;
+		item = items[h & (capacity - 1)];
+		InterlockedExchange(&head, h + 1);
+		return true;
+	}
+};
+
+/* ==================================================================
+ * StealingDeque class
+ *
+ * A bounded deque of pointers with one owner thread, which pushes
+ * and pops at the bottom, last in first out, while any other thread
+ * can steal from the top, first in first out (Chase and Lev). The
+ * owner only contends with thieves over the last item, and then
+ * whoever wins the compare-exchange on 'top' gets it. 'capacity'
+ * must be a power of two.
+ * ==================================================================
+ */
+template<typename T, int capacity>
+class StealingDeque
+{
+private:
+	T * volatile  items[capacity];
+	volatile long top;      // next to steal, only ever moves up
+	volatile long bottom;   // next to push, written by the owner
+
+	StealingDeque(const StealingDeque&);
+	StealingDeque& operator=(const StealingDeque&);
+
+public:
+	StealingDeque() : top(0), bottom(0) { }
+
+	// Owner thread, returns false if the deque is full
+	bool push(T *item)
+	{
+		const long b = bottom;
+		if( b - top >= capacity )
+			return false;
+		items[b & (capacity - 1)] = item;
+		InterlockedExchange(&bottom, b + 1);
+		return true;
+	}
+
+	// Owner thread, returns nullptr if the deque is empty
+	T* pop()
+	{
+		const long b = bottom - 1;
+		InterlockedExchange(&bottom, b);   // a full barrier before reading top
+		const long t = top;
+
+		if( b - t < 0 )
+		{
+			InterlockedExchange(&bottom, t);
+			return nullptr;
+		}
+
+		T *item = items[b & (capacity - 1)];
+		if( b != t )
+			return item;
+
+		// The last one, race any thieves for it
+		if( InterlockedCompareExchange(&top, t + 1, t) != t )
+			item = nullptr;
+		InterlockedExchange(&bottom, t + 1);
+		return item;
+	}
+
+	// Any thread, returns nullptr if the deque is empty or another
+	// thread got the top item first
+	T* steal()
+	{
+		const long t = top;
+		MemoryBarrier();
+		const long b = bottom;
+		if( b - t <= 0 )
+			return nullptr;
+
+		T *item = items[t & (capacity - 1)];
+		if( InterlockedCompareExchange(&top, t + 1, t) != t )
+			return nullptr;
+		return item;
+	}
+
+	bool isEmpty() const { return bottom - top <= 0; }
+};
@@ -8,6 +8,11 @@
  *          Matthew Bayer
  */
 #include "TrainFiles/Utilities/ArcBallCam.H"
+#include "FrameArena.h"
+#include "LevelOfDetail.h"
+#include "Frustum.h"
+#include "Mat4.h"
+#include "TrainSimulation.h"
 
 #pragma warning(push)
 #pragma warning(disable:4312)
@@ -37,9 +42,35 @@ private:
 	MainWindow    *window;
 	ArcBallCam    arcballCam;
 
+	enum SceneryObject { scenerySphere = 0, sceneryTeapot, sceneryCone, numSceneryObjects };
+
+	// The camera this frame, kept here so picking and dragging never
+	// read it back from OpenGL, and the detail things were last drawn at
+	Mat4             modelviewMatrix;
+	Mat4             projectionMatrix;
+	int              viewport[4];
+	ScreenProjection projection;
+	Frustum          frustum;
+	DetailLevel      sceneryDetail[numSceneryObjects];
+	DetailLevel      trainDetail;
+
+	// Where the train is this frame
+	TrainPose trainPose;
+
 	// TODO: remove this and only use the value in window->curve
 	int selectedPoint;
 
+	// Overrides the window size when rendering offscreen (0 = use window)
+	int viewportWidth;
+	int viewportHeight;
+
+	// Scratch memory for the current frame, reset at the end of draw()
+	FrameArena frameArena;
+
+	// Frames drawn and frames that allocated (TRACK_ALLOCATIONS builds)
+	int frameNumber;
+	int allocatingFrames;
+
 public:
 	ViewType viewType;
 
@@ -50,22 +81,36 @@ public:
 
 	void pick();
 
+	void renderOffscreen(ViewType type, int width, int height, const float t);
+
 	void setWindow(MainWindow *w);
 	void setSelectedPoint(const int p);
 
 	MainWindow* getWindow() const;
 	int  getSelectedPoint() const;
+	int  getAllocatingFrames() const;
 
 private:
 	void resetArcball();
+	void updateCamera();
 	void setupProjection();
 
+	int viewWidth()  const;
+	int viewHeight() const;
+
 	void updateTextWidget( const float t );
+	void updateProfileWidget();
+	void checkFrameAllocations(const long allocations);
 	void openglFrameSetup();
+	DetailLevel selectDetail(const LevelOfDetail& lod, const Vec3f& center, const float radius,
+							 DetailLevel& current);
+
+	void drawScene(const float t);
 
 	void drawScenery(bool doShadows=false);
 	void drawCurve(const float t, bool drawPoints=false,  bool doShadows=false);
-	void drawTrain(const float t,  bool doShadows=false);
+	void drawClearance();
+	void drawTrain(const TrainPose& pose,  bool doShadows=false);
 	void drawSelectedControlPoint(bool doShadows=false);
 };
 
@@ -73,3 +118,6 @@ inline void MainView::setWindow(MainWindow *w) { window = w; }
 inline void MainView::setSelectedPoint(int p)  { selectedPoint = p; }
 inline MainWindow* MainView::getWindow() const { return window; }
 inline int  MainView::getSelectedPoint() const { return selectedPoint; }
+inline int  MainView::getAllocatingFrames() const { return allocatingFrames; }
+inline int  MainView::viewWidth()  const { return (viewportWidth  > 0) ? viewportWidth  : w(); }
+inline int  MainView::viewHeight() const { return (viewportHeight > 0) ? viewportHeight : h(); }
@@ -10,6 +10,11 @@
  */
 #include "MainView.h"
 #include "Curve.h"
+#include "AsyncTrackIO.h"
+#include "EditJournal.h"
+#include "UndoHistory.h"
+#include "ClearanceChecker.h"
+#include "TrainSimulation.h"
 
 #pragma warning(push)
 #pragma warning(disable:4312)
@@ -18,9 +23,11 @@
 #include <Fl/Fl_Group.h>
 #include <Fl/Fl_Button.h>
 #include <Fl/Fl_Output.h>
+#include <Fl/Fl_Multiline_Output.h>
 #include <Fl/Fl_Choice.h>
 #include <Fl/Fl_Slider.h>
 #include <Fl/Fl_Value_Slider.h>
+#include <Fl/Fl_Progress.h>
 #include <FL/fl_ask.h>
 #pragma warning(pop)
 
@@ -59,21 +66,53 @@ private:
 	Fl_Button  *pointRollMoreButton;
 	Fl_Button  *pointPitchLessButton;
 	Fl_Button  *pointRollLessButton;
+	Fl_Button  *undoButton;
+	Fl_Button  *redoButton;
 	Fl_Value_Slider *speedSlider;
 	Fl_Value_Slider *tensionSlider;
-
-	Curve curve;
+	Fl_Multiline_Output *profileOutput;
+	Fl_Button  *saveTraceButton;
+	Fl_Button  *exportMeshButton;
+	Fl_Button  *lodButton;
+	Fl_Button  *clearanceButton;
+	Fl_Output  *clearanceOutput;
+	Fl_Progress *trackIOProgress;
+
+	Curve        curve;
+	AsyncTrackIO trackIO;
+	EditJournal  journal;
+	size_t       journalMark; // records made before the running save started
+	bool         compacting;  // the running save is the journal's snapshot
+	UndoHistory  history;
+
+	ClearanceChecker clearance;
+	bool             checkingClearance;
+	unsigned int     clearanceRevision;  // of the snapshot last checked
 
 	bool animating;
 	bool isArcLengthParam;
 	bool shadows;
 	bool highlightSegPts;
+	bool levelOfDetail;
+	bool batchMode;       // never shown, errors go to stderr, not a dialog
 
 	float speed;
-	float rotation;
+	float rotation;       // the train's t as last drawn, or as last set
 	float rotationStep;
 
+	TrainSimulation simulation;   // declared last, so it stops first
+
 	void createWidgets();
+	bool loadBinaryPoints(const std::string& filename);
+	void setCurveSettings(const CurveType type, const float tension);
+	void openJournal(const std::string& filename);
+	void rebaseJournal(const std::string& filename);
+	void compactJournalAsync();
+	void compactJournal();
+	void snapshotJournal();
+	void closeJournal();
+	void reportError(const std::string& message);
+	void undoApplied(const UndoHistory::Result result, const int numPointsBefore);
 	float arcLengthStep(const float vel=1.f);
 
 public:
@@ -86,9 +125,9 @@ public:
 
 	float getSpeed()          const;
 	float getRotation()       const;
-	float& getRotation();
 	float getRotationStep()   const;
 	Curve& getCurve();
+	UndoHistory& getHistory();
 	ControlPointVector& getPoints();
 
 	void setSpeed(float spdAmt);
@@ -99,39 +138,66 @@ public:
 	bool isArcParam()  const;
 	bool isShadowed()  const;
 	bool isHighlightedSegPts() const;
+	bool isLevelOfDetail() const;
+	bool isBatchMode() const;
 
 	void toggleAnimating();
 	void toggleArcParam();
 	void toggleShadows();
 	void toggleHighlightSegPts();
+	void toggleLevelOfDetail();
+	void setLevelOfDetail(const bool enabled);
+	void setBatchMode(const bool enabled);
+	void startSimulation();
+	void flushTrainCommands();
+	bool hasNewTrainPose() const;
+	void readTrainPose(TrainPose& pose);
+	TrainPose trainPoseAt(const float t);
+
+	void toggleClearance();
+	void updateClearance();
+	bool isCheckingClearance() const;
+	const ClearanceChecker& getClearance() const;
 
 	void resetPoints();
-	void loadPoints(const std::string& filename);
-	void savePoints(const std::string& filename);
+	bool loadPoints(const std::string& filename);
+	bool savePoints(const std::string& filename);
+	void loadPointsAsync(const std::string& filename);
+	void savePointsAsync(const std::string& filename);
+	void pollTrackIO();
+	void exportMesh(const std::string& filename, const bool includePath);
+
+	void undo();
+	void redo();
 
 	void advanceTrain(int dir=1);
 
 	void damageMe();
 
-	void setDebugText(const std::string& text, const std::string& text1="");
+	void setDebugText(const char *text, const char *text1=nullptr);
+	void setProfileText(const char *text);
 };
 
 inline MainView& MainWindow::getView()             { return *view; }
 inline const MainView& MainWindow::getView() const { return *view; }
 inline float MainWindow::getSpeed()          const { return speed ; }
 inline float MainWindow::getRotation()       const { return rotation; }
-inline float& MainWindow::getRotation()            { return rotation; }
 inline float MainWindow::getRotationStep()   const { return rotationStep; }
 inline Curve& MainWindow::getCurve()               { return curve; }
+inline UndoHistory& MainWindow::getHistory()       { return history; }
 inline ControlPointVector& MainWindow::getPoints() { return curve.getControlPoints(); }
-inline void MainWindow::setSpeed(float s)    { speed = s; }
-inline void MainWindow::setRotation(float r) { rotation = r; }
 inline bool MainWindow::isAnimating() const  { return animating; }
 inline bool MainWindow::isArcParam()  const  { return isArcLengthParam; }
 inline bool MainWindow::isShadowed()  const  { return shadows; }
 inline bool MainWindow::isHighlightedSegPts() const { return highlightSegPts; }
-inline void MainWindow::toggleAnimating()    { animating = !animating; }
-inline void MainWindow::toggleArcParam()     { isArcLengthParam = !isArcLengthParam; }
+inline bool MainWindow::isLevelOfDetail() const     { return levelOfDetail; }
+inline bool MainWindow::isBatchMode() const         { return batchMode; }
+inline bool MainWindow::isCheckingClearance() const { return checkingClearance; }
+inline const ClearanceChecker& MainWindow::getClearance() const { return clearance; }
+inline bool MainWindow::hasNewTrainPose() const     { return simulation.hasNewPose(); }
 inline void MainWindow::toggleShadows()      { shadows = !shadows; }
 inline void MainWindow::toggleHighlightSegPts()     { highlightSegPts = !highlightSegPts; }
+inline void MainWindow::toggleLevelOfDetail()       { levelOfDetail = !levelOfDetail; }
+inline void MainWindow::setLevelOfDetail(const bool e) { levelOfDetail = e; }
+inline void MainWindow::setBatchMode(const bool e)  { batchMode = e; }
 inline void MainWindow::setViewType(int view) {viewTypeChoice->value(view);}
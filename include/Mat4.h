@@ -0,0 +1,57 @@
+#pragma once
+/*
+ * Mat4.h
+ *
+ * 4x4 matrices laid out like OpenGL's, so the camera can be built,
+ * kept and unprojected on the CPU without asking the driver
+ */
+#include "Vec3f.h"
+
+
+/* ==================================================================
+ * Mat4 class
+ *
+ * Column major like OpenGL, element (row, column) is at
+ * m[column * 4 + row], so data() can be handed straight to
+ * glLoadMatrixf(). The builders make the same matrices as the
+ * OpenGL and GLU calls they're named after, and multiplying on the
+ * right applies a transform first, as glMultMatrixf() does.
+ * ==================================================================
+ */
+class Mat4
+{
+private:
+	float m[16];
+
+public:
+	Mat4();   // identity
+	explicit Mat4(const float columnMajor[16]);
+
+	static Mat4 translation(const Vec3f& offset);
+	static Mat4 rotation(const float degrees, const Vec3f& axis);
+	static Mat4 fromRows(const Vec3f& x, const Vec3f& y, const Vec3f& z);
+	static Mat4 perspective(const float fovyDegrees, const float aspect,
+							const float zNear, const float zFar);
+	static Mat4 ortho(const float left, const float right, const float bottom, const float top,
+					  const float zNear, const float zFar);
+
+	Mat4 operator*(const Mat4& rhs) const;
+	Vec3f transformPoint(const Vec3f& point) const;
+
+	const float* data() const;
+	float operator()(const int row, const int column) const;
+};
+
+inline const float* Mat4::data() const { return m; }
+inline float Mat4::operator()(const int row, const int column) const { return m[column * 4 + row]; }
+
+
+/* project() - Window coordinates of 'world', like gluProject(), -- */
+/* false if it's level with the eye -------------------------------- */
+bool project(const Vec3f& world, const Mat4& modelview, const Mat4& projection,
+			 const int viewport[4], Vec3f& window);
+
+/* unProject() - World coordinates of a point in the window, like -- */
+/* gluUnProject(), false if the camera can't be inverted ----------- */
+bool unProject(const Vec3f& window, const Mat4& modelview, const Mat4& projection,
+			   const int viewport[4], Vec3f& world);
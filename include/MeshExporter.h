@@ -0,0 +1,126 @@
+#pragma once
+/*
+ * MeshExporter.h
+ *
+ * Writes the track's rails, ties and (optionally) the train path
+ * as an indexed triangle mesh, either as Wavefront OBJ text or in
+ * a compact binary format chosen by the file extension
+ *
+ * Binary .trm layout (little-endian):
+ *   TrackMeshHeader
+ *   one block per curve segment:
+ *     TrackMeshBlock
+ *     float    positions[numVertices][3]
+ *     unsigned indices[numRail + numTie + numPathTriangles][3]
+ *              (rails, then ties, then path, counted from the
+ *              block's first vertex)
+ */
+#include "Curve.h"
+#include "Threads.h"
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+
+#pragma pack(push, 1)
+struct TrackMeshHeader
+{
+	char             magic[4];      // "TMSH"
+	unsigned int     version;
+	unsigned int     headerSize;
+	unsigned int     flags;         // trackMeshHasPath
+	unsigned __int64 numBlocks;
+	unsigned __int64 numVertices;
+	unsigned __int64 numTriangles;
+};
+
+struct TrackMeshBlock
+{
+	unsigned int numVertices;
+	unsigned int numRailTriangles;
+	unsigned int numTieTriangles;
+	unsigned int numPathTriangles;
+};
+#pragma pack(pop)
+
+static const char         trackMeshMagic[4]    = { 'T', 'M', 'S', 'H' };
+static const unsigned int trackMeshVersion     = 1;
+static const unsigned int trackMeshHasPath     = 0x1;
+static const char         trackMeshExtension[] = ".trm";
+static const char         objMeshExtension[]   = ".obj";
+
+
+/* ==================================================================
+ * MeshExporter class
+ *
+ * Segments are tessellated in parallel a batch at a time, and each
+ * batch is written out on a worker thread while the next one is
+ * tessellated, so memory use is bounded by two batches no matter
+ * how long the track is. Segments are sampled as finely as the
+ * curve's (world space) tessellation tolerance needs.
+ * Throws TrackFileError if the file can't be written
+ * ==================================================================
+ */
+class MeshExporter
+{
+public:
+	static const int segmentsPerBatch = 2048;
+
+	// Tessellation of one segment, indices count from its first vertex
+	struct Piece
+	{
+		std::vector<float>        vertices;
+		std::vector<unsigned int> rails;
+		std::vector<unsigned int> ties;
+		std::vector<unsigned int> path;
+
+		unsigned __int64 firstVertex;  // in the whole mesh
+		std::string      text;         // OBJ lines, when writing OBJ
+
+		std::vector<float> params;     // scratch, t of each sample
+		std::vector<float> arcLengths; // scratch, to each sample
+	};
+
+private:
+	Curve& curve;
+
+	bool  includePath;
+	bool  binary;
+	FILE *file;
+
+	std::vector<Piece> batches[2];
+	int                numPieces[2];
+	int                firstSegment;  // of the batch being tessellated
+	int                filling;       // batch being tessellated
+	int                writing;       // batch the worker is writing
+	Thread             writer;
+	bool               writeFailed;
+
+	unsigned __int64 numVertices;
+	unsigned __int64 numTriangles;
+
+	MeshExporter(const MeshExporter&);
+	MeshExporter& operator=(const MeshExporter&);
+
+	static void tessellateTask(const int index, void *pExporter);
+	static void formatTask(const int index, void *pExporter);
+	static void run(void *pExporter);
+	void writeBatch(const int batch);
+	void finishWriting();
+
+public:
+	MeshExporter(Curve& curve);
+	~MeshExporter();
+
+	void exportMesh(const std::string& filename, const bool includePath);
+
+	unsigned __int64 getNumVertices()  const;
+	unsigned __int64 getNumTriangles() const;
+};
+
+inline unsigned __int64 MeshExporter::getNumVertices()  const { return numVertices; }
+inline unsigned __int64 MeshExporter::getNumTriangles() const { return numTriangles; }
+
+
+bool hasTrackMeshExtension(const std::string& filename);
@@ -0,0 +1,109 @@
+#pragma once
+/*
+ * PackedPoints.h
+ *
+ * Control points of very large tracks, quantized to a third of the
+ * memory
+ */
+#include "Curve.h"
+#include "Vec3f.h"
+
+#include <vector>
+
+
+/* ==================================================================
+ * PackedPoints class
+ *
+ * A closed track's control points in 8 bytes each rather than the
+ * 24 of a CtrlPoint. Points are grouped in tiles of consecutive
+ * points, and each position is stored as three 16 bit steps from
+ * its tile's corner, so the steps are only as coarse as the tile is
+ * big. Orientations are kept as directions only, folded onto an
+ * octahedron and stored as two 8 bit coordinates, which is exact for
+ * straight up. Tiles are packed in parallel.
+ *
+ * Their lengths are dropped. A Curve blends its points' orientations
+ * as they were given, so between two points whose orientations
+ * differ in length, as well as direction, its up vector leans toward
+ * the longer one and the packed curve's doesn't. They agree at the
+ * points, and everywhere for tracks with unit orientations.
+ *
+ * Segments are evaluated straight from the packed points, unpacking
+ * only the four each one needs, like the segments of a Curve of the
+ * same type and tension. The largest error of any point, measured
+ * while packing, is kept for the caller. The train can be run on
+ * them (TrainSimulation::advance() and poseAt()) without ever
+ * building a Curve, which is what -ride does.
+ * ==================================================================
+ */
+class PackedPoints
+{
+public:
+	static const int tileSize = 256;   // points, must be a power of two
+
+	struct Point
+	{
+		unsigned short position[3];   // steps from the tile's corner
+		signed char    orient[2];     // octahedral
+	};
+
+private:
+	struct Tile
+	{
+		Vec3f corner;   // the lowest position on each axis
+		Vec3f step;     // per axis, 0 if the tile is flat in that axis
+		float positionError;
+		float orientError;
+	};
+
+	CurveType type;
+	float     tension;
+	float     basis[4][4];
+
+	std::vector<Point> points;
+	std::vector<Tile>  tiles;
+
+	const ControlPointVector *packing;   // the points of the current pack()
+
+	float positionError;   // track units
+	float orientError;     // radians
+
+	static void packTask(const int index, void *pPacked);
+	void packTile(const int tile);
+
+	Vec3f positionOf(const int id) const;
+	Vec3f orientOf  (const int id) const;
+	void  pointsOf  (const int segment, Vec3f p[4]) const;
+	int   segmentAt (const float t, float& tUnit) const;
+
+public:
+	PackedPoints(const CurveType type=catmull, const float tension=1.f);
+
+	void pack(const ControlPointVector& points);
+	void unpack(ControlPointVector& points) const;
+
+	void setCurveType(const CurveType curveType);
+	void setTension(const float newTension);
+
+	CtrlPoint getPoint(const int id) const;
+
+	Vec3f getPosition   (const float t) const;
+	Vec3f getDirection  (const float t) const;
+	Vec3f getOrientation(const float t) const;
+
+	int numPoints()   const;
+	int numSegments() const;
+	CurveType getCurveType() const;
+	float     getTension()   const;
+
+	float  getPositionError() const;
+	float  getOrientError()   const;
+	size_t getMemoryUsed()    const;
+};
+
+inline int   PackedPoints::numPoints()        const { return points.size(); }
+inline int   PackedPoints::numSegments()      const { return points.size(); }
+inline CurveType PackedPoints::getCurveType() const { return type; }
+inline float PackedPoints::getTension()       const { return tension; }
+inline float PackedPoints::getPositionError() const { return positionError; }
+inline float PackedPoints::getOrientError()   const { return orientError; }
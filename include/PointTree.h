@@ -0,0 +1,72 @@
+#pragma once
+/*
+ * PointTree.h
+ *
+ * Persistent sequence of control points for snapshotting large curves
+ */
+#include "CtrlPoint.h"
+
+#include <memory>
+#include <vector>
+
+
+struct PointTreeNode;
+typedef std::shared_ptr<PointTreeNode> PointTreeNodePtr;
+
+/* ==================================================================
+ * PointTreeNode struct - a leaf holding a run of points, or an
+ * internal node holding up to PointTree::maxChildren subtrees
+ * ==================================================================
+ */
+struct PointTreeNode
+{
+	int                           count;     // points in this subtree
+	std::vector<CtrlPoint>        points;    // leaves only
+	std::vector<PointTreeNodePtr> children;  // internal nodes only
+
+	PointTreeNode() : count(0), points(), children() { }
+
+	bool   isLeaf() const { return children.empty(); }
+	size_t bytes()  const;
+};
+
+
+/* ==================================================================
+ * PointTree class
+ *
+ * A balanced tree of point chunks whose nodes are shared between
+ * copies, so copying a tree is O(1) and leaves the copy unaffected
+ * by later changes. A change copies only the O(log n) nodes on the
+ * path to the changed point, and only the first time each of them
+ * is changed after a copy was taken.
+ * Changes return the bytes they allocated, for memory accounting.
+ * ==================================================================
+ */
+class PointTree
+{
+public:
+	static const int maxLeafPoints = 64;
+	static const int maxChildren   = 32;
+
+private:
+	PointTreeNodePtr root;
+
+public:
+	PointTree();
+	PointTree(const std::vector<CtrlPoint>& points, size_t *bytes=nullptr);
+
+	int  size() const;
+	bool empty() const;
+
+	const CtrlPoint& at(int index) const;
+	void copyTo(std::vector<CtrlPoint>& points) const;
+
+	size_t set(const int index, const CtrlPoint& point);
+	size_t insert(const int index, const CtrlPoint& point);
+	size_t erase(const int index);
+
+	static bool diff(const PointTree& a, const PointTree& b, std::vector<int>& changed);
+};
+
+inline int  PointTree::size()  const { return root ? root->count : 0; }
+inline bool PointTree::empty() const { return size() == 0; }
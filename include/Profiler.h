@@ -0,0 +1,104 @@
+#pragma once
+/*
+ * Profiler.h
+ *
+ * Scoped per-stage timers recorded into a lock-free ring buffer,
+ * summarized per frame for display and dumped as a Chrome trace
+ */
+#include <Windows.h>
+#define WIN32_LEAN_AND_MEAN
+
+#include <string>
+
+enum ProfileStage {
+	stageFrameSetup = 0,
+	stageScenery,
+	stageCurve,
+	stageTrain,
+	stageShadows,
+	stagePick,
+	stageRegenerate,
+	stageFileLoad,
+	stageMeshExport,
+	stageClearance,
+	stageJobs,          // summed over every thread that ran them
+	numProfileStages
+};
+
+extern std::string ProfileStageNames[];
+
+
+/* ==================================================================
+ * Profiler class
+ *
+ * Any thread can record samples, each one claims a slot in the ring
+ * with an interlocked increment and publishes it by writing the slot's
+ * sequence number last, so readers can skip slots that are mid-write
+ * ==================================================================
+ */
+class Profiler
+{
+public:
+	static const int capacity = 8192; // must be a power of two
+
+private:
+	struct Sample
+	{
+		volatile long sequence; // index + 1 once the sample is complete
+		int           stage;
+		DWORD         threadId;
+		LONGLONG      start;
+		LONGLONG      end;
+	};
+
+	Sample        samples[capacity];
+	volatile long nextSample;
+
+	LONGLONG frequency;
+	LONGLONG epoch;
+
+	// Only touched by the thread that calls summarizeFrame()
+	long  lastSummarized;
+	float stageMs[numProfileStages];
+
+	Profiler();
+	Profiler(const Profiler&);
+	Profiler& operator=(const Profiler&);
+
+	bool readSample(const long index, Sample& copy) const;
+
+public:
+	static Profiler& get();
+
+	LONGLONG now() const;
+	void record(const ProfileStage stage, const LONGLONG start, const LONGLONG end);
+
+	void  summarizeFrame();
+	float getStageMs(const ProfileStage stage) const;
+
+	bool writeChromeTrace(const std::string& filename) const;
+};
+
+inline float Profiler::getStageMs(const ProfileStage stage) const { return stageMs[stage]; }
+
+
+/* ==================================================================
+ * ScopedTimer class - records a sample for its stage when destroyed
+ * ==================================================================
+ */
+class ScopedTimer
+{
+private:
+	const ProfileStage stage;
+	const LONGLONG     start;
+
+	ScopedTimer(const ScopedTimer&);
+	ScopedTimer& operator=(const ScopedTimer&);
+
+public:
+	explicit ScopedTimer(const ProfileStage stage)
+		: stage(stage)
+		, start(Profiler::get().now())
+	{ }
+	~ScopedTimer() { Profiler::get().record(stage, start, Profiler::get().now()); }
+};
@@ -0,0 +1,70 @@
+#pragma once
+/*
+ * SegmentTree.h
+ *
+ * Bounding volume hierarchy over the boxes of a track's segments,
+ * shared by the clearance check and the closest point queries
+ */
+#include "Frustum.h"
+#include "Vec3f.h"
+
+#include <vector>
+
+
+/* ==================================================================
+ * SegmentTree class
+ *
+ * Built top down by splitting at the median box center along the
+ * longest axis, so it is balanced whatever shape the track has.
+ * Nodes are stored parent first, node 0 is the root, and the
+ * segments of each leaf are a contiguous run of segment(i).
+ * Walking it is left to the caller, which knows what to prune.
+ * ==================================================================
+ */
+class SegmentTree
+{
+public:
+	static const int maxLeafSegments = 4;
+
+	struct Node
+	{
+		BoundingBox bounds;
+		int left, right;    // children, -1 in a leaf
+		int first, count;   // a leaf's range of segment(i)
+	};
+
+private:
+	std::vector<Node>  nodes;
+	std::vector<int>   order;     // segment numbers, grouped by leaf
+	std::vector<Vec3f> centers;   // of each segment's box
+
+	const std::vector<BoundingBox> *boxes;   // while building
+
+	SegmentTree(const SegmentTree&);
+	SegmentTree& operator=(const SegmentTree&);
+
+	int build(const int first, const int count);
+
+public:
+	SegmentTree();
+
+	void build(const std::vector<BoundingBox>& segmentBoxes);
+	void clear();
+
+	bool        isEmpty() const;
+	const Node& getNode(const int index) const;
+	int         segment(const int i) const;
+};
+
+inline bool SegmentTree::isEmpty() const { return nodes.empty(); }
+inline const SegmentTree::Node& SegmentTree::getNode(const int index) const { return nodes[index]; }
+inline int  SegmentTree::segment(const int i) const { return order[i]; }
+
+
+/* overlaps() - True if boxes 'a' and 'b' share any point ---------- */
+inline bool overlaps(const BoundingBox& a, const BoundingBox& b)
+{
+	return a.minimum.x() <= b.maximum.x() && b.minimum.x() <= a.maximum.x()
+		&& a.minimum.y() <= b.maximum.y() && b.minimum.y() <= a.maximum.y()
+		&& a.minimum.z() <= b.maximum.z() && b.minimum.z() <= a.maximum.z();
+}
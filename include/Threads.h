@@ -0,0 +1,114 @@
+#pragma once
+/*
+ * Threads.h
+ *
+ * Thin wrappers around the Win32 threading primitives
+ */
+#include <Windows.h>
+#define WIN32_LEAN_AND_MEAN
+
+
+/* ==================================================================
+ * Mutex class
+ * ==================================================================
+ */
+class Mutex
+{
+private:
+	CRITICAL_SECTION section;
+
+	Mutex(const Mutex&);
+	Mutex& operator=(const Mutex&);
+
+public:
+	Mutex()  { InitializeCriticalSection(&section); }
+	~Mutex() { DeleteCriticalSection(&section); }
+
+	inline void lock()   { EnterCriticalSection(&section); }
+	inline void unlock() { LeaveCriticalSection(&section); }
+};
+
+/* ==================================================================
+ * ScopedLock class - holds a Mutex for the lifetime of the object
+ * ==================================================================
+ */
+class ScopedLock
+{
+private:
+	Mutex& mutex;
+
+	ScopedLock(const ScopedLock&);
+	ScopedLock& operator=(const ScopedLock&);
+
+public:
+	explicit ScopedLock(Mutex& mutex) : mutex(mutex) { mutex.lock(); }
+	~ScopedLock() { mutex.unlock(); }
+};
+
+
+/* ==================================================================
+ * Semaphore class
+ * ==================================================================
+ */
+class Semaphore
+{
+private:
+	HANDLE handle;
+
+	Semaphore(const Semaphore&);
+	Semaphore& operator=(const Semaphore&);
+
+public:
+	Semaphore(const long initialCount, const long maxCount)
+		: handle(CreateSemaphore(NULL, initialCount, maxCount, NULL))
+	{ }
+	~Semaphore() { CloseHandle(handle); }
+
+	inline void wait()                 { WaitForSingleObject(handle, INFINITE); }
+	inline void post(const long n = 1) { ReleaseSemaphore(handle, n, NULL); }
+};
+
+
+/* ==================================================================
+ * Thread class
+ *
+ * Runs a single function on its own OS thread,
+ * the destructor joins the thread if it is still running
+ * ==================================================================
+ */
+class Thread
+{
+public:
+	typedef void (*Function)(void *pData);
+
+private:
+	HANDLE   handle;
+	Function function;
+	void    *data;
+
+	Thread(const Thread&);
+	Thread& operator=(const Thread&);
+
+	static unsigned __stdcall entryPoint(void *pThread);
+
+public:
+	Thread();
+	~Thread();
+
+	void start(Function function, void *pData);
+	void join();
+
+	bool isRunning() const;
+};
+
+inline bool Thread::isRunning() const { return handle != NULL; }
+
+
+/* numHardwareThreads() - Number of logical processors in the system */
+int numHardwareThreads();
+
+/* parallelFor() - Calls function(i, pData) for every i in [0,count) */
+/* spread over the hardware threads, returns when all calls are done */
+/* A count of 1 runs on the calling thread. 'function' must not throw */
+typedef void (*ParallelForFunction)(const int index, void *pData);
+void parallelFor(const int count, ParallelForFunction function, void *pData);
@@ -0,0 +1,152 @@
+#pragma once
+/*
+ * TrackFile.h
+ *
+ * Versioned binary track format that is memory mapped and read
+ * in place, alongside the plain text format used by the tracks/ files
+ *
+ * Layout (little-endian):
+ *   TrackFileHeader
+ *   float positions   [numPoints * 3]  at header.positionsOffset
+ *   float orientations[numPoints * 3]  at header.orientationsOffset
+ *
+ * Version 2 adds the curve type and tension to the header. If the
+ * trackFileCompressed flag is set, positionsOffset instead holds
+ * payloadSize bytes of zlib data that inflate to the positions array
+ * followed directly by the orientations array (orientationsOffset is 0)
+ *
+ * Large text tracks are also read through a mapping, split into
+ * chunks that are parsed in parallel (see readTextTrackFile)
+ */
+#include "Curve.h"
+
+#include <Windows.h>
+#define WIN32_LEAN_AND_MEAN
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#pragma pack(push, 1)
+struct TrackFileHeader
+{
+	char             magic[4];   // "TRAK"
+	unsigned int     version;
+	unsigned int     headerSize;
+	unsigned int     flags;      // always 0 in version 1
+	unsigned __int64 numPoints;
+	unsigned __int64 positionsOffset;
+	unsigned __int64 orientationsOffset;
+
+	// Version 2
+	unsigned int     curveType;
+	float            tension;
+	unsigned __int64 payloadSize; // compressed bytes at positionsOffset
+};
+#pragma pack(pop)
+
+static const char         trackFileMagic[4]    = { 'T', 'R', 'A', 'K' };
+static const unsigned int trackFileVersion     = 2;
+static const unsigned int trackFileV1Size      = 40; // header size in version 1
+static const unsigned int trackFileCompressed  = 0x1;
+static const char         trackFileExtension[] = ".trk";
+static const char         trackFileCompressedExtension[] = ".trz";
+
+
+class TrackFileError : public std::runtime_error
+{
+public:
+	TrackFileError(const std::string& what_arg) : std::runtime_error(what_arg) { }
+};
+
+
+/* ==================================================================
+ * MappedFile class
+ *
+ * Maps a whole file read-only for as long as the object lives
+ * Throws TrackFileError if the file can't be opened or mapped
+ * ==================================================================
+ */
+class MappedFile
+{
+private:
+	HANDLE      file;
+	HANDLE      mapping;
+	const char *view;    // nullptr for an empty file
+	size_t      size;
+
+	MappedFile(const MappedFile&);
+	MappedFile& operator=(const MappedFile&);
+
+	void close();
+
+public:
+	MappedFile(const std::string& filename);
+	~MappedFile();
+
+	const char* data() const;
+	size_t      getSize() const;
+};
+
+inline const char* MappedFile::data()    const { return view; }
+inline size_t      MappedFile::getSize() const { return size; }
+
+
+/* ==================================================================
+ * MappedTrack class
+ *
+ * Maps a binary track file read-only, the point arrays are
+ * used directly out of the mapping without any parsing
+ * Throws TrackFileError if the file can't be mapped or is malformed
+ * ==================================================================
+ */
+class MappedTrack
+{
+private:
+	MappedFile file;
+
+	const TrackFileHeader *header;
+	const float           *positionData;
+	const float           *orientationData;
+	std::vector<float>     inflated;       // both arrays, if compressed
+
+	MappedTrack(const MappedTrack&);
+	MappedTrack& operator=(const MappedTrack&);
+
+	void inflate(const std::string& filename);
+
+public:
+	MappedTrack(const std::string& filename);
+	~MappedTrack();
+
+	size_t numPoints() const;
+	const float* positions() const;
+	const float* orientations() const;
+
+	bool      hasCurveSettings() const;
+	CurveType curveType() const;
+	float     tension() const;
+
+	void copyTo(ControlPointVector& points) const;
+};
+
+inline size_t MappedTrack::numPoints() const { return static_cast<size_t>(header->numPoints); }
+inline const float* MappedTrack::positions()    const { return positionData; }
+inline const float* MappedTrack::orientations() const { return orientationData; }
+inline bool MappedTrack::hasCurveSettings() const { return header->version >= 2; }
+inline CurveType MappedTrack::curveType()   const { return static_cast<CurveType>(header->curveType); }
+inline float MappedTrack::tension()         const { return header->tension; }
+
+
+bool isBinaryTrackFile(const std::string& filename);
+bool hasExtension(const std::string& filename, const std::string& extension);
+bool hasBinaryTrackExtension(const std::string& filename);
+bool hasCompressedTrackExtension(const std::string& filename);
+
+void writeBinaryTrackFile(const std::string& filename, const Curve& curve, const bool compress=false);
+void writeBinaryTrackFile(const std::string& filename, const ControlPointVector& points,
+						  const CurveType curveType, const float tension, const bool compress=false);
+
+void readTextTrackFile(const std::string& filename, ControlPointVector& points,
+					   volatile long *progress=nullptr);
+void writeTextTrackFile(const std::string& filename, const ControlPointVector& points);
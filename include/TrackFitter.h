@@ -0,0 +1,102 @@
+#pragma once
+/*
+ * TrackFitter.h
+ *
+ * Fits a curve with few control points to a dense polyline, such as
+ * a surveyed track
+ */
+#include "Curve.h"
+
+#include <vector>
+
+
+/* ==================================================================
+ * TrackFitter class
+ *
+ * The polyline is taken as a closed loop, like every track. It is
+ * first decimated by Douglas-Peucker, streamed through in chunks
+ * that are simplified in parallel (their ends are always kept), and
+ * the kept samples become the control points. Every segment type
+ * is linear in its control points, so their positions are then
+ * refined by least squares against all the samples, solving the
+ * normal equations by conjugate gradients. Samples start spread
+ * by length along their span and are moved to where the fitted
+ * curve is closest to them between fits. Spans still further
+ * than the tolerance from the polyline are split at their worst
+ * sample and the fit repeated.
+ *
+ * Lines are only decimated, Douglas-Peucker already holds them to
+ * the tolerance.
+ * ==================================================================
+ */
+class TrackFitter
+{
+public:
+	static const float defaultTolerance;   // track units
+	static const float defaultTension;     // of cardinal cubics
+	static const int   maxRounds;          // of fitting and splitting
+
+private:
+	// Sums over one span's samples of the basis weights' outer
+	// products and the weighted sample positions
+	struct SpanSums
+	{
+		double weights[4][4];
+		double positions[4][3];
+	};
+
+	CurveType type;
+	float     tension;
+	float     tolerance;
+	float     basis[4][4];   // weight of each control point, by powers of t
+
+	const ControlPointVector *samples;
+	int                       numSamples;   // not counting a repeated first sample
+
+	std::vector<char>     keep;      // per sample, and one more for the loop's end
+	std::vector<int>      kept;      // sample indices of the control points
+	std::vector<char>     fresh;     // per span, if its samples need spreading
+	std::vector<float>    params;    // per sample, its t on its span
+	std::vector<float>    fitted[3]; // control point positions per axis
+	std::vector<SpanSums> sums;
+	std::vector<float>    errors;    // per span, the worst sample's distance
+	std::vector<int>      worst;     // per span, that sample
+	int                   numChunks; // of the current parallelFor
+
+	int   numRounds;
+	float maxError;
+
+	TrackFitter(const TrackFitter&);
+	TrackFitter& operator=(const TrackFitter&);
+
+	const Vec3f& sample(const int index) const;
+	void weightsAt(const float t, float w[4]) const;
+
+	void decimate();
+	void decimateChunk(const int first, const int last);
+	void solve();
+	void multiply(const double ridge, const std::vector<double>& x, std::vector<double>& y) const;
+
+	void spreadSpan(const int span);
+	void sumSpan(const int span);
+	void measureSpan(const int span);
+	void spanCubic(const int span, float c[3][4]) const;
+	static float closest(const float c[3][4], const float q[3], float& t);
+
+	static void decimateTask(const int index, void *pFitter);
+	static void spreadTask(const int index, void *pFitter);
+	static void sumTask(const int index, void *pFitter);
+	static void measureTask(const int index, void *pFitter);
+
+public:
+	TrackFitter(const CurveType type, const float tolerance=defaultTolerance,
+				const float tension=defaultTension);
+
+	void fit(const ControlPointVector& polyline, ControlPointVector& points);
+
+	int   getNumRounds() const;
+	float getMaxError() const;
+};
+
+inline int   TrackFitter::getNumRounds() const { return numRounds; }
+inline float TrackFitter::getMaxError()  const { return maxError; }
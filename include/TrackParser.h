@@ -0,0 +1,104 @@
+#pragma once
+/*
+ * TrackParser.h
+ *
+ * Streaming parser for the plain text track format, shared by
+ * MainWindow::loadPoints and the framework's World::readPoints
+ *
+ * Format:
+ *   [optional] a line holding just the number of points (advisory,
+ *              but it has to be a whole number the file could hold)
+ *   one line per point: x y z [ox oy oz]
+ *   '#' starts a comment that runs to the end of the line
+ */
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+
+class TrackParseError : public std::runtime_error
+{
+private:
+	int lineNumber;
+
+public:
+	TrackParseError(const std::string& what_arg, const int lineNumber)
+		: std::runtime_error(what_arg)
+		, lineNumber(lineNumber)
+	{ }
+
+	int line() const { return lineNumber; }
+};
+
+
+/* ==================================================================
+ * TrackRow struct - one point's worth of values from a track file
+ * ==================================================================
+ */
+struct TrackRow
+{
+	float pos[3];
+	float orient[3]; // (0,1,0) if the row only had a position
+	int   line;
+};
+
+
+/* ==================================================================
+ * TrackParser class
+ *
+ * Reads the file through a large buffer one line at a time, numbers
+ * are converted in place without copying or NUL-terminating them
+ * Can also parse a range of memory, such as one chunk of a mapped file
+ * Throws TrackParseError if the file can't be opened or a line is bad
+ * ==================================================================
+ */
+class TrackParser
+{
+private:
+	static const size_t bufferSize       = 1 << 20;
+	static const size_t maxReservePoints = 1 << 24;  // beyond this, grow as points are read
+
+	std::string       filename;
+	FILE             *file;         // nullptr when parsing memory
+	std::vector<char> buffer;
+	const char       *cursor;       // unparsed bytes
+	const char       *limit;
+	bool              atEof;
+	int               lineNumber;
+	size_t            expected;
+	double            maxExpected;  // the largest believable point count
+
+	TrackRow pending;
+	bool     hasPending;
+
+	TrackParser(const TrackParser&);
+	TrackParser& operator=(const TrackParser&);
+
+	bool nextLine(const char *&first, const char *&last);
+	int  parseLine(const char *first, const char *last, float *values, const int maxValues);
+	bool readRow(TrackRow& row, bool allowCount);
+
+	void error(const std::string& message) const;
+
+public:
+	TrackParser(const std::string& filename);
+	TrackParser(const std::string& filename, const char *first, const char *last,
+				const int firstLine=0, const bool allowCount=true);
+	~TrackParser();
+
+	bool next(TrackRow& row);
+
+	// The count from the file, only ever as many points as its bytes
+	// could hold, though a chunk can't tell how big the file around it is
+	size_t expectedPoints() const;
+	size_t pointsToReserve() const;
+	int    linesRead() const;
+};
+
+inline size_t TrackParser::expectedPoints()  const { return expected; }
+inline size_t TrackParser::pointsToReserve() const { return (expected < maxReservePoints) ? expected : maxReservePoints; }
+inline int    TrackParser::linesRead()      const { return lineNumber; }
+
+
+const char* parseFloat(const char *first, const char *last, float& value);
@@ -0,0 +1,86 @@
+#pragma once
+/*
+ * TrackProjector.h
+ *
+ * Finds the closest point on the track to points in space
+ */
+#include "Curve.h"
+#include "Frustum.h"
+#include "SegmentTree.h"
+#include "Vec3f.h"
+
+#include <vector>
+
+
+/* TrackProjection struct - where a point is closest to the track -- */
+struct TrackProjection
+{
+	int   segment;           // -1 if the track has no segments
+	float t;                 // on the segment, the curve's t is segment + t
+	float distance;          // from the query point to 'point'
+	Vec3f point;
+	Vec3f direction, up, side;   // the track's frame at 'point'
+};
+
+
+/* ==================================================================
+ * TrackProjector class
+ *
+ * Every segment type is a cubic in t, so each segment's polynomial
+ * coefficients are taken with a tight box around its Bezier hull,
+ * and a SegmentTree is built over the boxes. A query
+ * walks the tree nearest box first, skipping boxes further away
+ * than the best point found so far, and finds the closest point
+ * on each remaining segment by Newton iteration on the derivative
+ * of the squared distance, started from each local minimum of a
+ * few samples.
+ *
+ * The tables are rebuilt whenever the curve's revision changes.
+ * Batches are split into chunks that are projected in parallel.
+ * ==================================================================
+ */
+class TrackProjector
+{
+public:
+	// Newton starts from the local minima of a few samples, more
+	// on segments that turn further
+	enum { minStartSamples = 4, maxStartSamples = 16 };
+	static const float turnPerSample;   // radians
+	static const int   maxIterations;
+
+	// p(t) = c[0] + c[1] t + c[2] t^2 + c[3] t^3, one row per axis
+	struct Cubic
+	{
+		float c[3][4];
+		int   numSamples;
+	};
+
+private:
+	std::vector<Cubic>       cubics;
+	std::vector<BoundingBox> boxes;
+	SegmentTree              tree;
+
+	Curve       *curve;
+	unsigned int revision;
+
+	// The batch being projected by parallelFor
+	const std::vector<Vec3f>     *batchPoints;
+	std::vector<TrackProjection> *batchResults;
+	int                           numChunks;
+
+	TrackProjector(const TrackProjector&);
+	TrackProjector& operator=(const TrackProjector&);
+
+	void update(Curve& curve);
+
+	float closestOnSegment(const int segment, const float point[3], float& t) const;
+	void  projectPoint(const Vec3f& point, const int hint, TrackProjection& result) const;
+	static void projectTask(const int index, void *pProjector);
+
+public:
+	TrackProjector();
+
+	TrackProjection project(Curve& curve, const Vec3f& point);
+	void project(Curve& curve, const std::vector<Vec3f>& points,
+				 std::vector<TrackProjection>& results);
+};
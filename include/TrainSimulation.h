@@ -0,0 +1,118 @@
+#pragma once
+/*
+ * TrainSimulation.h
+ *
+ * Moves the train along the track on its own thread
+ */
+#include "CurveSnapshot.h"
+#include "LockFree.h"
+#include "Threads.h"
+#include "Vec3f.h"
+
+#include <vector>
+
+class Curve;
+class PackedPoints;
+
+
+/* TrainPose struct - Where the train is and which way it faces ---- */
+struct TrainPose
+{
+	bool  valid;        // false until the train is on a track with segments
+	float t;
+	Vec3f position;
+	Vec3f tangent;      // forward
+	Vec3f normal;       // up
+	Vec3f binormal;     // normal x tangent
+	unsigned int revision;   // of the curve it was placed on
+	unsigned int positions;  // setPosition commands applied before it
+
+	TrainPose();
+};
+
+
+/* ==================================================================
+ * TrainSimulation class
+ *
+ * Steps the train a fixed number of times a second on its own
+ * thread, reading the track from the curve's published snapshots,
+ * so a slow frame doesn't hold the train up and the reverse. The
+ * interface changes the simulation by posting commands to a
+ * lock-free queue, and each step that moves the train, or finds
+ * the track changed under it, hands its pose to the view through
+ * a triple buffer. Commands that don't fit in the queue wait on
+ * the interface thread, in order, until there's room.
+ *
+ * Poses and steps can also be taken on packed points, for tracks
+ * too large to keep as a curve.
+ * ==================================================================
+ */
+class TrainSimulation
+{
+public:
+	static const int stepsPerSecond;
+
+	enum CommandType
+	{
+		setAnimating = 0,   // value is 0 or 1
+		setArcLength,       // value is 0 or 1
+		setSpeed,
+		setPosition,        // t on the track
+		step                // value is the direction and size, in steps
+	};
+
+	struct Command
+	{
+		CommandType type;
+		float       value;
+	};
+
+private:
+	const Curve *curve;
+	Thread       thread;
+	volatile long stopping;
+
+	SpscQueue<Command, 256> commands;
+	TripleBuffer<TrainPose> poses;
+
+	// Only the interface thread touches these
+	std::vector<Command> overflow;   // waiting for room in the queue
+	unsigned int positionsPosted;
+
+	// Only the simulation thread touches these once it's started
+	float t;
+	float speed;
+	bool  animating;
+	bool  arcLength;
+	unsigned int positionsApplied;
+
+	TrainSimulation(const TrainSimulation&);
+	TrainSimulation& operator=(const TrainSimulation&);
+
+	static void run(void *pSimulation);
+	void simulate();
+
+public:
+	TrainSimulation();
+	~TrainSimulation();
+
+	void start(const Curve& curve, const float t, const float speed,
+			   const bool animating, const bool arcLength);
+	void stop();
+	bool isRunning() const;
+
+	void post(const CommandType type, const float value=0.f);
+	void flush();
+	bool hasNewPose() const;
+	bool readPose(TrainPose& pose);
+
+	static TrainPose poseAt(const CurveSnapshot& curve, const float t);
+	static TrainPose poseAt(const PackedPoints& track, const float t);
+	static float advance(const CurveSnapshot& curve, const float t, const float steps,
+						 const float speed, const bool arcLength);
+	static float advance(const PackedPoints& track, const float t, const float steps,
+						 const float speed, const bool arcLength);
+};
+
+inline bool TrainSimulation::isRunning()  const { return thread.isRunning(); }
+inline bool TrainSimulation::hasNewPose() const { return poses.isFresh(); }
@@ -0,0 +1,115 @@
+#pragma once
+/*
+ * UndoHistory.h
+ *
+ * Undo/redo for curve edits, built on PointTree snapshots
+ */
+#include "PointTree.h"
+#include "CurveSegments.h"
+
+#include <vector>
+
+class Curve;
+
+
+/* ==================================================================
+ * UndoHistory class
+ *
+ * Mirrors the curve's points in a PointTree that's kept up to date
+ * as the curve reports each edit. An undo step keeps the trees from
+ * before and after it, which share all but the changed paths, so a
+ * step costs O(log n) memory per point it changed rather than a copy
+ * of the track. The oldest steps are dropped to stay in the budget.
+ *
+ * Edits between beginStep() and endStep() are undone together, any
+ * edit made outside a step is a step of its own. Changes to the
+ * curve type or tension are steps too, and a run of tension changes
+ * with nothing in between, such as a slider drag, is one step.
+ * ==================================================================
+ */
+class UndoHistory
+{
+public:
+	static const size_t defaultMemoryBudget = 64 << 20;
+
+	enum Result
+	{
+		nothingDone = 0,
+		pointsEdited,    // the curve was edited in place
+		pointsReplaced,  // all of the curve's points were replaced
+		curveReplaced    // a whole other track, such as a load, was swapped in
+	};
+
+private:
+	enum StepKind
+	{
+		noEdits = 0,
+		editPoints,      // points changed in place
+		insertPoint,     // one point inserted at 'index'
+		deletePoint,     // one point deleted at 'index'
+		changeSettings,  // only the curve type or tension changed
+		replacePoints,   // several inserts or deletes at once
+		replaceCurve     // a whole other track, such as loading one
+	};
+
+	struct Step
+	{
+		StepKind  kind;
+		int       index;
+		PointTree before, after;
+		CurveType typeBefore, typeAfter;
+		float     tensionBefore, tensionAfter;
+		size_t    bytes;    // allocated by this step's changes
+	};
+
+	std::vector<Step> steps;
+	size_t            position;   // steps before this are done, the rest can be redone
+
+	PointTree current;            // mirrors the curve
+	CurveType currentType;
+	float     currentTension;
+
+	Step   pending;
+	int    stepDepth;
+	bool   applying;              // ignore the curve's reports while undoing
+
+	size_t memoryUsed;
+	size_t memoryBudget;
+
+	UndoHistory(const UndoHistory&);
+	UndoHistory& operator=(const UndoHistory&);
+
+	void edited(const StepKind kind, const int index, const size_t bytes);
+	void push(const Step& step);
+	void trim();
+	Result apply(Curve& curve, const Step& step, const bool forward);
+
+public:
+	UndoHistory(const size_t memoryBudget=defaultMemoryBudget);
+
+	void reset(const Curve& curve);
+	void recordReplace(const Curve& curve);
+
+	void beginStep();
+	void endStep();
+	void closeSteps();
+
+	// Called by the curve as it's edited
+	void pointChanged(const int index, const CtrlPoint& point);
+	void pointInserted(const int index, const CtrlPoint& point);
+	void pointErased(const int index);
+	void settingsChanged(const CurveType type, const float tension);
+
+	Result undo(Curve& curve);
+	Result redo(Curve& curve);
+
+	bool canUndo() const;
+	bool canRedo() const;
+
+	void   setMemoryBudget(const size_t bytes);
+	size_t getMemoryUsed() const;
+};
+
+inline bool   UndoHistory::canUndo() const       { return position > 0; }
+inline bool   UndoHistory::canRedo() const       { return position < steps.size(); }
+inline size_t UndoHistory::getMemoryUsed() const { return memoryUsed; }
@@ -179,6 +179,15 @@ inline Vec3f operator-(const Vec3f& lhs, const Vec3f& rhs)
 	return result;
 }
 
+// a - b, since operator- above gives b - a (which lerp() and the
+// track code written against it rely on, so it stays as it is)
+inline Vec3f difference(const Vec3f& a, const Vec3f& b)
+{
+	Vec3f result(a);
+	result -= b;
+	return result;
+}
+
 inline Vec3f operator*(const Vec3f& lhs, const float rhs)
 {
 	Vec3f result(lhs);
@@ -0,0 +1,56 @@
+/*
+ * AllocationCounter.cpp
+ */
+#include "AllocationCounter.h"
+
+#ifdef TRACK_ALLOCATIONS
+
+#include <cstdlib>
+#include <new>
+
+// Thread local, so only the thread that asks is counted
+static __declspec(thread) long allocationCount = 0;
+
+long numAllocations()
+{
+	return allocationCount;
+}
+
+void* operator new(size_t size)
+{
+	++allocationCount;
+	void *p = malloc(size ? size : 1);
+	if( p == nullptr )
+		throw std::bad_alloc();
+	return p;
+}
+
+void* operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) throw()
+{
+	++allocationCount;
+	return malloc(size ? size : 1);
+}
+
+void* operator new[](size_t size, const std::nothrow_t& nothrow) throw()
+{
+	return operator new(size, nothrow);
+}
+
+void operator delete(void *p)   throw() { free(p); }
+void operator delete[](void *p) throw() { free(p); }
+void operator delete(void *p, const std::nothrow_t&)   throw() { free(p); }
+void operator delete[](void *p, const std::nothrow_t&) throw() { free(p); }
+
+#else
+
+long numAllocations()
+{
+	return 0;
+}
+
+#endif
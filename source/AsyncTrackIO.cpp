@@ -0,0 +1,191 @@
+/*
+ * AsyncTrackIO.cpp
+ */
+#include "AsyncTrackIO.h"
+#include "TrackFile.h"
+#include "TrackParser.h"
+#include "Profiler.h"
+
+#include <exception>
+#include <new>
+#include <string>
+
+using std::string;
+
+
+AsyncTrackIO::AsyncTrackIO()
+	: worker()
+	, operation(noOperation)
+	, finished(0)
+	, progress(0)
+	, building(0)
+	, filename()
+	, error()
+	, loadedCurve(nullptr)
+	, points()
+	, curveType(lines)
+	, tension(0.f)
+{ }
+
+AsyncTrackIO::~AsyncTrackIO()
+{
+	// Let a save finish writing its file rather than leave it truncated
+	worker.join();
+	delete loadedCurve;
+}
+
+/* startLoad() - Starts loading 'filename' into a new curve ------ */
+/* Text and version 1 tracks use the current curve's settings ---- */
+/* Returns false if another load or save is still running -------- */
+bool AsyncTrackIO::startLoad(const string& filename, const Curve& current)
+{
+	if( isBusy() )
+		return false;
+
+	this->filename = filename;
+	error.clear();
+	operation      = loadOperation;
+	finished       = 0;
+	progress       = 0;
+	building       = 0;
+
+	loadedCurve = new Curve(current.getCurveType());
+	loadedCurve->tension = current.tension;
+
+	worker.start(&AsyncTrackIO::run, this);
+	return true;
+}
+
+/* startSave() - Snapshots the curve and starts writing it to 'filename' */
+/* Returns false if another load or save is still running -------- */
+bool AsyncTrackIO::startSave(const string& filename, const Curve& curve)
+{
+	if( isBusy() )
+		return false;
+
+	this->filename = filename;
+	error.clear();
+	operation      = saveOperation;
+	finished       = 0;
+	progress       = 0;
+	building       = 0;
+
+	points    = curve.getControlPoints();
+	curveType = curve.getCurveType();
+	tension   = curve.tension;
+
+	worker.start(&AsyncTrackIO::run, this);
+	return true;
+}
+
+/* poll() - Called between frames on the UI thread --------------- */
+/* Finishes the current operation if the worker is done with it, - */
+/* a finished load is swapped into 'curve' ----------------------- */
+AsyncTrackIO::Result AsyncTrackIO::poll(Curve& curve)
+{
+	if( !isBusy() )
+		return idle;
+	if( finished == 0 )
+		return running;
+
+	worker.join();
+
+	const Operation done = operation;
+	operation = noOperation;
+
+	if( !error.empty() )
+	{
+		delete loadedCurve;
+		loadedCurve = nullptr;
+		ControlPointVector().swap(points);
+		return failed;
+	}
+
+	if( done == loadOperation )
+	{
+		curve.swap(*loadedCurve);
+
+		// loadedCurve now holds the old points and segments
+		delete loadedCurve;
+		loadedCurve = nullptr;
+		return loaded;
+	}
+
+	ControlPointVector().swap(points);
+	return saved;
+}
+
+/* getProgress() - Fraction of the current operation that's done - */
+float AsyncTrackIO::getProgress() const
+{
+	// Reading is most of a load, building segments is the rest
+	if( building != 0 )
+		return 0.9f;
+	return 0.9f * progress / 1000.f;
+}
+
+/* run() - Worker thread entry point ----------------------------- */
+void AsyncTrackIO::run(void *pIO)
+{
+	AsyncTrackIO *io = reinterpret_cast<AsyncTrackIO*>(pIO);
+
+	try {
+		if( io->operation == loadOperation )
+			io->load();
+		else
+			io->save();
+	} catch(TrackFileError& e) {
+		io->error = e.what();
+	} catch(TrackParseError& e) {
+		io->error = e.what();
+	} catch(std::bad_alloc&) {
+		io->error = "Error - out of memory reading " + io->filename;
+	} catch(std::exception& e) {
+		// Nothing may escape the worker, it would end the program
+		io->error = "Error - " + io->filename + ": " + e.what();
+	} catch(...) {
+		io->error = "Error - unexpected failure on " + io->filename;
+	}
+
+	// Publish the results only once they're all written
+	InterlockedExchange(&io->finished, 1);
+}
+
+/* load() - Reads the file and builds the new curve's segments --- */
+void AsyncTrackIO::load()
+{
+	ScopedTimer timer(stageFileLoad);
+
+	ControlPointVector newPoints;
+
+	loadedCurve->beginEdit();
+	if( isBinaryTrackFile(filename) )
+	{
+		MappedTrack track(filename);
+		track.copyTo(newPoints);
+		if( track.hasCurveSettings() )
+		{
+			loadedCurve->setCurveType(track.curveType());
+			loadedCurve->tension = track.tension();
+		}
+	}
+	else
+	{
+		readTextTrackFile(filename, newPoints, &progress);
+	}
+	loadedCurve->swapPoints(newPoints);
+
+	InterlockedExchange(&building, 1);
+	loadedCurve->commitEdit();
+}
+
+/* save() - Writes the snapshot in the format the extension asks for */
+void AsyncTrackIO::save()
+{
+	if( hasBinaryTrackExtension(filename) )
+		writeBinaryTrackFile(filename, points, curveType, tension, hasCompressedTrackExtension(filename));
+	else
+		writeTextTrackFile(filename, points);
+
+	InterlockedExchange(&progress, 1000);
+}
@@ -6,6 +6,7 @@
 #include "Curve.h"
 #include "CtrlPoint.h"
 #include "MathUtils.h"
+#include "Profiler.h"
 #include "Vec3f.h"
 
 #pragma warning(push)
@@ -20,10 +21,12 @@
 #include <cassert>
 #include <cstdlib>
 #include <ctime>
+#include <string>
 
 using std::rand;
 using std::cout;
 using std::endl;
+using std::string;
 
 
 /* idleCallback() - Repeatedly called by fltk while idle --------- */
@@ -35,13 +38,21 @@ void idleCallback(void *pData)
 	assert(pData != nullptr);
 	MainWindow *window = reinterpret_cast<MainWindow*>(pData);
 
+	// Swap in finished background loads between frames, let other
+	// threads see the edits made since the last one, and check them
+	window->pollTrackIO();
+	window->getCurve().publish();
+	window->updateClearance();
+	window->flushTrainCommands();
+
+	// The simulation moves the train on its own thread, only redraw
+	// when it has handed over a new pose
 	const unsigned long delta = clock() - lastRedraw;
 	if( delta > interval ) 
 	{
-		if( window->isAnimating() )
+		if( window->hasNewTrainPose() )
 		{
 			lastRedraw = clock();
-			window->advanceTrain();
 			window->damageMe();
 		}
 	}
@@ -60,8 +71,8 @@ void addPointButtonCallback( Fl_Widget *widget, MainWindow *window )
 {
 	assert(window != nullptr && widget != nullptr);
 
-	Curve&              curve  = window->getCurve();
-	ControlPointVector& points = curve.getControlPoints();
+	Curve&                    curve  = window->getCurve();
+	const ControlPointVector& points = curve.getControlPoints();
 
 	const int numPoints     = curve.numControlPoints();
 	const int selectedIndex = window->getView().getSelectedPoint();
@@ -73,18 +84,16 @@ void addPointButtonCallback( Fl_Widget *widget, MainWindow *window )
 	const Vec3f addPos  = points[addIndex].pos();
 	const Vec3f newPos  = 0.5f * (prevPos + addPos);
 
-	// TODO: modify Curve::addControlPoint() to take an index to insert at
-	points.insert(points.begin() + addIndex, CtrlPoint(newPos));
-
-	curve.regenerateSegments();
+	curve.insertControlPoint(addIndex, CtrlPoint(newPos));
 
 	// Don't move the train unless it is affected by the new point
-	float& t = window->getRotation();
+	float t = window->getRotation();
 	if( std::ceil(t) > static_cast<float>(addIndex) )
 	{
 		t += 1.f;
 		if( t >= numPoints )
 			t -= numPoints;
+		window->setRotation(t);
 	}
 
 	window->damageMe();
@@ -200,13 +209,10 @@ void resetPointsButtonCallback( Fl_Widget *widget, MainWindow *window )
 void loadPointsButtonCallback( Fl_Widget *widget, MainWindow *window )
 {
 	assert(window != nullptr && widget != nullptr);
-	const char *filename = fl_file_chooser("Pick a track file", "*.txt", "tracks/reset.txt");
+	const char *filename = fl_file_chooser("Pick a track file", "Track Files (*.{txt,trk,trz})", "tracks/reset.txt");
 	if( filename != nullptr )
 	{
-		window->loadPoints(filename);
-		window->getCurve().regenerateSegments();
-		window->setRotation(0.f);
-		window->damageMe();
+		window->loadPointsAsync(filename);
 	}
 }
 
@@ -214,13 +220,10 @@ void loadPointsButtonCallback( Fl_Widget *widget, MainWindow *window )
 void savePointsButtonCallback( Fl_Widget *widget, MainWindow *window )
 {
 	assert(window != nullptr && widget != nullptr);
-	const char *filename = fl_input("File name for save [*.txt]", "tracks/");
+	const char *filename = fl_input("File name for save [*.txt, binary *.trk, compressed *.trz]", "tracks/");
 	if( filename != nullptr )
 	{
-		window->savePoints(filename);
-		window->getCurve().regenerateSegments();
-		window->setRotation(0.f);
-		window->damageMe();
+		window->savePointsAsync(filename);
 	}
 }
 
@@ -239,12 +242,10 @@ void pitch(MainWindow *window, const float dir=1)
 	const float s = sin(QUAR_PI * dir);
 	const float c = cos(QUAR_PI * dir);
 
-	curve.getPoint(selected)
-		 .orient(Vec3f(oldOrient.x()
-					,  c * oldOrient.y() - s * oldOrient.z()
-					,  s * oldOrient.y() + c * oldOrient.z()));
-
-	curve.regenerateSegments();
+	curve.orientControlPoint(selected,
+		Vec3f(oldOrient.x()
+			, c * oldOrient.y() - s * oldOrient.z()
+			, s * oldOrient.y() + c * oldOrient.z()));
 
 	window->damageMe();
 }
@@ -262,12 +263,10 @@ void roll(MainWindow *window, const float dir=1)
 	const float s = sin(QUAR_PI * dir);
 	const float c = cos(QUAR_PI * dir);
 
-	curve.getPoint(selected)
-		 .orient(Vec3f(s * oldOrient.y() + c * oldOrient.x()
-					,  c * oldOrient.y() - s * oldOrient.x()
-					,  oldOrient.z()));
-
-	curve.regenerateSegments();
+	curve.orientControlPoint(selected,
+		Vec3f(s * oldOrient.y() + c * oldOrient.x()
+			, c * oldOrient.y() - s * oldOrient.x()
+			, oldOrient.z()));
 
 	window->damageMe();
 }
@@ -284,9 +283,7 @@ void pointResetButtonCallback( Fl_Widget *widget, MainWindow *window )
 	if( selected < 0 || selected >= curve.numControlPoints() )
 		return;
 
-	curve.getPoint(selected).orient(Vec3f(0.f, 1.f, 0.f));
-
-	curve.regenerateSegments();
+	curve.orientControlPoint(selected, Vec3f(0.f, 1.f, 0.f));
 
 	window->damageMe();
 }
@@ -323,7 +320,63 @@ void pointRollLessButtonCallback( Fl_Widget *widget, MainWindow *window )
 void tensionSliderCallback( Fl_Widget *widget, MainWindow *window )
 {
 	Fl_Value_Slider *tensionSlider = dynamic_cast<Fl_Value_Slider*>(widget);
-	window->getCurve().tension = static_cast<float>(tensionSlider->value());
+	window->getCurve().setTension(static_cast<float>(tensionSlider->value()));
+
+	window->damageMe();
+}
 
+/* undoButtonCallback() - Called by fltk when the undo button is pressed */
+void undoButtonCallback( Fl_Widget *widget, MainWindow *window )
+{
+	assert(window != nullptr && widget != nullptr);
+	window->undo();
+}
+
+/* redoButtonCallback() - Called by fltk when the redo button is pressed */
+void redoButtonCallback( Fl_Widget *widget, MainWindow *window )
+{
+	assert(window != nullptr && widget != nullptr);
+	window->redo();
+}
+
+/* saveTraceButtonCallback() - Called by fltk when the save trace button is pressed */
+void saveTraceButtonCallback( Fl_Widget *widget, MainWindow *window )
+{
+	assert(window != nullptr && widget != nullptr);
+	const char *filename = fl_input("File name for trace [*.json]", "trace.json");
+	if( filename != nullptr )
+	{
+		if( !Profiler::get().writeChromeTrace(filename) )
+			fl_alert("Error - failed to write trace file \"%s\"", filename);
+	}
+}
+
+/* exportMeshButtonCallback() - Called by fltk when the export mesh button is pressed */
+void exportMeshButtonCallback( Fl_Widget *widget, MainWindow *window )
+{
+	assert(window != nullptr && widget != nullptr);
+	const char *filename = fl_input("File name for mesh [*.obj, binary *.trm]", "track.obj");
+	if( filename != nullptr )
+	{
+		// (fl_input's buffer is reused by fl_choice)
+		const string meshFilename(filename);
+		const bool includePath = fl_choice("Include the train path in the mesh?", "No", "Yes", nullptr) == 1;
+		window->exportMesh(meshFilename, includePath);
+	}
+}
+
+/* lodButtonCallback() - Called by fltk when the toggle level of detail button is pressed */
+void lodButtonCallback( Fl_Widget *widget, MainWindow *window )
+{
+	assert(window != nullptr && widget != nullptr);
+	window->toggleLevelOfDetail();
+	window->damageMe();
+}
+
+/* clearanceButtonCallback() - Called by fltk when the toggle clearance check button is pressed */
+void clearanceButtonCallback( Fl_Widget *widget, MainWindow *window )
+{
+	assert(window != nullptr && widget != nullptr);
+	window->toggleClearance();
 	window->damageMe();
 }
@@ -0,0 +1,364 @@
+/*
+ * ClearanceChecker.cpp
+ */
+#include "ClearanceChecker.h"
+#include "CurveSegments.h"
+#include "Threads.h"
+#include "Profiler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+using std::vector;
+
+
+const float ClearanceChecker::defaultClearance = 6.f;
+const float ClearanceChecker::trackHalfWidth   = CurveSegment::radius + CurveSegment::railHalfWidth;
+
+static const int   chunksPerThread  = 8;
+static const float sampleTolerance  = 0.05f;  // of the center lines, in track units
+static const int   lengthSpans      = 8;      // per segment, to estimate its length
+static const float hairpinLength    = 1.5708f; // times the clearance, half a turn of that diameter
+
+
+/* closestOnLines() - Finds s and t in [0,1] where the lines p0-p1 - */
+/* and q0-q1 are closest, returns the squared distance between them */
+static float closestOnLines(const Vec3f& p0, const Vec3f& p1, const Vec3f& q0, const Vec3f& q1,
+							float& s, float& t)
+{
+	const Vec3f d1(difference(p1, p0));
+	const Vec3f d2(difference(q1, q0));
+	const Vec3f r (difference(p0, q0));
+
+	const float a = dot(d1, d1);
+	const float e = dot(d2, d2);
+	const float f = dot(d2, r);
+
+	if( a <= 1e-12f && e <= 1e-12f )
+	{
+		s = t = 0.f;
+	}
+	else if( a <= 1e-12f )
+	{
+		s = 0.f;
+		t = (std::min)(1.f, (std::max)(0.f, f / e));
+	}
+	else
+	{
+		const float c = dot(d1, r);
+		if( e <= 1e-12f )
+		{
+			t = 0.f;
+			s = (std::min)(1.f, (std::max)(0.f, -c / a));
+		}
+		else
+		{
+			const float b     = dot(d1, d2);
+			const float denom = a * e - b * b;
+
+			// Parallel lines can take any s, start from p0
+			s = (denom > 1e-12f) ? (std::min)(1.f, (std::max)(0.f, (b * f - c * e) / denom)) : 0.f;
+			t = (b * s + f) / e;
+
+			if( t < 0.f )
+			{
+				t = 0.f;
+				s = (std::min)(1.f, (std::max)(0.f, -c / a));
+			}
+			else if( t > 1.f )
+			{
+				t = 1.f;
+				s = (std::min)(1.f, (std::max)(0.f, (b - c) / a));
+			}
+		}
+	}
+
+	const Vec3f gap(difference(p0 + s * d1, q0 + t * d2));
+	return dot(gap, gap);
+}
+
+/* sampleCenterLine() - Samples a segment's center line ---------- */
+static void sampleCenterLine(const SegmentSnapshot& segment, vector<float>& params, vector<Vec3f>& points)
+{
+	segment.computeSamples(sampleTolerance, params);
+	points.clear();
+	for each(auto t in params)
+		points.push_back(segment.getPosition(t));
+}
+
+
+/* ==================================================================
+ * ClearanceChecker class
+ * ==================================================================
+ */
+ClearanceChecker::ClearanceChecker()
+	: tree()
+	, boxes()
+	, starts()
+	, lengths()
+	, chunks()
+	, jobs()
+	, root()
+	, violations()
+	, curve()
+	, running(false)
+	, revision(0)
+	, clearance(defaultClearance)
+	, reach(defaultClearance)
+	, trackLength(0.f)
+{ }
+
+ClearanceChecker::~ClearanceChecker()
+{
+	// The jobs point into this
+	if( running )
+		JobSystem::get().wait(root);
+}
+
+/* start() - Starts finding every pair of segments of 'snapshot' -- */
+/* that come within 'clearance' of each other or touch ------------ */
+/* Returns false if the last check is still running --------------- */
+bool ClearanceChecker::start(const CurveSnapshotPtr& snapshot, const float minClearance)
+{
+	if( running || !snapshot )
+		return false;
+
+	curve     = snapshot;
+	clearance = minClearance;
+	reach     = (std::max)(clearance, 2.f * trackHalfWidth);
+	running   = true;
+
+	JobSystem& jobSystem = JobSystem::get();
+	jobSystem.init(root, &ClearanceChecker::prepareTask, this, nullptr, stageClearance);
+	jobSystem.run(root);
+
+	// With no workers nothing else would ever run it
+	if( jobSystem.getNumWorkers() == 0 )
+		jobSystem.wait(root);
+	return true;
+}
+
+/* poll() - Called between frames on the interface thread, true --- */
+/* if a check has just finished and its violations replaced the ---- */
+/* last ones ------------------------------------------------------- */
+bool ClearanceChecker::poll()
+{
+	if( !running || !JobSystem::get().isDone(root) )
+		return false;
+
+	violations.clear();
+	for each(const auto& chunk in chunks)
+		violations.insert(violations.end(), chunk.found.begin(), chunk.found.end());
+
+	revision = curve->getRevision();
+	curve.reset();
+	running  = false;
+	return true;
+}
+
+/* numIntersections() - How many of the violations touch --------- */
+size_t ClearanceChecker::numIntersections() const
+{
+	size_t count = 0;
+	for each(const auto& v in violations)
+	{
+		if( v.intersecting )
+			++count;
+	}
+	return count;
+}
+
+/* prepareTask() - Job, builds the tree and adds a child job per --- */
+/* chunk of segments, which the root waits for -------------------- */
+void ClearanceChecker::prepareTask(void *pChecker)
+{
+	ClearanceChecker *checker = reinterpret_cast<ClearanceChecker*>(pChecker);
+	checker->prepare();
+}
+
+void ClearanceChecker::prepare()
+{
+	const int n = curve->numSegments();
+	boxes.resize(n);
+	starts.resize(n);
+	lengths.resize(n);
+	if( n < 3 )
+	{
+		tree.clear();
+		chunks.clear();
+		return;
+	}
+
+	trackLength = 0.f;
+	for(int i = 0; i < n; ++i)
+	{
+		// Center lines within 'reach' have overlapping boxes
+		const SegmentSnapshot& segment = curve->getSegment(i);
+		boxes[i] = segment.bounds;
+		boxes[i].pad(0.5f * reach);
+
+		float length = 0.f;
+		Vec3f prev(segment.getPosition(0.f));
+		for(int k = 1; k <= lengthSpans; ++k)
+		{
+			const Vec3f next(segment.getPosition(static_cast<float>(k) / lengthSpans));
+			length += magnitude(difference(next, prev));
+			prev = next;
+		}
+		starts[i]    = trackLength;
+		lengths[i]   = length;
+		trackLength += length;
+	}
+
+	tree.build(boxes);
+
+	const int numChunks = (std::min)(n, chunksPerThread * numHardwareThreads());
+	chunks.resize(numChunks);
+	jobs.resize(numChunks);
+
+	JobSystem& jobSystem = JobSystem::get();
+	for(int c = 0; c < numChunks; ++c)
+	{
+		Chunk& chunk  = chunks[c];
+		chunk.checker = this;
+		chunk.first   = static_cast<int>(static_cast<__int64>(n) * c       / numChunks);
+		chunk.last    = static_cast<int>(static_cast<__int64>(n) * (c + 1) / numChunks);
+		chunk.found.clear();
+
+		jobSystem.init(jobs[c], &ClearanceChecker::chunkTask, &chunk, &root, stageClearance);
+		jobSystem.run(jobs[c]);
+	}
+}
+
+/* chunkTask() - Job, checks one chunk of segments ---------------- */
+void ClearanceChecker::chunkTask(void *pChunk)
+{
+	Chunk& chunk = *reinterpret_cast<Chunk*>(pChunk);
+	for(int segment = chunk.first; segment < chunk.last; ++segment)
+		chunk.checker->query(segment, chunk);
+}
+
+/* query() - Compares 'segment' with every later, non-adjacent --- */
+/* segment whose box overlaps its own ---------------------------- */
+void ClearanceChecker::query(const int segment, Chunk& chunk)
+{
+	const int n = curve->numSegments();
+	const BoundingBox& box = boxes[segment];
+
+	bool sampled = false;
+
+	chunk.stack.clear();
+	chunk.stack.push_back(0);
+	while( !chunk.stack.empty() )
+	{
+		const SegmentTree::Node& node = tree.getNode(chunk.stack.back());
+		chunk.stack.pop_back();
+
+		if( !overlaps(node.bounds, box) )
+			continue;
+
+		if( node.left >= 0 )
+		{
+			chunk.stack.push_back(node.left);
+			chunk.stack.push_back(node.right);
+			continue;
+		}
+
+		for(int i = node.first; i < node.first + node.count; ++i)
+		{
+			const int other = tree.segment(i);
+			if( other <= segment + 1 || (segment == 0 && other == n - 1) )
+				continue;
+			if( !overlaps(boxes[other], box) )
+				continue;
+
+			// Every point of the pair follows closely along the track
+			const float minSeparation = hairpinLength * clearance;
+			if( separation(segment, 0.f, other, 1.f) < minSeparation
+			 && separation(segment, 1.f, other, 0.f) < minSeparation )
+				continue;
+
+			if( !sampled )
+			{
+				sampleCenterLine(curve->getSegment(segment), chunk.paramsA, chunk.pointsA);
+				sampled = true;
+			}
+			compare(segment, other, chunk);
+		}
+	}
+}
+
+/* compare() - Finds where segments 'a' (already sampled) and 'b' -- */
+/* are closest, recording them if they're within the clearance or - */
+/* the rails touch ------------------------------------------------- */
+void ClearanceChecker::compare(const int a, const int b, Chunk& chunk)
+{
+	sampleCenterLine(curve->getSegment(b), chunk.paramsB, chunk.pointsB);
+
+	const vector<Vec3f>& pa = chunk.pointsA;
+	const vector<Vec3f>& pb = chunk.pointsB;
+
+	const vector<float>& ta = chunk.paramsA;
+	const vector<float>& tb = chunk.paramsB;
+
+	const float minSeparation = hairpinLength * clearance;
+
+	float best = reach * reach;
+	int   bestI = -1, bestJ = -1;
+	float bestS = 0.f, bestT = 0.f;
+	for(size_t i = 0; i + 1 < pa.size(); ++i)
+	{
+		for(size_t j = 0; j + 1 < pb.size(); ++j)
+		{
+			// Close along the track, so close in space
+			if( separation(a, ta[i + 1], b, tb[j])     < minSeparation
+			 || separation(a, ta[i],     b, tb[j + 1]) < minSeparation )
+				continue;
+
+			float s, t;
+			const float distanceSq = closestOnLines(pa[i], pa[i + 1], pb[j], pb[j + 1], s, t);
+			if( distanceSq < best )
+			{
+				best  = distanceSq;
+				bestI = i;
+				bestJ = j;
+				bestS = s;
+				bestT = t;
+			}
+		}
+	}
+
+	if( bestI < 0 )
+		return;
+
+	ClearanceViolation v;
+	v.segmentA     = a;
+	v.segmentB     = b;
+	v.tA           = ta[bestI] + bestS * (ta[bestI + 1] - ta[bestI]);
+	v.tB           = tb[bestJ] + bestT * (tb[bestJ + 1] - tb[bestJ]);
+	v.pointA       = pa[bestI] + bestS * difference(pa[bestI + 1], pa[bestI]);
+	v.pointB       = pb[bestJ] + bestT * difference(pb[bestJ + 1], pb[bestJ]);
+	v.distance     = std::sqrt(best);
+
+	// Across the track at A: sideways the rails span the width, up
+	// and down only their height
+	const SegmentSnapshot& segment = curve->getSegment(a);
+	const Vec3f dir (segment.getDirection(v.tA));
+	const Vec3f side(normalize(cross(dir, segment.getOrientation(v.tA))));
+	const Vec3f up  (cross(side, dir));
+	const Vec3f gap (difference(v.pointB, v.pointA));
+	v.intersecting = std::fabs(dot(gap, side)) < 2.f * trackHalfWidth
+				  && std::fabs(dot(gap, up))   < CurveSegment::railHeight;
+
+	if( v.distance < clearance || v.intersecting )
+		chunk.found.push_back(v);
+}
+
+/* separation() - Distance along the track between 'ta' on segment */
+/* 'a' and 'tb' on segment 'b', the short way round the loop ------ */
+float ClearanceChecker::separation(const int a, const float ta, const int b, const float tb) const
+{
+	const float along = std::fabs(starts[b] + tb * lengths[b] - starts[a] - ta * lengths[a]);
+	return (std::min)(along, trackLength - along);
+}
@@ -0,0 +1,626 @@
+/*
+ * CommandLine.cpp
+ */
+#include "CommandLine.h"
+#include "MainWindow.h"
+#include "FrameExporter.h"
+#include "MeshExporter.h"
+#include "TrackFitter.h"
+#include "PackedPoints.h"
+#include "TrackProjector.h"
+#include "TrainSimulation.h"
+#include "TrackFile.h"
+#include "TrackParser.h"
+#include "Threads.h"
+
+#include <Windows.h>
+#define WIN32_LEAN_AND_MEAN
+
+#include <algorithm>
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+
+/* exportFrames() - Batch mode, renders a lap offscreen to image files */
+/* usage: cs559-project2 -export trackfile outdir [frames [width height]] */
+static int exportFrames(int argc, char* argv[])
+{
+	using std::cout;
+	using std::endl;
+
+	if( argc != 4 && argc != 5 && argc != 7 )
+	{
+		cout << "usage: cs559-project2 -export input-trackfile output-dir "
+			 << "[frames [width height]]" << endl;
+		return 1;
+	}
+
+	const int numFrames = (argc > 4) ? atoi(argv[4]) : 360;
+	const int width     = (argc > 6) ? atoi(argv[5]) : 640;
+	const int height    = (argc > 6) ? atoi(argv[6]) : 480;
+
+	// The window is never shown, the exporter makes its own GL context
+	MainWindow window;
+	window.setBatchMode(true);
+	if( !window.loadPoints(argv[2]) )
+		return 1;
+
+	FrameExporter exporter(window.getView());
+	const int numWritten = exporter.exportLap(argv[3], numFrames, width, height);
+
+	cout << "Wrote " << numWritten << " frames to " << argv[3] << endl;
+
+#ifdef TRACK_ALLOCATIONS
+	// Every frame after warm-up is steady-state animation, none may allocate
+	const int allocatingFrames = window.getView().getAllocatingFrames();
+	if( allocatingFrames > 0 )
+	{
+		cout << "FAILED: " << allocatingFrames << " steady-state frames allocated" << endl;
+		return 1;
+	}
+#endif
+
+	return (numWritten > 0) ? 0 : 1;
+}
+
+
+/* convertTrack() - Converts a track file between the text and binary formats */
+/* the input format is detected, the output format comes from its extension */
+static int convertTrack(int argc, char* argv[])
+{
+	using std::cout;
+	using std::endl;
+
+	if( argc != 4 )
+	{
+		cout << "usage: cs559-project2 -convert input-trackfile output-trackfile[.trk|.trz]" << endl;
+		return 1;
+	}
+
+	MainWindow window;
+	window.setBatchMode(true);
+	if( !window.loadPoints(argv[2]) || !window.savePoints(argv[3]) )
+		return 1;
+
+	cout << "Converted " << window.getCurve().numControlPoints()
+		 << " points to " << argv[3] << endl;
+	return 0;
+}
+
+/* exportMesh() - Writes a track's rails, ties and optionally the train path */
+/* as a triangle mesh, the format comes from the output extension */
+static int exportMesh(int argc, char* argv[])
+{
+	using std::cout;
+	using std::endl;
+
+	const bool includePath = (argc == 5 && std::string(argv[4]) == "-path");
+	if( argc != 4 && !includePath )
+	{
+		cout << "usage: cs559-project2 -mesh input-trackfile output-mesh[.obj|.trm] [-path]" << endl;
+		return 1;
+	}
+
+	MainWindow window;
+	window.setBatchMode(true);
+	if( !window.loadPoints(argv[2]) )
+		return 1;
+
+	MeshExporter exporter(window.getCurve());
+	try {
+		exporter.exportMesh(argv[3], includePath);
+	} catch(TrackFileError& e) {
+		cout << e.what() << endl;
+		return 1;
+	}
+
+	cout << "Wrote " << exporter.getNumVertices() << " vertices and "
+		 << exporter.getNumTriangles() << " triangles to " << argv[3] << endl;
+	return 0;
+}
+
+/* fitTrack() - Fits a dense polyline, such as a surveyed track, with */
+/* a curve of few control points and saves it as a binary track, --- */
+/* the only format that keeps the curve type and tension it was ----- */
+/* fitted as. The polyline is read straight into memory, without ---- */
+/* building the segments or undo history a window's curve would ---- */
+/* usage: cs559-project2 -fit polyline trackfile.trk|.trz [type [tolerance [tension]]] */
+static int fitTrack(int argc, char* argv[])
+{
+	using std::cout;
+	using std::endl;
+
+	static const char *typeArgs[] = { "lines", "catmull", "cardinal", "bspline" };
+
+	int type = catmull;
+	if( argc > 4 )
+	{
+		type = -1;
+		for(int t = lines; t <= bspline; ++t)
+		{
+			if( std::string(argv[4]) == typeArgs[t] )
+				type = t;
+		}
+	}
+
+	if( argc < 4 || argc > 7 || type < 0 )
+	{
+		cout << "usage: cs559-project2 -fit input-polyline output-trackfile[.trk|.trz] "
+			 << "[lines|catmull|cardinal|bspline [tolerance [tension]]]" << endl;
+		return 1;
+	}
+
+	if( !hasBinaryTrackExtension(argv[3]) )
+	{
+		cout << "Error - " << argv[3] << ": the fit has to be saved as a .trk or .trz "
+			 << "track, text tracks don't keep the curve type and tension" << endl;
+		return 1;
+	}
+
+	const float tolerance = (argc > 5) ? static_cast<float>(atof(argv[5])) : TrackFitter::defaultTolerance;
+	const float tension   = (argc > 6) ? static_cast<float>(atof(argv[6])) : TrackFitter::defaultTension;
+
+	ControlPointVector polyline;
+	try {
+		if( isBinaryTrackFile(argv[2]) )
+			MappedTrack(argv[2]).copyTo(polyline);
+		else
+			readTextTrackFile(argv[2], polyline);
+	} catch(TrackFileError& e) {
+		cout << e.what() << endl;
+		return 1;
+	} catch(TrackParseError& e) {
+		cout << e.what() << endl;
+		return 1;
+	}
+
+	LARGE_INTEGER frequency, start, end;
+	QueryPerformanceFrequency(&frequency);
+	QueryPerformanceCounter(&start);
+
+	TrackFitter fitter(static_cast<CurveType>(type), tolerance, tension);
+	ControlPointVector points;
+	fitter.fit(polyline, points);
+
+	QueryPerformanceCounter(&end);
+	const double ms = 1000.0 * (end.QuadPart - start.QuadPart) / frequency.QuadPart;
+
+	try {
+		writeBinaryTrackFile(argv[3], points, static_cast<CurveType>(type), tension,
+							 hasCompressedTrackExtension(argv[3]));
+	} catch(TrackFileError& e) {
+		cout << e.what() << endl;
+		return 1;
+	}
+
+	cout << "Fit " << polyline.size() << " samples with " << points.size()
+		 << " " << CurveTypeNames[type] << " points in " << fitter.getNumRounds()
+		 << " rounds and " << ms << " ms, within " << fitter.getMaxError()
+		 << " of the polyline" << endl;
+	return 0;
+}
+
+/* evaluateRails() - Evaluates both rails at each of 'params', the */
+/* same work drawing a segment's rails does per frame ------------ */
+static float evaluateRails(CurveSegment& segment, const std::vector<float>& params)
+{
+	float sum = 0.f;
+	for each(auto t in params)
+	{
+		const Vec3f pos (segment.getPosition(t));
+		const Vec3f dir (normalize(segment.getDirection(t)));
+		const Vec3f up  (normalize(segment.getOrientation(t)));
+		const Vec3f side(normalize(cross(dir, up)));
+
+		sum += (pos + CurveSegment::radius * side).x() + (pos + -CurveSegment::radius * side).x();
+	}
+	return sum;
+}
+
+/* railDrift() - The furthest the forward differenced rails at ----- */
+/* 'params' stray from evaluating them directly -------------------- */
+static float railDrift(CurveSegment& segment, const std::vector<float>& params)
+{
+	std::vector<Vec3f> left, right;
+	segment.tessellateRails(params, CurveSegment::sampleGrid, left, right);
+
+	float drift = 0.f;
+	for(size_t i = 0; i < params.size(); ++i)
+	{
+		const Vec3f pos (segment.getPosition(params[i]));
+		const Vec3f dir (normalize(segment.getDirection(params[i])));
+		const Vec3f up  (normalize(segment.getOrientation(params[i])));
+		const Vec3f side(normalize(cross(dir, up)));
+
+		const Vec3f l(pos +  CurveSegment::radius * side);
+		const Vec3f r(pos + -CurveSegment::radius * side);
+		drift = (std::max)(drift, magnitude(difference(left[i],  l)));
+		drift = (std::max)(drift, magnitude(difference(right[i], r)));
+	}
+	return drift;
+}
+
+/* tessellationStats() - Compares the fixed and adaptive tessellation */
+/* of each track as each curve type: rail vertices, and the time --- */
+/* to evaluate them for a frame, averaged over many frames, directly */
+/* and by forward differences, and how far those drift. Fails if ---- */
+/* the drift is more than a tenth of the sampling tolerance, where -- */
+/* it would start to show next to the sampling error --------------- */
+/* usage: cs559-project2 -tessellation trackfile... ----------------- */
+static int tessellationStats(int argc, char* argv[])
+{
+	using std::cout;
+	using std::endl;
+
+	static const int   numFrames     = 1000;
+	static const float maxDriftShare = 0.1f;   // of the tolerance
+
+	if( argc < 3 )
+	{
+		cout << "usage: cs559-project2 -tessellation input-trackfile..." << endl;
+		return 1;
+	}
+
+	LARGE_INTEGER frequency;
+	QueryPerformanceFrequency(&frequency);
+	const double msPerTick = 1000.0 / static_cast<double>(frequency.QuadPart);
+
+	std::vector<float> fixed;
+	for(int i = 0; i <= CurveSegment::numLines; ++i)
+		fixed.push_back(i * CurveSegment::step);
+
+	std::vector<Vec3f> left, right;
+	int numDrifting = 0;
+
+	MainWindow window;
+	window.setBatchMode(true);
+	for(int arg = 2; arg < argc; ++arg)
+	{
+		if( !window.loadPoints(argv[arg]) )
+			return 1;
+		Curve& curve(window.getCurve());
+		const float tolerance = curve.getTessellation().tolerance;
+		const float maxDrift  = maxDriftShare * tolerance;
+
+		for(int type = catmull; type <= bspline; ++type)
+		{
+			curve.setCurveType(static_cast<CurveType>(type));
+
+			size_t fixedVertices = 0, adaptiveVertices = 0;
+			float  sum = 0.f, drift = 0.f;
+			LARGE_INTEGER start, sampled, stepped, adaptive, end;
+
+			QueryPerformanceCounter(&start);
+			for(int s = 0; s < curve.numSegments(); ++s)
+			{
+				curve.getSegment(s)->updateSamples(curve.getTessellation());
+				adaptiveVertices += 2 * curve.getSegment(s)->getSamples().size();
+				fixedVertices    += 2 * fixed.size();
+			}
+			QueryPerformanceCounter(&sampled);
+			for(int frame = 0; frame < numFrames; ++frame)
+			{
+				for(int s = 0; s < curve.numSegments(); ++s)
+				{
+					curve.getSegment(s)->tessellateRails(curve.getSegment(s)->getSamples(),
+														 CurveSegment::sampleGrid, left, right);
+					sum += left.back().x() + right.back().x();
+				}
+			}
+			QueryPerformanceCounter(&stepped);
+			for(int frame = 0; frame < numFrames; ++frame)
+			{
+				for(int s = 0; s < curve.numSegments(); ++s)
+					sum += evaluateRails(*curve.getSegment(s), curve.getSegment(s)->getSamples());
+			}
+			QueryPerformanceCounter(&adaptive);
+			for(int frame = 0; frame < numFrames; ++frame)
+			{
+				for(int s = 0; s < curve.numSegments(); ++s)
+					sum += evaluateRails(*curve.getSegment(s), fixed);
+			}
+			QueryPerformanceCounter(&end);
+
+			for(int s = 0; s < curve.numSegments(); ++s)
+				drift = (std::max)(drift, railDrift(*curve.getSegment(s), curve.getSegment(s)->getSamples()));
+
+			const double sampleMs   = (sampled.QuadPart  - start.QuadPart)    * msPerTick;
+			const double steppedMs  = (stepped.QuadPart  - sampled.QuadPart)  * msPerTick / numFrames;
+			const double adaptiveMs = (adaptive.QuadPart - stepped.QuadPart)  * msPerTick / numFrames;
+			const double fixedMs    = (end.QuadPart      - adaptive.QuadPart) * msPerTick / numFrames;
+
+			cout << argv[arg] << " " << CurveTypeNames[type] << ": rail vertices "
+				 << fixedVertices << " fixed, " << adaptiveVertices << " adaptive; per frame "
+				 << fixedMs << " ms fixed, " << adaptiveMs << " ms adaptive, "
+				 << steppedMs << " ms forward differenced (drift " << drift << ") (+"
+				 << sampleMs << " ms once to pick samples)"
+				 << ((sum != sum) ? ", NaN rails" : "") << endl;
+
+			// Written so a NaN drift fails too
+			if( !(drift <= maxDrift) || sum != sum )
+			{
+				cout << "FAILED: " << argv[arg] << " " << CurveTypeNames[type] << " drifts "
+					 << drift << ", more than " << maxDrift << endl;
+				++numDrifting;
+			}
+		}
+	}
+	return (numDrifting > 0) ? 1 : 0;
+}
+
+/* closestPointStats() - Projects points scattered along each ----- */
+/* track onto it as each curve type: queries per second on one ----- */
+/* thread and on all of them, and the worst error against densely -- */
+/* sampling every segment ------------------------------------------ */
+/* usage: cs559-project2 -closest trackfile... ---------------------- */
+static int closestPointStats(int argc, char* argv[])
+{
+	using std::cout;
+	using std::endl;
+
+	static const int   numQueries   = 1000000;
+	static const int   numSerial    = 100000;  // timed one at a time
+	static const int   numChecked   = 200;
+	static const int   checkSamples = 2000;   // per segment
+	static const float scatter      = 20.f;
+
+	if( argc < 3 )
+	{
+		cout << "usage: cs559-project2 -closest input-trackfile..." << endl;
+		return 1;
+	}
+
+	LARGE_INTEGER frequency;
+	QueryPerformanceFrequency(&frequency);
+	const double msPerTick = 1000.0 / static_cast<double>(frequency.QuadPart);
+
+	std::vector<Vec3f> points(numQueries);
+	std::vector<TrackProjection> results;
+	TrackProjector projector;
+
+	MainWindow window;
+	window.setBatchMode(true);
+	for(int arg = 2; arg < argc; ++arg)
+	{
+		if( !window.loadPoints(argv[arg]) )
+			return 1;
+		Curve& curve(window.getCurve());
+
+		for(int type = lines; type <= bspline; ++type)
+		{
+			curve.setCurveType(static_cast<CurveType>(type));
+
+			// In order along the track, like a batch of sensors would be
+			srand(1);
+			const float length = static_cast<float>(curve.numSegments());
+			for(int i = 0; i < numQueries; ++i)
+			{
+				const Vec3f offset(scatter * (2.f * rand() / RAND_MAX - 1.f),
+								   scatter * (2.f * rand() / RAND_MAX - 1.f),
+								   scatter * (2.f * rand() / RAND_MAX - 1.f));
+				points[i] = curve.getPosition(length * i / numQueries) + offset;
+			}
+
+			LARGE_INTEGER start, end;
+			projector.project(curve, points[0]);   // builds the tables
+			QueryPerformanceCounter(&start);
+			results.resize(numQueries);
+			for(int i = 0; i < numSerial; ++i)
+				results[i] = projector.project(curve, points[i]);
+			QueryPerformanceCounter(&end);
+			const double serialMs = (end.QuadPart - start.QuadPart) * msPerTick;
+
+			QueryPerformanceCounter(&start);
+			projector.project(curve, points, results);
+			QueryPerformanceCounter(&end);
+			const double ms = (end.QuadPart - start.QuadPart) * msPerTick;
+
+			float worst = 0.f;
+			for(int i = 0; i < numQueries; i += numQueries / numChecked)
+			{
+				float nearest = results[i].distance;
+				for(int s = 0; s < curve.numSegments(); ++s)
+				{
+					for(int k = 0; k <= checkSamples; ++k)
+					{
+						const Vec3f p(curve.getSegment(s)->getPosition(static_cast<float>(k) / checkSamples));
+						nearest = (std::min)(nearest, magnitude(difference(p, points[i])));
+					}
+				}
+				worst = (std::max)(worst, results[i].distance - nearest);
+			}
+
+			cout << argv[arg] << " " << CurveTypeNames[type] << ": "
+				 << numSerial / serialMs / 1000.0 << "M queries/s on one thread, "
+				 << numQueries / ms / 1000.0 << "M on "
+				 << numHardwareThreads() << " threads, worst error "
+				 << worst << endl;
+		}
+	}
+	return 0;
+}
+
+/* packStats() - Packs each track's points and compares the packed */
+/* curve of each type with the full precision one: memory per ------ */
+/* point, the worst point errors and the worst curve error --------- */
+/* usage: cs559-project2 -pack trackfile... ------------------------ */
+static int packStats(int argc, char* argv[])
+{
+	using std::cout;
+	using std::endl;
+
+	static const int maxChecked     = 1000000;   // curve samples per type
+	static const int samplesPerSpan = 8;
+
+	if( argc < 3 )
+	{
+		cout << "usage: cs559-project2 -pack input-trackfile..." << endl;
+		return 1;
+	}
+
+	LARGE_INTEGER frequency;
+	QueryPerformanceFrequency(&frequency);
+	const double msPerTick = 1000.0 / static_cast<double>(frequency.QuadPart);
+
+	PackedPoints packed;
+
+	MainWindow window;
+	window.setBatchMode(true);
+	for(int arg = 2; arg < argc; ++arg)
+	{
+		if( !window.loadPoints(argv[arg]) )
+			return 1;
+		Curve& curve(window.getCurve());
+		if( curve.numControlPoints() == 0 )
+			continue;
+
+		LARGE_INTEGER start, end;
+		QueryPerformanceCounter(&start);
+		packed.pack(curve.getControlPoints());
+		QueryPerformanceCounter(&end);
+
+		const double n = static_cast<double>(curve.numControlPoints());
+		cout << argv[arg] << ": " << curve.numControlPoints() << " points packed in "
+			 << (end.QuadPart - start.QuadPart) * msPerTick << " ms, "
+			 << packed.getMemoryUsed() / n << " bytes per point (" << sizeof(CtrlPoint)
+			 << " unpacked), worst point error " << packed.getPositionError() << " position, "
+			 << packed.getOrientError() * 180.0 / 3.14159265 << " degrees orientation" << endl;
+
+		for(int type = lines; type <= bspline; ++type)
+		{
+			curve.setCurveType(static_cast<CurveType>(type));
+			packed.setCurveType(static_cast<CurveType>(type));
+			packed.setTension(curve.tension);
+
+			const int numSamples = (std::min)(maxChecked, curve.numSegments() * samplesPerSpan);
+			const float length   = static_cast<float>(curve.numSegments());
+
+			float worst = 0.f;
+			for(int i = 0; i < numSamples; ++i)
+			{
+				const float t = length * i / numSamples;
+				worst = (std::max)(worst, magnitude(difference(packed.getPosition(t), curve.getPosition(t))));
+			}
+
+			cout << argv[arg] << " " << CurveTypeNames[type] << ": worst curve error "
+				 << worst << endl;
+		}
+	}
+	return 0;
+}
+
+/* rideTrack() - Reads a track straight into packed points, never -- */
+/* building a curve, and runs the train round it for 'seconds' of --- */
+/* simulation: the memory the track takes, the time per step and ---- */
+/* where the train ends up ----------------------------------------- */
+/* usage: cs559-project2 -ride trackfile [seconds [speed]] --------- */
+static int rideTrack(int argc, char* argv[])
+{
+	using std::cout;
+	using std::endl;
+
+	if( argc < 3 || argc > 5 )
+	{
+		cout << "usage: cs559-project2 -ride input-trackfile [seconds [speed]]" << endl;
+		return 1;
+	}
+
+	const float seconds = (argc > 3) ? static_cast<float>(atof(argv[3])) : 60.f;
+	const float speed   = (argc > 4) ? static_cast<float>(atof(argv[4])) : 2.f;
+
+	// The full precision points only live until they're packed
+	PackedPoints packed;
+	try {
+		ControlPointVector points;
+		if( isBinaryTrackFile(argv[2]) )
+		{
+			MappedTrack track(argv[2]);
+			track.copyTo(points);
+			if( track.hasCurveSettings() )
+			{
+				packed.setCurveType(track.curveType());
+				packed.setTension(track.tension());
+			}
+		}
+		else
+		{
+			readTextTrackFile(argv[2], points);
+		}
+		packed.pack(points);
+	} catch(TrackFileError& e) {
+		cout << e.what() << endl;
+		return 1;
+	} catch(TrackParseError& e) {
+		cout << e.what() << endl;
+		return 1;
+	}
+
+	if( packed.numPoints() == 0 )
+	{
+		cout << "Error - " << argv[2] << ": the track has no points to ride" << endl;
+		return 1;
+	}
+
+	LARGE_INTEGER frequency, start, end;
+	QueryPerformanceFrequency(&frequency);
+
+	const int numSteps = static_cast<int>(seconds * TrainSimulation::stepsPerSecond);
+	float t = 0.f;
+	QueryPerformanceCounter(&start);
+	for(int i = 0; i < numSteps; ++i)
+		t = TrainSimulation::advance(packed, t, 1.f, speed, true);
+	const TrainPose pose(TrainSimulation::poseAt(packed, t));
+	QueryPerformanceCounter(&end);
+
+	const double us = 1000000.0 * (end.QuadPart - start.QuadPart) / frequency.QuadPart;
+	cout << argv[2] << ": " << packed.numPoints() << " " << CurveTypeNames[packed.getCurveType()]
+		 << " points held in " << packed.getMemoryUsed() / (1024.0 * 1024.0) << " MB, "
+		 << numSteps << " steps at " << (numSteps > 0 ? us / numSteps : 0.0) << " us each, "
+		 << "the train ends at t = " << pose.t << " " << pose.position << endl;
+	return 0;
+}
+
+// ---------------------------------------------------------------
+
+struct Command
+{
+	const char *name;
+	int (*run)(int argc, char* argv[]);
+};
+
+static const Command commands[] = {
+	{ "-export",       &exportFrames      },
+	{ "-convert",      &convertTrack      },
+	{ "-mesh",         &exportMesh        },
+	{ "-tessellation", &tessellationStats },
+	{ "-closest",      &closestPointStats },
+	{ "-fit",          &fitTrack          },
+	{ "-pack",         &packStats         },
+	{ "-ride",         &rideTrack         }
+};
+static const int numCommands = sizeof(commands) / sizeof(commands[0]);
+
+/* findCommand() - The batch mode named 'arg', nullptr if none is -- */
+static const Command* findCommand(const char *arg)
+{
+	for(int i = 0; i < numCommands; ++i)
+	{
+		if( strcmp(arg, commands[i].name) == 0 )
+			return &commands[i];
+	}
+	return nullptr;
+}
+
+bool isCommand(const char *arg)
+{
+	return findCommand(arg) != nullptr;
+}
+
+int runCommand(int argc, char* argv[])
+{
+	const Command *command = (argc > 1) ? findCommand(argv[1]) : nullptr;
+	return (command != nullptr) ? command->run(argc, argv) : 1;
+}
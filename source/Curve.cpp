@@ -2,12 +2,17 @@
  * Curve.cpp
  */
 #include "Curve.h"
+#include "Profiler.h"
+#include "EditJournal.h"
+#include "UndoHistory.h"
+#include "Threads.h"
 
 #include <Windows.h>
 #define WIN32_LEAN_AND_MEAN
 
 #include <GL/GL.h>
 
+#include <algorithm>
 #include <stdexcept>
 #include <iostream>
 #include <sstream>
@@ -19,6 +24,26 @@ using std::vector;
 using std::cout;
 using std::endl;
 
+// Full rebuilds and snapshots are split into ranges this long, small
+// curves are one range, which parallelFor runs on the calling thread
+static const int segmentsPerTask = 4096;
+
+// State shared by the tasks of one full rebuild
+struct SegmentRebuild
+{
+	Curve *curve;
+	int    oldCount;   // segments to free
+	int    newCount;   // segments to build
+	int    total;      // the longer of the two
+};
+
+// State shared by the tasks gathering one snapshot's segments
+struct SegmentGather
+{
+	const CurveSegmentVector   *segments;
+	vector<SegmentSnapshotPtr> *snapshots;
+};
+
 
 /************************************************************************/
 /* Curve class                                                          */
@@ -28,6 +53,18 @@ Curve::Curve(const CurveType& type)
 	: type(type)
 	, controlPoints()
 	, segments()
+	, editDepth(0)
+	, dirtyFirst(0)
+	, dirtyLast(-1)
+	, structureChanged(false)
+	, journal(nullptr)
+	, history(nullptr)
+	, tessellation()
+	, frustum()
+	, numDrawnSegments(0)
+	, numCulledSegments(0)
+	, revision(0)
+	, snapshots()
 	, selectedPoint(-1)
 	, selectedSegment(-1)
 	, tension(1.f)
@@ -50,10 +87,29 @@ void Curve::draw(bool drawPoints, bool isShadowed)
 	if( segments.empty() )
 		regenerateSegments();
 
+	// Shadows are flattened onto the ground, so they can be on screen
+	// when their segments aren't, and are never culled
+	if( !isShadowed )
+	{
+		numDrawnSegments  = 0;
+		numCulledSegments = 0;
+	}
+
 	for each(auto segment in segments)
 	{
 		assert(segment != nullptr);
+		if( !isShadowed )
+		{
+			if( !frustum.intersects(segment->getBounds()) )
+			{
+				++numCulledSegments;
+				continue;
+			}
+			++numDrawnSegments;
+		}
+
 		if( !isShadowed ) glColor4ub(164, 164, 164, 255); 
+		segment->updateSamples(tessellation);
 		segment->draw(false, isShadowed);
 	}
 
@@ -86,6 +142,7 @@ void Curve::drawSelectedSegment(bool drawPoints, bool isShadowed)
 		return;
 
 	if( !isShadowed ) glColor4ub(255, 20, 20, 255);
+	segments[selectedSegment]->updateSamples(tessellation);
 	segments[selectedSegment]->draw(drawPoints, isShadowed);
 }
 
@@ -93,23 +150,172 @@ void Curve::drawSelectedSegment(bool drawPoints, bool isShadowed)
 void Curve::setCurveType( const CurveType& curveType ) 
 { 
 	type = curveType; 
-	regenerateSegments();
+	markStructureChanged();
+
+	if( journal != nullptr )
+		journal->recordCurveType(curveType);
+	if( history != nullptr )
+		history->settingsChanged(type, tension);
+}
+
+/* setTension() - Sets the tension used by cardinal segments ----- */
+void Curve::setTension( const float newTension )
+{
+	// Segments read the tension as they're evaluated, so nothing to regenerate
+	// but the cardinal segments' bounds
+	tension = newTension;
+	++revision;
+	if( type == cardinal )
+	{
+		const int numTasks = (numSegments() + segmentsPerTask - 1) / segmentsPerTask;
+		parallelFor(numTasks, &Curve::boundsTask, this);
+	}
+
+	if( journal != nullptr )
+		journal->recordTension(newTension);
+	if( history != nullptr )
+		history->settingsChanged(type, tension);
+}
+
+/* beginEdit() - Defers segment regeneration until commitEdit() -- */
+/* Calls may be nested, only the outermost commit regenerates ---- */
+void Curve::beginEdit()
+{
+	++editDepth;
+}
+
+/* commitEdit() - Regenerates whatever the edits since beginEdit() touched */
+void Curve::commitEdit()
+{
+	assert(editDepth > 0);
+	if( --editDepth == 0 )
+		flushEdits();
+}
+
+/* swap() - Exchanges everything about this curve with 'other' -- */
+/* Neither curve can be in the middle of an edit ----------------- */
+/* Journals, undo histories and tessellation settings stay with -- */
+/* their curves -------------------------------------------------- */
+void Curve::swap( Curve& other )
+{
+	assert(editDepth == 0 && other.editDepth == 0);
+
+	std::swap(type, other.type);
+	controlPoints.swap(other.controlPoints);
+	segments.swap(other.segments);
+	std::swap(selectedPoint,   other.selectedPoint);
+	std::swap(selectedSegment, other.selectedSegment);
+	std::swap(tension,         other.tension);
+	++revision;
+	++other.revision;
+
+	// Segments read the tension from their curve, so follow them over
+	for each(auto segment in segments)
+		segment->setParentCurve(*this);
+	for each(auto segment in other.segments)
+		segment->setParentCurve(other);
+}
+
+/* publish() - Publishes a snapshot of the curve for other threads, */
+/* if it's changed since the last one, sharing the segments that --- */
+/* haven't ---------------------------------------------------------- */
+void Curve::publish()
+{
+	if( editDepth > 0 )
+		return;
+
+	if( segments.empty() && !controlPoints.empty() )
+		regenerateSegments();
+
+	const CurveSnapshotPtr latest(snapshots.acquire());
+	if( latest && latest->getRevision() == revision )
+		return;
+
+	vector<SegmentSnapshotPtr> segmentSnapshots(segments.size());
+	SegmentGather gather = { &segments, &segmentSnapshots };
+
+	const int numTasks = (numSegments() + segmentsPerTask - 1) / segmentsPerTask;
+	parallelFor(numTasks, &Curve::snapshotTask, &gather);
+
+	snapshots.publish(CurveSnapshotPtr(new CurveSnapshot(type, tension, revision, segmentSnapshots)));
 }
 
 /* addControlPoint() - Add the specified control point to the curve */
 int Curve::addControlPoint( const CtrlPoint& point )
 {
 	controlPoints.push_back(point);
-	regenerateSegments();
+	markStructureChanged();
 	return controlPoints.size() - 1;
 }
 
+/* insertControlPoint() - Inserts a control point before the specified index */
+/* Throws NoSuchPoint exception on bad point index --------------- */
+int Curve::insertControlPoint( const int id, const CtrlPoint& point )
+{
+	if( id < 0 || id > numControlPoints() )
+	{
+		stringstream ss;
+		ss << "Warning: can't insert point on curve at id=" << id;
+		throw NoSuchPoint(ss.str());
+	}
+
+	controlPoints.insert(controlPoints.begin() + id, point);
+	markStructureChanged();
+
+	if( journal != nullptr )
+		journal->recordInsert(id, point);
+	if( history != nullptr )
+		history->pointInserted(id, point);
+	return id;
+}
+
 /* clearPoints() - Clears all the control points ----------------- */
 //ONLY CALL THIS IF YOU ARE IMMEDIATELY going to fill up the control points of the curve!
 void Curve::clearPoints()
 {
 	controlPoints.clear();
-	regenerateSegments();
+	markStructureChanged();
+}
+
+/* moveControlPoint() - Moves the specified point to a new position */
+/* Throws NoSuchPoint exception on bad point index --------------- */
+void Curve::moveControlPoint( const int id, const Vec3f& pos )
+{
+	getPoint(id).pos(pos);
+	markPointsDirty(id, id);
+
+	if( journal != nullptr )
+		journal->recordMove(id, pos);
+	if( history != nullptr )
+		history->pointChanged(id, controlPoints[id]);
+}
+
+/* orientControlPoint() - Changes the specified point's orientation */
+/* Throws NoSuchPoint exception on bad point index --------------- */
+void Curve::orientControlPoint( const int id, const Vec3f& orient )
+{
+	getPoint(id).orient(orient);
+	markPointsDirty(id, id);
+
+	if( journal != nullptr )
+		journal->recordOrient(id, orient);
+	if( history != nullptr )
+		history->pointChanged(id, controlPoints[id]);
+}
+
+/* assignPoints() - Replaces all the control points with a copy of a range */
+void Curve::assignPoints( ControlPointVectorConstIter first, ControlPointVectorConstIter last )
+{
+	controlPoints.assign(first, last);
+	markStructureChanged();
+}
+
+/* swapPoints() - Replaces all the control points with 'points' -- */
+/* 'points' is left holding the previous control points ---------- */
+void Curve::swapPoints( ControlPointVector& points )
+{
+	controlPoints.swap(points);
+	markStructureChanged();
 }
 
 /* delControlPoint() - Tries to delete the point at the specified index */
@@ -123,7 +329,12 @@ void Curve::delControlPoint( const int id )
 		// Erase the point at that index
 		controlPoints.erase(controlPoints.begin() + id);
 		// Rebuild segments
-		regenerateSegments();
+		markStructureChanged();
+
+		if( journal != nullptr )
+			journal->recordDelete(id);
+		if( history != nullptr )
+			history->pointErased(id);
 	}
 	catch(std::out_of_range&) {
 		stringstream ss;
@@ -220,92 +431,181 @@ void Curve::drawSegment( const int number, bool isShadowed )
 		return;
 
 	if( !isShadowed ) glColor4ub(255, 255, 255, 255);
+	segments[number]->updateSamples(tessellation);
 	segments[number]->draw(false, isShadowed);
 }
 
 /* regenerateSegments() - Regenerates segments based on control points and curve type */
 void Curve::regenerateSegments()
 {
-	// Clean up old segments
-	for each(auto segment in segments)
+	ScopedTimer timer(stageRegenerate);
+	++revision;
+
+	// Each segment only depends on its own few control points, so ranges
+	// of them are freed and rebuilt in parallel, in place. The vector is
+	// sized for both first so no task moves it under another.
+	SegmentRebuild rebuild;
+	rebuild.curve    = this;
+	rebuild.oldCount = numSegments();
+	rebuild.newCount = numControlPoints();
+	rebuild.total    = (std::max)(rebuild.oldCount, rebuild.newCount);
+
+	segments.resize(rebuild.total, nullptr);
+
+	const int numTasks = (rebuild.total + segmentsPerTask - 1) / segmentsPerTask;
+	parallelFor(numTasks, &Curve::rebuildTask, &rebuild);
+
+	segments.resize(rebuild.newCount);
+}
+
+/* rebuildTask() - parallelFor task, frees the old segments and ---- */
+/* builds the new ones in one range of a full rebuild -------------- */
+void Curve::rebuildTask( const int index, void *pRebuild )
+{
+	const SegmentRebuild *rebuild = reinterpret_cast<SegmentRebuild*>(pRebuild);
+	Curve& curve = *rebuild->curve;
+
+	const int first = index * segmentsPerTask;
+	const int last  = (std::min)(first + segmentsPerTask, rebuild->total);
+	for(int i = first; i < last; ++i)
 	{
-		delete segment;
+		if( i < rebuild->oldCount )
+			delete curve.segments[i];
+
+		// Create the new segment using control points and curve type
+		if( i < rebuild->newCount )
+		{
+			curve.segments[i] = curve.makeSegment(i);
+			curve.segments[i]->updateBounds();
+		}
+		else
+		{
+			curve.segments[i] = nullptr;
+		}
 	}
-	segments.clear();
+}
 
-	// Can't create segments without control points or with 1 control point
-	if( controlPoints.empty())
-		return;
+/* boundsTask() - parallelFor task, updates the bounds of one ----- */
+/* range of segments ----------------------------------------------- */
+void Curve::boundsTask( const int index, void *pCurve )
+{
+	Curve& curve = *reinterpret_cast<Curve*>(pCurve);
 
-	// Create new segments using control points and curve type
-	switch(type)
+	const int first = index * segmentsPerTask;
+	const int last  = (std::min)(first + segmentsPerTask, curve.numSegments());
+	for(int i = first; i < last; ++i)
+		curve.segments[i]->updateBounds();
+}
+
+/* snapshotTask() - parallelFor task, takes the snapshots of one --- */
+/* range of segments ----------------------------------------------- */
+void Curve::snapshotTask( const int index, void *pGather )
+{
+	const SegmentGather *gather = reinterpret_cast<SegmentGather*>(pGather);
+	const CurveSegmentVector&   segments  = *gather->segments;
+	vector<SegmentSnapshotPtr>& snapshots = *gather->snapshots;
+
+	const int first = index * segmentsPerTask;
+	const int last  = (std::min)(first + segmentsPerTask, static_cast<int>(segments.size()));
+	for(int i = first; i < last; ++i)
+		snapshots[i] = segments[i]->getSnapshot();
+}
+
+/* markPointsDirty() - Records that points [first,last] moved or turned */
+void Curve::markPointsDirty( const int first, const int last )
+{
+	if( dirtyFirst > dirtyLast )
 	{
-	case lines:    regenerateLineSegments();     break;
-	case catmull:
-	case cardinal:
-	case bspline:  regenerateCurveSegments();    break;
+		dirtyFirst = first;
+		dirtyLast  = last;
+	} else {
+		dirtyFirst = (std::min)(dirtyFirst, first);
+		dirtyLast  = (std::max)(dirtyLast,  last);
 	}
+
+	if( editDepth == 0 )
+		flushEdits();
+}
+
+/* markStructureChanged() - Records that points were added/removed or the type changed */
+void Curve::markStructureChanged()
+{
+	structureChanged = true;
+
+	if( editDepth == 0 )
+		flushEdits();
+}
+
+/* flushEdits() - Regenerates the segments affected by pending edits */
+void Curve::flushEdits()
+{
+	if( structureChanged )
+		regenerateSegments();
+	else if( dirtyFirst <= dirtyLast )
+		regenerateSegmentsForPoints(dirtyFirst, dirtyLast);
+
+	structureChanged = false;
+	dirtyFirst       = 0;
+	dirtyLast        = -1;
 }
 
-/* regenerateLineSegments() - Regenerates segments as lines ------ */
-void Curve::regenerateLineSegments()
+/* regenerateSegmentsForPoints() - Regenerates only the segments that */
+/* use any of the control points in [first,last] ----------------- */
+void Curve::regenerateSegmentsForPoints( const int first, const int last )
 {
-	auto it  = controlPoints.begin();
-	auto end = controlPoints.end();
-	for(int i = 0; it != end; ++i, ++it)
+	const int n = numControlPoints();
+
+	// Small curves wrap the neighbor logic around on itself, just rebuild them
+	if( n < 4 || numSegments() != n )
 	{
-		const bool last = ((it + 1) == end);
+		regenerateSegments();
+		return;
+	}
 
-		const CtrlPoint& p0(*it);
-		const CtrlPoint& p1(last ? *(controlPoints.begin()) : *(it + 1));
+	// Segment i uses points i-1 .. i+2 (lines only use i .. i+1)
+	const int firstSegment = first - ((type == lines) ? 1 : 2);
+	const int lastSegment  = last + ((type == lines) ? 0 : 1);
+	if( lastSegment - firstSegment + 1 >= n )
+	{
+		regenerateSegments();
+		return;
+	}
+
+	ScopedTimer timer(stageRegenerate);
+	++revision;
 
-		segments.push_back(new LineSegment(*this, i, p0, p1));
+	for(int s = firstSegment; s <= lastSegment; ++s)
+	{
+		const int i = (s + n) % n;
+		delete segments[i];
+		segments[i] = makeSegment(i);
+		segments[i]->updateBounds();
 	}
 }
 
-/* regenerateCurveSegments() - Regnerates segments as the current type of cubic curve */
-void Curve::regenerateCurveSegments()
+/* makeSegment() - Creates the specified segment from its control points */
+CurveSegment* Curve::makeSegment( const int i )
 {
-	auto it  = controlPoints.begin();
-	auto end = controlPoints.end();
-	for(int i = 0; it != end; ++i, ++it)
-	{
-		if( i == 0 && controlPoints.size() >= 4 )
-		{
-			const CtrlPoint& c1(*(end - 1));
-			const CtrlPoint& p0(*(it));
-			const CtrlPoint& p1(*(it + 1));
-			const CtrlPoint& c2(*(it + 2));
-			switch(type)
-			{
-			case catmull:  segments.push_back(new CatmullRomSegment(*this, i, p0, p1, c1, c2)); break;
-			case cardinal: segments.push_back(new CardinalSegment(*this, i, p0, p1, c1, c2)); break;
-			case bspline:  segments.push_back(new BSplineSegment(*this, i, p0, p1, c1, c2)); break;
-			}
-		} else {
-			auto next1 = it + 1;
-			if( next1 >= end )
-				next1 = controlPoints.begin();
+	const int n = numControlPoints();
 
-			auto next2 = next1 + 1;
-			if( next2 >= end )
-				next2 = controlPoints.begin();
+	const CtrlPoint& p0(controlPoints[i]);
+	const CtrlPoint& p1(controlPoints[(i + 1) % n]);
 
-			auto prev = it;
-			if( prev != controlPoints.begin() )
-				prev -= 1;
+	if( type == lines )
+		return new LineSegment(*this, i, p0, p1);
 
-			const CtrlPoint& c1(*prev);
-			const CtrlPoint& p0(*(it));
-			const CtrlPoint& p1(*next1);
-			const CtrlPoint& c2(*next2);
+	// The first segment wraps around to the last point for its previous control,
+	// unless there are too few points for that to make sense
+	const int prev = (i > 0) ? (i - 1) : ((n >= 4) ? (n - 1) : 0);
 
-			switch(type)
-			{
-			case catmull:  segments.push_back(new CatmullRomSegment(*this, i, p0, p1, c1, c2)); break;
-			case cardinal: segments.push_back(new CardinalSegment(*this, i, p0, p1, c1, c2)); break;
-			case bspline:  segments.push_back(new BSplineSegment(*this, i, p0, p1, c1, c2)); break;
-			}
-		}
+	const CtrlPoint& c1(controlPoints[prev]);
+	const CtrlPoint& c2(controlPoints[(i + 2) % n]);
+
+	switch(type)
+	{
+	case catmull:  return new CatmullRomSegment(*this, i, p0, p1, c1, c2);
+	case cardinal: return new CardinalSegment(*this, i, p0, p1, c1, c2);
+	case bspline:  return new BSplineSegment(*this, i, p0, p1, c1, c2);
+	default:       return new LineSegment(*this, i, p0, p1);
 	}
 }
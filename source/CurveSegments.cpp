@@ -2,6 +2,7 @@
  * CurveSegments.cpp
  */
 #include "CurveSegments.h"
+#include "CurveSnapshot.h"
 #include "CtrlPoint.h"
 #include "MathUtils.h"
 #include "Vec3f.h"
@@ -12,7 +13,11 @@
 
 #include <GL/GL.h>
 
+#include <cmath>
 #include <stdexcept>
+#include <vector>
+
+using std::vector;
 
 // Map CurveType enum value to string representation
 std::string CurveTypeNames[] = {
@@ -22,6 +27,145 @@ std::string CurveTypeNames[] = {
 	"B-Spline"
 };
 
+// The same cubics the segment classes below evaluate
+void segmentBasis(const CurveType type, const float tension, float basis[4][4])
+{
+	const float s = tension;
+	const float catmullBasis [4][4] = { { 0.f, -0.5f,  1.f, -0.5f }, { 1.f, 0.f, -2.5f,  1.5f },
+										{ 0.f,  0.5f,  2.f, -1.5f }, { 0.f, 0.f, -0.5f,  0.5f } };
+	const float cardinalBasis[4][4] = { { 0.f, -s, 2.f * s, -s }, { 1.f, 0.f, s - 3.f, 2.f - s },
+										{ 0.f,  s, 3.f - 2.f * s, s - 2.f }, { 0.f, 0.f, -s, s } };
+	const float bsplineBasis [4][4] = { { 1.f / 6.f, -0.5f,  0.5f, -1.f / 6.f }, { 4.f / 6.f, 0.f, -1.f,  0.5f },
+										{ 1.f / 6.f,  0.5f,  0.5f, -0.5f },      { 0.f,       0.f,  0.f,  1.f / 6.f } };
+	const float linesBasis   [4][4] = { { 0.f, 0.f, 0.f, 0.f }, { 1.f, -1.f, 0.f, 0.f },
+										{ 0.f, 1.f, 0.f, 0.f }, { 0.f,  0.f, 0.f, 0.f } };
+
+	const float (*chosen)[4] = (type == catmull)  ? catmullBasis
+							 : (type == cardinal) ? cardinalBasis
+							 : (type == bspline)  ? bsplineBasis
+							 :                      linesBasis;
+	for(int k = 0; k < 4; ++k)
+		for(int j = 0; j < 4; ++j)
+			basis[k][j] = chosen[k][j];
+}
+
+void bezierPoints(const CubicCoefficients& cubic, Vec3f points[4])
+{
+	float b[4][3];
+	for(int axis = 0; axis < 3; ++axis)
+	{
+		const float *c = cubic.c[axis];
+		b[0][axis] = c[0];
+		b[1][axis] = c[0] + c[1] / 3.f;
+		b[2][axis] = c[0] + (2.f * c[1] + c[2]) / 3.f;
+		b[3][axis] = c[0] + c[1] + c[2] + c[3];
+	}
+
+	for(int k = 0; k < 4; ++k)
+		points[k].set(b[k][0], b[k][1], b[k][2]);
+}
+
+
+/* ==================================================================
+ * Tessellation struct
+ * ==================================================================
+ */
+const float Tessellation::defaultTolerance      = 0.1f;
+const float Tessellation::defaultPixelTolerance = 0.5f;
+
+// Below this the samples would just be wasted on float precision
+static const float minTolerance = 1e-4f;
+
+// Segments this many pixels across or more get their ties, and down
+// to the second size both rails, anything smaller is a single line
+static const LevelOfDetail segmentDetail(60.f, 6.f);
+
+Tessellation::Tessellation()
+	: tolerance(defaultTolerance)
+	, pixelTolerance(defaultPixelTolerance)
+	, levelOfDetail(false)
+	, view()
+{ }
+
+/* toleranceAt() - Gets the tolerance for a segment near 'point' -- */
+/* that was last sampled at 'current' (0 if never) ---------------- */
+/* Tolerances in pixels are rounded down to a power of two, and -- */
+/* 'current' is kept until it's well out of date, so a segment's -- */
+/* cached samples survive the camera moving ----------------------- */
+float Tessellation::toleranceAt(const Vec3f& point, const float current) const
+{
+	if( !levelOfDetail || !view.isValid() )
+		return tolerance;
+
+	const float t = (std::max)(minTolerance, pixelTolerance * view.worldPerPixel(point));
+
+	const float h = LevelOfDetail::defaultHysteresis;
+	if( current > 0.f && t >= current * (1.f - h) && t < 2.f * current * (1.f + h) )
+		return current;
+
+	int exponent = 0;
+	std::frexp(t, &exponent);
+	return std::ldexp(0.5f, exponent);
+}
+
+
+/* railsAt() - Gets both rails' positions at 't' on 'segment' ---- */
+/* The sampling below works on live segments and on snapshots ----- */
+struct RailPoints
+{
+	Vec3f left, right;
+};
+
+template<class Segment>
+static RailPoints railsAt(Segment& segment, const float t)
+{
+	const Vec3f pos (segment.getPosition(t));
+	const Vec3f dir (normalize(segment.getDirection(t)));
+	const Vec3f up  (normalize(segment.getOrientation(t)));
+	const Vec3f side(normalize(cross(dir, up)));
+
+	RailPoints rails;
+	rails.left  = pos +  CurveSegment::radius * side;
+	rails.right = pos + -CurveSegment::radius * side;
+	return rails;
+}
+
+/* chordDistance() - Distance from 'p' to the chord from 'a' to 'b' */
+static float chordDistance(const Vec3f& p, const Vec3f& a, const Vec3f& b)
+{
+	const Vec3f chord(difference(b, a));
+	const Vec3f toP  (difference(p, a));
+	const float lengthSq = dot(chord, chord);
+	const float u = (lengthSq > 0.f) ? dot(toP, chord) / lengthSq : 0.f;
+	const float clamped = (std::min)(1.f, (std::max)(0.f, u));
+	return (toP + -clamped * chord).magnitude();
+}
+
+/* subdivide() - Appends the samples after 't0' up to 't1', halving */
+/* the span while either rail's midpoint is off its chord by more - */
+/* than 'tolerance' ---------------------------------------------- */
+template<class Segment>
+static void subdivide(Segment& segment, const float t0, const float t1,
+					  const RailPoints& r0, const RailPoints& r1,
+					  const int depth, const float tolerance, vector<float>& params)
+{
+	if( depth < CurveSegment::maxDepth )
+	{
+		const float      tm = 0.5f * (t0 + t1);
+		const RailPoints rm(railsAt(segment, tm));
+
+		const float error = (std::max)(chordDistance(rm.left,  r0.left,  r1.left),
+									   chordDistance(rm.right, r0.right, r1.right));
+		if( error > tolerance )
+		{
+			subdivide(segment, t0, tm, r0, rm, depth + 1, tolerance, params);
+			subdivide(segment, tm, t1, rm, r1, depth + 1, tolerance, params);
+			return;
+		}
+	}
+	params.push_back(t1);
+}
+
 
 /* ==================================================================
  * CurveSegment base class
@@ -30,60 +174,243 @@ std::string CurveTypeNames[] = {
 const int   CurveSegment::numLines = 25;
 const float CurveSegment::step     = 1.f / CurveSegment::numLines;
 const float CurveSegment::radius   = 2.9f;
+const float CurveSegment::railHalfWidth = 0.3f;
+const float CurveSegment::railHeight    = 0.6f;
+const int   CurveSegment::minSpans = 2;
+const int   CurveSegment::maxDepth = 6;
+const int   CurveSegment::sampleGrid = CurveSegment::minSpans << CurveSegment::maxDepth;
+
+// Scratch vertex arrays for draw(), only ever called from the GL thread
+static vector<Vec3f> leftRail, rightRail;
+
+/* sampleRails() - Fills 'params' with the t values to sample so -- */
+/* the rails are drawn within 'tolerance' of the true curve. Starts */
+/* from a few even spans so a single midpoint can't miss an S-bend  */
+/* whose middle happens to lie on the chord ----------------------- */
+template<class Segment>
+static void sampleRails(Segment& segment, const float tolerance, vector<float>& params)
+{
+	params.clear();
+	params.push_back(0.f);
 
-void CurveSegment::draw(bool drawPoints, bool isShadowed)
+	const float t = (std::max)(minTolerance, tolerance);
+	RailPoints r0(railsAt(segment, 0.f));
+	for(int i = 1; i <= CurveSegment::minSpans; ++i)
+	{
+		const float      t1 = static_cast<float>(i) / CurveSegment::minSpans;
+		const RailPoints r1(railsAt(segment, t1));
+		subdivide(segment, params.back(), t1, r0, r1, 0, t, params);
+		r0 = r1;
+	}
+}
+
+/* computeSamples() - Fills 'params' with the t values to sample -- */
+/* so the rails are drawn within 'tolerance' of the true curve ---- */
+void CurveSegment::computeSamples(const float tolerance, vector<float>& params)
 {
-	float t = 0.f;
-	glBegin(GL_LINE_STRIP);
-		for(int i = 0; i <= numLines; ++i, t += step)
-		{
-			const Vec3f pos (getPosition(t));
-			const Vec3f dir (normalize(getDirection(t)));
-			const Vec3f up  (normalize(getOrientation(t)));
-			const Vec3f side(normalize(cross(dir, up)));
+	sampleRails(*this, tolerance, params);
+}
 
-			const Vec3f v(pos + radius * side);
+/* SegmentSnapshot::computeSamples() - The same samples for a ----- */
+/* published segment, so other threads can sample it too ---------- */
+void SegmentSnapshot::computeSamples(const float tolerance, vector<float>& params) const
+{
+	sampleRails(*this, tolerance, params);
+}
 
-			glVertex3fv(v.v());
-		}
-	glEnd();
+/* updateSamples() - Picks the samples and detail to draw the ---- */
+/* segment with next. Called by the curve's owner before drawing, - */
+/* the samples are only rebuilt if the tolerance or tension changed */
+void CurveSegment::updateSamples(const Tessellation& tessellation)
+{
+	const Vec3f middle(0.5f * (startPoint.pos() + endPoint.pos()));
 
-	t = 0.f;
-	glBegin(GL_LINE_STRIP);
-		for(int i = 0; i <= numLines; ++i, t += step)
-		{
-			const Vec3f pos (getPosition(t));
-			const Vec3f dir (normalize(getDirection(t)));
-			const Vec3f up  (normalize(getOrientation(t)));
-			const Vec3f side(normalize(cross(dir, up)));
+	const float tolerance = tessellation.toleranceAt(middle, samplesTolerance);
+	if( samples.empty() || samplesTolerance != tolerance || samplesTension != parentCurve->tension )
+	{
+		computeSamples(tolerance, samples);
+		samplesTolerance = tolerance;
+		samplesTension   = parentCurve->tension;
+	}
 
-			const Vec3f v(pos + -radius * side);
-			// Note:     (pos -  radius * side) doesn't work as expected
+	// Pick how much of the segment to draw from its size on screen
+	if( tessellation.levelOfDetail && tessellation.view.isValid() )
+	{
+		const float halfLength = 0.5f * (endPoint.pos() - startPoint.pos()).magnitude() + radius;
+		detail = segmentDetail.select(tessellation.view.pixelsAcross(middle, halfLength), detail);
+	}
+	else
+		detail = detailHigh;
+}
 
-			glVertex3fv(v.v());
-		}
-	glEnd();
+/* updateBounds() - Fits the bounding box to the segment, must --- */
+/* be called again if anything the segment depends on changes ----- */
+void CurveSegment::updateBounds()
+{
+	// Every segment type is a cubic in t, so four samples give its
+	// coefficients, taken relative to the first so far off tracks
+	// don't lose precision
+	const Vec3f p0(getPosition(0.f));
+	const Vec3f p1(getPosition(1.f / 3.f));
+	const Vec3f p2(getPosition(2.f / 3.f));
+	const Vec3f p3(getPosition(1.f));
+
+	for(int axis = 0; axis < 3; ++axis)
+	{
+		const float a = p0.v()[axis];
+		const float b = p1.v()[axis] - a;
+		const float c = p2.v()[axis] - a;
+		const float d = p3.v()[axis] - a;
+		cubic.c[axis][0] = a;
+		cubic.c[axis][1] = 0.5f * ( 18.f * b -  9.f * c + 2.f * d);
+		cubic.c[axis][2] = 0.5f * (-45.f * b + 36.f * c - 9.f * d);
+		cubic.c[axis][3] = 0.5f * ( 27.f * b - 27.f * c + 9.f * d);
+	}
 
-	// Draw ties
-	if( !isShadowed ) glColor4ub(139, 69, 19, 255); // brown
-	glBegin(GL_LINES);
-		for(float t = 0.f, arc_t = 0.f; arc_t <= 1.f; t += step)
-		{
-			const Vec3f pos (getPosition(arc_t));
-			const Vec3f dir (normalize(getDirection(arc_t)));
-			const Vec3f up  (normalize(getOrientation(arc_t)));
-			const Vec3f side(normalize(cross(dir,up)));
+	Vec3f hull[4];
+	bezierPoints(cubic, hull);
 
-			const Vec3f v1(pos +  radius * side);
-			const Vec3f v2(pos + -radius * side);
-			// Note:      (pos -  radius * side) doesn't work as expected
+	bounds = BoundingBox();
+	for(int k = 0; k < 4; ++k)
+		bounds.add(hull[k]);
 
-			glVertex3fv(v1.v());
-			glVertex3fv(v2.v());
+	// The rails and ties are off to the side of the curve
+	bounds.pad(radius + 0.5f);
 
-			arc_t += arcLengthStep(parentCurve, t);
-		}
-	glEnd();
+	// Published versions of the curve can't see the change
+	snapshot.reset();
+}
+
+/* getSnapshot() - An immutable copy of the segment as it is now, - */
+/* shared by every published version until the segment changes ---- */
+SegmentSnapshotPtr CurveSegment::getSnapshot()
+{
+	if( !snapshot )
+	{
+		SegmentSnapshot *copy = new SegmentSnapshot();
+		copy->cubic      = cubic;
+		copy->bounds     = bounds;
+		copy->startPoint = startPoint;
+		copy->endPoint   = endPoint;
+		snapshot.reset(copy);
+	}
+	return snapshot;
+}
+
+/* coarsestSteps() - The fewest even steps that still land on each */
+/* of 'params', which are multiples of 1 / numSteps ---------------- */
+static int coarsestSteps(const vector<float>& params, int numSteps)
+{
+	int used = 0;
+	for each(auto t in params)
+		used |= static_cast<int>(t * numSteps + 0.5f);
+
+	while( numSteps > 1 && (numSteps & 1) == 0 && (used & 1) == 0 )
+	{
+		numSteps >>= 1;
+		used     >>= 1;
+	}
+	return numSteps;
+}
+
+/* tessellateCurve() - Fills 'center' with the curve at each of ---- */
+/* 'params', which must be multiples of 1 / numSteps --------------- */
+void CurveSegment::tessellateCurve(const vector<float>& params, int numSteps,
+								   vector<Vec3f>& center) const
+{
+	center.resize(params.size());
+
+	numSteps = coarsestSteps(params, numSteps);
+	ForwardDifferencer stepper(cubic, startPoint.orient(), endPoint.orient(), numSteps);
+	for(size_t i = 0; i < params.size(); ++i)
+	{
+		const int target = static_cast<int>(params[i] * numSteps + 0.5f);
+		while( stepper.getStep() < target )
+			stepper.advance();
+
+		center[i] = stepper.getPosition();
+	}
+}
+
+/* tessellateRails() - Fills 'left' and 'right' with the rails at -- */
+/* each of 'params', which must be multiples of 1 / numSteps ------- */
+void CurveSegment::tessellateRails(const vector<float>& params, int numSteps,
+								   vector<Vec3f>& left, vector<Vec3f>& right) const
+{
+	left.resize(params.size());
+	right.resize(params.size());
+
+	numSteps = coarsestSteps(params, numSteps);
+	ForwardDifferencer stepper(cubic, startPoint.orient(), endPoint.orient(), numSteps);
+	for(size_t i = 0; i < params.size(); ++i)
+	{
+		const int target = static_cast<int>(params[i] * numSteps + 0.5f);
+		while( stepper.getStep() < target )
+			stepper.advance();
+
+		// Scaling the direction or up doesn't turn their cross product,
+		// so only the side needs normalizing
+		const Vec3f pos (stepper.getPosition());
+		const Vec3f side(normalize(cross(stepper.getDirection(), stepper.getOrientation())));
+
+		left[i]  = pos +  radius * side;
+		right[i] = pos + -radius * side;
+		// Note:     (pos -  radius * side) doesn't work as expected
+	}
+}
+
+/* drawStrip() - Draws 'points' as a line strip from a vertex array */
+static void drawStrip(const vector<Vec3f>& points)
+{
+	if( points.empty() )
+		return;
+
+	glVertexPointer(3, GL_FLOAT, sizeof(Vec3f), points[0].v());
+	glDrawArrays(GL_LINE_STRIP, 0, points.size());
+}
+
+void CurveSegment::draw(bool drawPoints, bool isShadowed)
+{
+	// The samples all lie on the sample grid, so the rails are
+	// stepped along it by forward differences
+	glEnableClientState(GL_VERTEX_ARRAY);
+	if( detail == detailLow )
+	{
+		// The rails would be drawn on top of each other
+		tessellateCurve(samples, sampleGrid, leftRail);
+		drawStrip(leftRail);
+	}
+	else
+	{
+		tessellateRails(samples, sampleGrid, leftRail, rightRail);
+		drawStrip(leftRail);
+		drawStrip(rightRail);
+	}
+	glDisableClientState(GL_VERTEX_ARRAY);
+
+	// Draw ties, once they'd be far enough apart to see
+	if( detail == detailHigh )
+	{
+		if( !isShadowed ) glColor4ub(139, 69, 19, 255); // brown
+		glBegin(GL_LINES);
+			for(float t = 0.f, arc_t = 0.f; arc_t <= 1.f; t += step)
+			{
+				const Vec3f pos (getPosition(arc_t));
+				const Vec3f dir (normalize(getDirection(arc_t)));
+				const Vec3f up  (normalize(getOrientation(arc_t)));
+				const Vec3f side(normalize(cross(dir,up)));
+
+				const Vec3f v1(pos +  radius * side);
+				const Vec3f v2(pos + -radius * side);
+				// Note:      (pos -  radius * side) doesn't work as expected
+
+				glVertex3fv(v1.v());
+				glVertex3fv(v2.v());
+
+				arc_t += arcLengthStep(*parentCurve, t);
+			}
+		glEnd();
+	}
 
 	if( drawPoints )
 	{
@@ -107,6 +434,8 @@ Vec3f CurveSegment::getOrientation(float t)
 int       CurveSegment::getNumber    () const { return number; }
 CurveType CurveSegment::getCurveType () const { return curveType; }
 
+void CurveSegment::setParentCurve(Curve& curve) { parentCurve = &curve; }
+
 CtrlPoint& CurveSegment::getStartPoint () { return startPoint; }
 CtrlPoint& CurveSegment::getEndPoint   () { return endPoint; }
 CtrlPoint& CurveSegment::getControl1   () { return control1; }
@@ -206,7 +535,7 @@ Vec3f CatmullRomSegment::getDirection( float t )
 		(-3.f * tt + 4.f  * t - 1.f) * m0
 	  + ( 9.f * tt - 10.f * t)       * p0 
 	  + (-9.f * tt + 8.f  * t + 1.f) * p1
-	  + ( 2.f * tt -        t)       * m1 )
+	  + ( 3.f * tt - 2.f  * t)       * m1 )
 	);
 
 	return dir.normalize();
@@ -227,7 +556,7 @@ Vec3f CardinalSegment::getPosition( float t )
 	const float tt  = t * t;
 	const float ttt = t * tt;
 
-	const float s = parentCurve.tension;
+	const float s = parentCurve->tension;
 
 	Vec3f pos(
 		((-1.f * s) * ttt + (       2.f * s) * tt + (-1.f * s) * t      ) * m0
@@ -248,7 +577,7 @@ Vec3f CardinalSegment::getDirection( float t )
 
 	const float tt  = t * t;
 
-	const float s = parentCurve.tension;
+	const float s = parentCurve->tension;
 
 	Vec3f dir(
 		(3.f * (-1.f * s) * tt + 2.f * (       2.f * s) * t + (-1.f * s)) * m0
@@ -0,0 +1,153 @@
+/*
+ * CurveSnapshot.cpp
+ */
+#include "CurveSnapshot.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+using std::vector;
+
+
+/* ==================================================================
+ * SegmentSnapshot struct
+ * ==================================================================
+ */
+/* getPosition() - The segment's position at 't' ------------------ */
+Vec3f SegmentSnapshot::getPosition(const float t) const
+{
+	float p[3];
+	for(int axis = 0; axis < 3; ++axis)
+	{
+		const float *c = cubic.c[axis];
+		p[axis] = ((c[3] * t + c[2]) * t + c[1]) * t + c[0];
+	}
+	return Vec3f(p[0], p[1], p[2]);
+}
+
+/* getDirection() - The segment's normalized direction at 't' ----- */
+Vec3f SegmentSnapshot::getDirection(const float t) const
+{
+	float d[3];
+	for(int axis = 0; axis < 3; ++axis)
+	{
+		const float *c = cubic.c[axis];
+		d[axis] = (3.f * c[3] * t + 2.f * c[2]) * t + c[1];
+	}
+	return normalize(Vec3f(d[0], d[1], d[2]));
+}
+
+/* getOrientation() - The up vector blended between the ends ------- */
+Vec3f SegmentSnapshot::getOrientation(const float t) const
+{
+	return lerp(-t, startPoint.orient(), endPoint.orient());
+}
+
+
+/* ==================================================================
+ * CurveSnapshot class
+ * ==================================================================
+ */
+/* CurveSnapshot() - Takes over 'segments', leaving it empty ------- */
+CurveSnapshot::CurveSnapshot(const CurveType type, const float tension, const unsigned int revision,
+							 vector<SegmentSnapshotPtr>& segments)
+	: type(type)
+	, tension(tension)
+	, revision(revision)
+	, segments()
+{
+	this->segments.swap(segments);
+}
+
+/* segmentAt() - The segment 't' falls on, and the t on it --------- */
+/* The curve has to have segments ---------------------------------- */
+const SegmentSnapshot& CurveSnapshot::segmentAt(const float t, float& tUnit) const
+{
+	const float n = static_cast<float>(segments.size());
+
+	float wrapped = std::fmod(t, n);
+	if( wrapped < 0.f )
+		wrapped += n;
+
+	const int number = (std::min)(static_cast<int>(wrapped), static_cast<int>(segments.size()) - 1);
+	tUnit = wrapped - number;
+	return *segments[number];
+}
+
+Vec3f CurveSnapshot::getPosition(const float t) const
+{
+	float tUnit;
+	const SegmentSnapshot& segment = segmentAt(t, tUnit);
+	return segment.getPosition(tUnit);
+}
+
+Vec3f CurveSnapshot::getDirection(const float t) const
+{
+	float tUnit;
+	const SegmentSnapshot& segment = segmentAt(t, tUnit);
+	return segment.getDirection(tUnit);
+}
+
+Vec3f CurveSnapshot::getOrientation(const float t) const
+{
+	float tUnit;
+	const SegmentSnapshot& segment = segmentAt(t, tUnit);
+	return segment.getOrientation(tUnit);
+}
+
+
+/* ==================================================================
+ * SnapshotSlot class
+ * ==================================================================
+ */
+SnapshotSlot::SnapshotSlot()
+	: current(new CurveSnapshotPtr())
+	, epoch(0)
+	, publishing()
+{
+	readers[0] = readers[1] = 0;
+}
+
+SnapshotSlot::~SnapshotSlot()
+{
+	delete current;
+}
+
+/* acquire() - A reference to the latest snapshot, empty if none --- */
+/* has been published. Safe from any thread, never blocks ---------- */
+CurveSnapshotPtr SnapshotSlot::acquire() const
+{
+	volatile long& counter = readers[epoch & 1];
+
+	InterlockedIncrement(&counter);
+	CurveSnapshotPtr snapshot(*current);
+	InterlockedDecrement(&counter);
+
+	return snapshot;
+}
+
+/* publish() - Makes 'snapshot' the latest, readers holding older -- */
+/* ones keep them until they let go -------------------------------- */
+void SnapshotSlot::publish(const CurveSnapshotPtr& snapshot)
+{
+	ScopedLock lock(publishing);
+
+	CurveSnapshotPtr *latest   = new CurveSnapshotPtr(snapshot);
+	CurveSnapshotPtr *previous = reinterpret_cast<CurveSnapshotPtr*>(
+		InterlockedExchangePointer(reinterpret_cast<void* volatile*>(&current), latest));
+
+	nextEpoch();
+	nextEpoch();
+
+	delete previous;
+}
+
+/* nextEpoch() - Moves readers on to the other epoch and waits for - */
+/* the ones counted in this one to finish -------------------------- */
+void SnapshotSlot::nextEpoch()
+{
+	const long leaving = InterlockedExchangeAdd(&epoch, 1) & 1;
+	while( readers[leaving] != 0 )
+		SwitchToThread();
+}
@@ -0,0 +1,472 @@
+/*
+ * EditJournal.cpp
+ */
+#include "EditJournal.h"
+#include "TrackFile.h"
+#include "Curve.h"
+
+#include <Windows.h>
+#define WIN32_LEAN_AND_MEAN
+
+#include <io.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <iostream>
+#include <cstring>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+using std::string;
+using std::vector;
+using std::cout;
+using std::endl;
+
+// Journals shorter than this are never worth compacting
+static const size_t minCompactRecords = 4096;
+
+
+/* checksum() - FNV-1a hash of everything in a record before its checksum */
+static unsigned int checksum(const JournalRecord& record)
+{
+	const unsigned char *bytes = reinterpret_cast<const unsigned char*>(&record);
+	unsigned int hash = 2166136261u;
+	for(size_t i = 0; i < offsetof(JournalRecord, checksum); ++i)
+	{
+		hash ^= bytes[i];
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+/* fileIdentity() - Gets the size and last write time of a file, -- */
+/* false if it can't be found ------------------------------------ */
+static bool fileIdentity(const string& filename, unsigned __int64& size, unsigned __int64& writeTime)
+{
+	WIN32_FILE_ATTRIBUTE_DATA data;
+	if( !GetFileAttributesExA(filename.c_str(), GetFileExInfoStandard, &data) )
+		return false;
+
+	size = (static_cast<unsigned __int64>(data.nFileSizeHigh) << 32)
+		 | data.nFileSizeLow;
+	writeTime = (static_cast<unsigned __int64>(data.ftLastWriteTime.dwHighDateTime) << 32)
+			  | data.ftLastWriteTime.dwLowDateTime;
+	return true;
+}
+
+/* trackIdentity() - Fills in the size and last write time of the track */
+/* file in 'header', which a journal must match to be replayed --- */
+/* Throws TrackFileError if the track file can't be found -------- */
+static void trackIdentity(const string& trackFilename, JournalHeader& header)
+{
+	unsigned __int64 size = 0, writeTime = 0;
+	if( !fileIdentity(trackFilename, size, writeTime) )
+		throw TrackFileError("Error - failed to find track file: " + trackFilename);
+
+	header.trackSize      = size;
+	header.trackWriteTime = writeTime;
+}
+
+/* commitFile() - Makes sure a file written through the C runtime - */
+/* is on the disk, false on failure ------------------------------ */
+static bool commitFile(const string& filename)
+{
+	HANDLE handle = CreateFileA(filename.c_str(), GENERIC_WRITE, 0, nullptr, OPEN_EXISTING,
+								FILE_ATTRIBUTE_NORMAL, nullptr);
+	if( handle == INVALID_HANDLE_VALUE )
+		return false;
+
+	const bool ok = FlushFileBuffers(handle) != 0;
+	CloseHandle(handle);
+	return ok;
+}
+
+/* sameFile() - True if both names lead to the same file --------- */
+static bool sameFile(const string& a, const string& b)
+{
+	char fullA[MAX_PATH], fullB[MAX_PATH];
+	if( GetFullPathNameA(a.c_str(), MAX_PATH, fullA, nullptr) == 0
+	 || GetFullPathNameA(b.c_str(), MAX_PATH, fullB, nullptr) == 0 )
+		return a == b;
+
+	return _stricmp(fullA, fullB) == 0;
+}
+
+/* replay() - Applies one record to the curve -------------------- */
+/* Returns false if the record doesn't fit the curve ------------- */
+static bool replay(const JournalRecord& record, Curve& curve)
+{
+	const float *v = record.values;
+	try {
+		switch(record.op)
+		{
+		case journalMove:
+			curve.moveControlPoint(record.index, Vec3f(v[0], v[1], v[2]));
+			return true;
+		case journalOrient:
+			curve.orientControlPoint(record.index, Vec3f(v[0], v[1], v[2]));
+			return true;
+		case journalInsert:
+			curve.insertControlPoint(record.index,
+				CtrlPoint(Vec3f(v[0], v[1], v[2]), Vec3f(v[3], v[4], v[5])));
+			return true;
+		case journalDelete:
+			curve.delControlPoint(record.index);
+			return true;
+		case journalTension:
+			curve.setTension(v[0]);
+			return true;
+		case journalCurveType:
+			if( record.index < 0 || record.index > bspline )
+				return false;
+			curve.setCurveType(static_cast<CurveType>(record.index));
+			return true;
+		}
+	} catch(Curve::NoSuchPoint&) { }
+	return false;
+}
+
+
+/* ==================================================================
+ * EditJournal class
+ * ==================================================================
+ */
+
+EditJournal::EditJournal()
+	: trackFilename()
+	, file(nullptr)
+	, records()
+	, snapshotSize(0)
+	, snapshotWriteTime(0)
+{ }
+
+EditJournal::~EditJournal()
+{
+	close();
+}
+
+/* journalFilename() - Name of the journal kept for 'trackFilename' */
+string EditJournal::journalFilename(const string& trackFilename)
+{
+	return trackFilename + journalExtension;
+}
+
+/* snapshotFilename() - Name of the snapshot a compacted journal -- */
+/* for 'trackFilename' builds on --------------------------------- */
+string EditJournal::snapshotFilename(const string& trackFilename)
+{
+	return trackFilename + snapshotExtension;
+}
+
+/* newSnapshotFilename() - Where the next snapshot is saved before - */
+/* compact() moves it in ----------------------------------------- */
+string EditJournal::newSnapshotFilename(const string& trackFilename)
+{
+	return trackFilename + ".new" + snapshotExtension;
+}
+
+/* open() - Replays the track's journal into 'curve', which must -- */
+/* hold the points just loaded from 'trackFilename', and keeps ---- */
+/* journaling to it. A compacted journal first puts the points of - */
+/* its snapshot in their place. A journal left from an older ------ */
+/* version of the track, or whose snapshot is gone, is discarded. - */
+/* Returns the number of edits replayed -------------------------- */
+/* 'curve' must not be recording to this journal while it replays */
+int EditJournal::open(const string& trackFilename, Curve& curve)
+{
+	close();
+	this->trackFilename = trackFilename;
+
+	JournalHeader current;
+	trackIdentity(trackFilename, current);
+
+	// Read every record up to the first torn or corrupt one
+	JournalHeader header;
+	memset(&header, 0, sizeof(header));
+	bool matched = false;
+
+	vector<JournalRecord> saved;
+	FILE *in = nullptr;
+	if( fopen_s(&in, journalFilename(trackFilename).c_str(), "rb") == 0 && in != nullptr )
+	{
+		// Version 1 headers stop before the snapshot, which stays 0
+		char *rest = reinterpret_cast<char*>(&header) + journalV1Size;
+		if( fread(&header, journalV1Size, 1, in) == 1
+		 && memcmp(header.magic, journalMagic, sizeof(journalMagic)) == 0
+		 && (header.version == 1
+		  || (header.version == journalVersion && fread(rest, sizeof(header) - journalV1Size, 1, in) == 1))
+		 && header.trackSize      == current.trackSize
+		 && header.trackWriteTime == current.trackWriteTime )
+		{
+			matched = true;
+
+			JournalRecord record;
+			while( fread(&record, sizeof(record), 1, in) == 1 && record.checksum == checksum(record) )
+				saved.push_back(record);
+		}
+		fclose(in);
+	}
+
+	// The records of a compacted journal apply to its snapshot
+	ControlPointVector snapshotPoints;
+	CurveType snapshotType    = curve.getCurveType();
+	float     snapshotTension = curve.tension;
+	if( matched && (header.snapshotSize != 0 || header.snapshotWriteTime != 0) )
+	{
+		if( findSnapshot(header) )
+		{
+			MappedTrack snapshot(snapshotFilename(trackFilename));
+			snapshot.copyTo(snapshotPoints);
+			if( snapshot.hasCurveSettings() )
+			{
+				snapshotType    = snapshot.curveType();
+				snapshotTension = snapshot.tension();
+			}
+		}
+		else
+			saved.clear();
+	}
+
+	curve.beginEdit();
+	if( hasSnapshot() )
+	{
+		curve.swapPoints(snapshotPoints);
+		curve.setCurveType(snapshotType);
+		curve.setTension(snapshotTension);
+	}
+	for each(const auto& record in saved)
+	{
+		if( !replay(record, curve) )
+			break;
+		records.push_back(record);
+	}
+	curve.commitEdit();
+
+	// Drop whatever wasn't replayed so it can't be replayed later
+	rewrite(0);
+	return records.size();
+}
+
+/* start() - Starts an empty journal for 'trackFilename' --------- */
+void EditJournal::start(const string& trackFilename)
+{
+	close();
+	this->trackFilename = trackFilename;
+	rewrite(0);
+}
+
+/* rebase() - Called once the curve has been saved to 'trackFilename', */
+/* keeps only the records from 'firstRecord' on, which were made - */
+/* after the curve was copied for the save. Saved to another file, */
+/* the old track's journal and snapshot are retired, so the old --- */
+/* track loads as it was last saved ------------------------------ */
+void EditJournal::rebase(const string& trackFilename, const size_t firstRecord)
+{
+	const string oldTrackFilename = this->trackFilename;
+
+	this->trackFilename = trackFilename;
+	snapshotSize      = 0;
+	snapshotWriteTime = 0;
+	rewrite((std::min)(firstRecord, records.size()));
+
+	if( !sameFile(oldTrackFilename, trackFilename) )
+	{
+		DeleteFileA(journalFilename(oldTrackFilename).c_str());
+		DeleteFileA(snapshotFilename(oldTrackFilename).c_str());
+		DeleteFileA(newSnapshotFilename(oldTrackFilename).c_str());
+	}
+}
+
+/* compact() - Called once the curve has been saved to ----------- */
+/* newSnapshotFilename(), builds the journal on that snapshot, ---- */
+/* keeping only the records from 'firstRecord' on. The journal is - */
+/* rewritten to name the new snapshot before it's moved over the -- */
+/* old one, so if a crash comes between, open() finishes the move - */
+/* Throws TrackFileError on failure ------------------------------ */
+void EditJournal::compact(const size_t firstRecord)
+{
+	const string newFilename = newSnapshotFilename(trackFilename);
+	const string filename    = snapshotFilename(trackFilename);
+
+	unsigned __int64 size = 0, writeTime = 0;
+	if( !commitFile(newFilename) || !fileIdentity(newFilename, size, writeTime) )
+		throw TrackFileError("Error - failed writing file \"" + newFilename + "\".");
+
+	snapshotSize      = size;
+	snapshotWriteTime = writeTime;
+	rewrite((std::min)(firstRecord, records.size()));
+
+	if( !MoveFileExA(newFilename.c_str(), filename.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) )
+		throw TrackFileError("Error - failed writing file \"" + filename + "\".");
+}
+
+/* close() - Stops journaling, the journal file is kept ---------- */
+void EditJournal::close()
+{
+	if( file != nullptr )
+		fclose(file);
+	file = nullptr;
+	records.clear();
+	snapshotSize      = 0;
+	snapshotWriteTime = 0;
+}
+
+/* findSnapshot() - Looks for the snapshot 'header' builds on, ---- */
+/* finishing a compaction a crash cut short if it has to, and ---- */
+/* keeps building on it. False if it's gone or has changed ------- */
+bool EditJournal::findSnapshot(const JournalHeader& header)
+{
+	const string filename    = snapshotFilename(trackFilename);
+	const string newFilename = newSnapshotFilename(trackFilename);
+
+	unsigned __int64 size = 0, writeTime = 0;
+	bool found = fileIdentity(filename, size, writeTime)
+			  && size == header.snapshotSize && writeTime == header.snapshotWriteTime;
+	if( !found && fileIdentity(newFilename, size, writeTime)
+			   && size == header.snapshotSize && writeTime == header.snapshotWriteTime )
+	{
+		found = MoveFileExA(newFilename.c_str(), filename.c_str(),
+							MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+	}
+
+	if( found )
+	{
+		snapshotSize      = size;
+		snapshotWriteTime = writeTime;
+	}
+	return found;
+}
+
+/* needsCompaction() - True once replaying the journal would cost - */
+/* more than loading a fresh snapshot of the curve --------------- */
+bool EditJournal::needsCompaction(const int numPoints) const
+{
+	return isOpen() && records.size() >= (std::max)(minCompactRecords, static_cast<size_t>(numPoints));
+}
+
+/* rewrite() - Replaces the journal with one holding the records -- */
+/* from 'firstRecord' on, against the track file as it is now ---- */
+/* The new journal is written beside the old one and moved over it, */
+/* so a crash leaves one or the other intact --------------------- */
+/* Throws TrackFileError on failure ------------------------------ */
+void EditJournal::rewrite(const size_t firstRecord)
+{
+	if( file != nullptr )
+	{
+		fclose(file);
+		file = nullptr;
+	}
+	records.erase(records.begin(), records.begin() + firstRecord);
+
+	JournalHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, journalMagic, sizeof(journalMagic));
+	header.version           = journalVersion;
+	header.snapshotSize      = snapshotSize;
+	header.snapshotWriteTime = snapshotWriteTime;
+	trackIdentity(trackFilename, header);
+
+	const string filename = journalFilename(trackFilename);
+	const string tempFilename = filename + ".tmp";
+
+	FILE *out = nullptr;
+	if( fopen_s(&out, tempFilename.c_str(), "wb") != 0 || out == nullptr )
+		throw TrackFileError("Error - failed to open file \"" + tempFilename + "\" for writing.");
+
+	bool ok = fwrite(&header, sizeof(header), 1, out) == 1;
+	if( !records.empty() )
+		ok = ok && fwrite(&records[0], sizeof(JournalRecord), records.size(), out) == records.size();
+	ok = ok && fflush(out) == 0 && _commit(_fileno(out)) == 0;
+	ok = (fclose(out) == 0) && ok;
+
+	if( !ok || !MoveFileExA(tempFilename.c_str(), filename.c_str(),
+							MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) )
+	{
+		DeleteFileA(tempFilename.c_str());
+		records.clear();
+		throw TrackFileError("Error - failed writing file \"" + filename + "\".");
+	}
+
+	if( fopen_s(&file, filename.c_str(), "ab") != 0 || file == nullptr )
+	{
+		file = nullptr;
+		records.clear();
+		throw TrackFileError("Error - failed to open file \"" + filename + "\" for writing.");
+	}
+
+	// Nothing builds on an old snapshot any more
+	if( !hasSnapshot() )
+	{
+		DeleteFileA(snapshotFilename(trackFilename).c_str());
+		DeleteFileA(newSnapshotFilename(trackFilename).c_str());
+	}
+}
+
+/* append() - Writes one record to the end of the journal -------- */
+/* A journal that can't be written to is closed, so the edits ---- */
+/* carry on without it ------------------------------------------- */
+void EditJournal::append(const JournalOp op, const int index, const float *values, const int numValues)
+{
+	if( file == nullptr )
+		return;
+
+	JournalRecord record;
+	memset(&record, 0, sizeof(record));
+	record.op    = op;
+	record.index = index;
+	for(int i = 0; i < numValues; ++i)
+		record.values[i] = values[i];
+	record.checksum = checksum(record);
+
+	// Flushed so the record survives the program crashing
+	if( fwrite(&record, sizeof(record), 1, file) != 1 || fflush(file) != 0 )
+	{
+		cout << "Warning: failed writing to " << journalFilename(trackFilename)
+			 << ", edits are no longer being journaled." << endl;
+		close();
+		return;
+	}
+	records.push_back(record);
+}
+
+/* recordMove() - Journals a control point moving to 'pos' ------- */
+void EditJournal::recordMove(const int index, const Vec3f& pos)
+{
+	const float values[] = { pos.x(), pos.y(), pos.z() };
+	append(journalMove, index, values, 3);
+}
+
+/* recordOrient() - Journals a control point's new orientation --- */
+void EditJournal::recordOrient(const int index, const Vec3f& orient)
+{
+	const float values[] = { orient.x(), orient.y(), orient.z() };
+	append(journalOrient, index, values, 3);
+}
+
+/* recordInsert() - Journals a control point inserted before 'index' */
+void EditJournal::recordInsert(const int index, const CtrlPoint& point)
+{
+	const Vec3f& p(point.pos());
+	const Vec3f& o(point.orient());
+	const float values[] = { p.x(), p.y(), p.z(), o.x(), o.y(), o.z() };
+	append(journalInsert, index, values, 6);
+}
+
+/* recordDelete() - Journals the control point at 'index' being deleted */
+void EditJournal::recordDelete(const int index)
+{
+	append(journalDelete, index, nullptr, 0);
+}
+
+/* recordTension() - Journals a new curve tension ---------------- */
+void EditJournal::recordTension(const float tension)
+{
+	append(journalTension, 0, &tension, 1);
+}
+
+/* recordCurveType() - Journals a new curve type ----------------- */
+void EditJournal::recordCurveType(const CurveType type)
+{
+	append(journalCurveType, static_cast<int>(type), nullptr, 0);
+}
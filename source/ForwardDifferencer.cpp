@@ -0,0 +1,39 @@
+/*
+ * ForwardDifferencer.cpp
+ */
+#include "ForwardDifferencer.h"
+
+
+/* ==================================================================
+ * ForwardDifferencer class
+ * ==================================================================
+ */
+/* ForwardDifferencer() - Starts at t = 0, each advance() moves ---- */
+/* 1 / numSteps along ---------------------------------------------- */
+ForwardDifferencer::ForwardDifferencer(const CubicCoefficients& cubic,
+									   const Vec3f& startOrient, const Vec3f& endOrient,
+									   const int numSteps)
+	: step(0)
+{
+	const double h   = 1.0 / numSteps;
+	const double hh  = h * h;
+	const double hhh = h * hh;
+
+	for(int axis = 0; axis < 3; ++axis)
+	{
+		const float *c = cubic.c[axis];
+
+		position[axis]    = c[0];
+		dPosition[axis]   = c[1] * h + c[2] * hh + c[3] * hhh;
+		ddPosition[axis]  = 2.0 * c[2] * hh + 6.0 * c[3] * hhh;
+		dddPosition[axis] = 6.0 * c[3] * hhh;
+
+		// p'(t) = c[1] + 2 c[2] t + 3 c[3] t^2
+		derivative[axis]   = c[1];
+		dDerivative[axis]  = 2.0 * c[2] * h + 3.0 * c[3] * hh;
+		ddDerivative[axis] = 6.0 * c[3] * hh;
+
+		orientation[axis]  = startOrient.v()[axis];
+		dOrientation[axis] = (endOrient.v()[axis] - startOrient.v()[axis]) * h;
+	}
+}
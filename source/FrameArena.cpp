@@ -0,0 +1,62 @@
+/*
+ * FrameArena.cpp
+ */
+#include "FrameArena.h"
+
+#include <cassert>
+
+
+FrameArena::FrameArena(const size_t capacity)
+	: block(new char[capacity])
+	, capacity(capacity)
+	, used(0)
+	, overflowBytes(0)
+	, overflow()
+{ }
+
+FrameArena::~FrameArena()
+{
+	reset();
+	delete[] block;
+}
+
+/* allocate() - Returns 'bytes' of scratch memory valid until reset() */
+void* FrameArena::allocate(const size_t bytes, const size_t alignment)
+{
+	assert(alignment != 0 && (alignment & (alignment - 1)) == 0);
+
+	const size_t start = (used + alignment - 1) & ~(alignment - 1);
+	if( start + bytes <= capacity )
+	{
+		used = start + bytes;
+		return block + start;
+	}
+
+	// Out of room this frame, fall back to the heap
+	char *memory = new char[bytes + alignment];
+	overflow.push_back(memory);
+	overflowBytes += bytes + alignment;
+
+	const size_t address = reinterpret_cast<size_t>(memory);
+	return memory + (((address + alignment - 1) & ~(alignment - 1)) - address);
+}
+
+/* reset() - Releases everything allocated since the last reset -- */
+void FrameArena::reset()
+{
+	if( !overflow.empty() )
+	{
+		for each(auto memory in overflow)
+			delete[] memory;
+		overflow.clear();
+
+		// Grow so the same frame fits in the block next time
+		const size_t needed = used + overflowBytes;
+		delete[] block;
+		capacity = needed + needed / 2;
+		block    = new char[capacity];
+	}
+
+	used          = 0;
+	overflowBytes = 0;
+}
@@ -0,0 +1,495 @@
+/*
+ * FrameExporter.cpp
+ */
+#include "FrameExporter.h"
+
+// GLee has to come before any other OpenGL headers
+#include "TrainFiles/Utilities/GLee.h"
+
+#include "MainWindow.h"
+#include "MainView.h"
+#include "Curve.h"
+
+#ifndef WIN32
+#include <EGL/eglext.h>
+#endif
+
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <string>
+#include <vector>
+
+using std::string;
+using std::vector;
+using std::cout;
+using std::endl;
+
+
+/* writeTGA() - Writes a bottom-up 32 bit BGRA image as an uncompressed targa */
+static bool writeTGA(const string& filename, const int width, const int height,
+					 const unsigned char *bgra)
+{
+	FILE *file = nullptr;
+	if( fopen_s(&file, filename.c_str(), "wb") != 0 || file == nullptr )
+		return false;
+
+	unsigned char header[18] = { 0 };
+	header[2]  = 2;                                      // uncompressed true-color
+	header[12] = static_cast<unsigned char>(width  & 0xff);
+	header[13] = static_cast<unsigned char>(width  >> 8);
+	header[14] = static_cast<unsigned char>(height & 0xff);
+	header[15] = static_cast<unsigned char>(height >> 8);
+	header[16] = 32;                                     // bits per pixel
+	header[17] = 8;                                      // alpha bits, origin bottom-left
+
+	const size_t numBytes = static_cast<size_t>(width) * height * 4;
+	const bool ok = fwrite(header, sizeof(header), 1, file) == 1
+				 && fwrite(bgra, 1, numBytes, file) == numBytes;
+	fclose(file);
+
+	return ok;
+}
+
+
+/* ==================================================================
+ * OffscreenContext class
+ * ==================================================================
+ */
+
+#ifdef WIN32
+
+OffscreenContext::OffscreenContext()
+	: hwnd(NULL)
+	, hdc(NULL)
+	, hglrc(NULL)
+	, framebuffer(0)
+	, colorBuffer(0)
+	, depthBuffer(0)
+	, width(0)
+	, height(0)
+{ }
+
+/* createContext() - Makes a hidden window and a WGL context on it - */
+bool OffscreenContext::createContext()
+{
+	static const TCHAR *className = TEXT("cs559-offscreen");
+
+	WNDCLASS wc      = { 0 };
+	wc.style         = CS_OWNDC;
+	wc.lpfnWndProc   = DefWindowProc;
+	wc.hInstance     = GetModuleHandle(NULL);
+	wc.lpszClassName = className;
+	RegisterClass(&wc); // fails harmlessly if already registered
+
+	// The window is never shown, it only exists to own a device context
+	hwnd = CreateWindow(className, TEXT(""), WS_POPUP, 0, 0, 1, 1,
+						NULL, NULL, wc.hInstance, NULL);
+	if( hwnd == NULL )
+	{
+		cout << "Error: unable to create offscreen window." << endl;
+		return false;
+	}
+	hdc = GetDC(hwnd);
+
+	PIXELFORMATDESCRIPTOR pfd = { 0 };
+	pfd.nSize        = sizeof(pfd);
+	pfd.nVersion     = 1;
+	pfd.dwFlags      = PFD_DRAW_TO_WINDOW | PFD_SUPPORT_OPENGL;
+	pfd.iPixelType   = PFD_TYPE_RGBA;
+	pfd.cColorBits   = 32;
+	pfd.cAlphaBits   = 8;
+	pfd.cDepthBits   = 24;
+	pfd.cStencilBits = 8;
+
+	const int format = ChoosePixelFormat(hdc, &pfd);
+	if( format == 0 || !SetPixelFormat(hdc, format, &pfd) )
+	{
+		cout << "Error: no suitable pixel format for offscreen rendering." << endl;
+		destroyContext();
+		return false;
+	}
+
+	hglrc = wglCreateContext(hdc);
+	if( hglrc == NULL || !wglMakeCurrent(hdc, hglrc) )
+	{
+		cout << "Error: unable to create offscreen OpenGL context." << endl;
+		destroyContext();
+		return false;
+	}
+
+	return true;
+}
+
+/* destroyContext() - Releases the context and window ------------ */
+void OffscreenContext::destroyContext()
+{
+	if( hglrc != NULL )
+	{
+		wglMakeCurrent(NULL, NULL);
+		wglDeleteContext(hglrc);
+		hglrc = NULL;
+	}
+	if( hdc != NULL )
+	{
+		ReleaseDC(hwnd, hdc);
+		hdc = NULL;
+	}
+	if( hwnd != NULL )
+	{
+		DestroyWindow(hwnd);
+		hwnd = NULL;
+	}
+}
+
+/* hasContext() - True between createContext() and destroyContext() */
+bool OffscreenContext::hasContext() const
+{
+	return hglrc != NULL;
+}
+
+#else
+
+// (older eglext.h headers don't have Mesa's surfaceless platform)
+#ifndef EGL_PLATFORM_SURFACELESS_MESA
+#define EGL_PLATFORM_SURFACELESS_MESA 0x31DD
+#endif
+
+OffscreenContext::OffscreenContext()
+	: display(EGL_NO_DISPLAY)
+	, surface(EGL_NO_SURFACE)
+	, context(EGL_NO_CONTEXT)
+	, framebuffer(0)
+	, colorBuffer(0)
+	, depthBuffer(0)
+	, width(0)
+	, height(0)
+{ }
+
+/* hasDisplayServer() - True if an X or Wayland display is set ---- */
+static bool hasDisplayServer()
+{
+	const char *x11     = getenv("DISPLAY");
+	const char *wayland = getenv("WAYLAND_DISPLAY");
+	return (x11 != nullptr && *x11 != 0) || (wayland != nullptr && *wayland != 0);
+}
+
+/* openDisplay() - Opens the EGL display to render on. Without a -- */
+/* display server that's Mesa's surfaceless platform, which needs -- */
+/* nothing but its software renderer (or a render node) ----------- */
+static EGLDisplay openDisplay()
+{
+	const char *clientExtensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+	const bool  hasSurfaceless   = clientExtensions != nullptr
+								&& strstr(clientExtensions, "EGL_MESA_platform_surfaceless") != nullptr;
+
+	PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+		reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(eglGetProcAddress("eglGetPlatformDisplayEXT"));
+
+	EGLDisplay display = EGL_NO_DISPLAY;
+	if( !hasDisplayServer() && hasSurfaceless && getPlatformDisplay != nullptr )
+		display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+	if( display == EGL_NO_DISPLAY )
+		display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+	if( display != EGL_NO_DISPLAY && !eglInitialize(display, nullptr, nullptr) )
+		display = EGL_NO_DISPLAY;
+
+	return display;
+}
+
+/* createContext() - Makes an EGL context on a small pbuffer ------ */
+bool OffscreenContext::createContext()
+{
+	display = openDisplay();
+	if( display == EGL_NO_DISPLAY )
+	{
+		cout << "Error: unable to open an EGL display." << endl;
+		return false;
+	}
+
+	// Desktop OpenGL rather than ES, the scene is drawn fixed function
+	static const EGLint configAttribs[] =
+	{
+		EGL_SURFACE_TYPE,    EGL_PBUFFER_BIT,
+		EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+		EGL_RED_SIZE,   8,
+		EGL_GREEN_SIZE, 8,
+		EGL_BLUE_SIZE,  8,
+		EGL_ALPHA_SIZE, 8,
+		EGL_NONE
+	};
+
+	EGLConfig config = nullptr;
+	EGLint numConfigs = 0;
+	if( !eglBindAPI(EGL_OPENGL_API)
+	 || !eglChooseConfig(display, configAttribs, &config, 1, &numConfigs) || numConfigs == 0 )
+	{
+		cout << "Error: no suitable EGL config for offscreen rendering." << endl;
+		destroyContext();
+		return false;
+	}
+
+	// Frames are drawn into the framebuffer object, the pbuffer is
+	// only there to make the context current on
+	static const EGLint pbufferAttribs[] = { EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE };
+
+	surface = eglCreatePbufferSurface(display, config, pbufferAttribs);
+	context = eglCreateContext(display, config, EGL_NO_CONTEXT, nullptr);
+	if( surface == EGL_NO_SURFACE || context == EGL_NO_CONTEXT
+	 || !eglMakeCurrent(display, surface, surface, context) )
+	{
+		cout << "Error: unable to create offscreen OpenGL context." << endl;
+		destroyContext();
+		return false;
+	}
+
+	return true;
+}
+
+/* destroyContext() - Releases the context, pbuffer and display --- */
+void OffscreenContext::destroyContext()
+{
+	if( display != EGL_NO_DISPLAY )
+	{
+		eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+		if( context != EGL_NO_CONTEXT )
+			eglDestroyContext(display, context);
+		if( surface != EGL_NO_SURFACE )
+			eglDestroySurface(display, surface);
+		eglTerminate(display);
+	}
+	display = EGL_NO_DISPLAY;
+	surface = EGL_NO_SURFACE;
+	context = EGL_NO_CONTEXT;
+}
+
+/* hasContext() - True between createContext() and destroyContext() */
+bool OffscreenContext::hasContext() const
+{
+	return context != EGL_NO_CONTEXT;
+}
+
+#endif
+
+OffscreenContext::~OffscreenContext()
+{
+	destroy();
+}
+
+/* create() - Makes a context, and a framebuffer of the given size on it */
+bool OffscreenContext::create(const int w, const int h)
+{
+	if( !createContext() )
+		return false;
+
+	// Windows' own OpenGL 1.1 renderer ("GDI Generic"), all there is
+	// without a graphics driver, has neither
+	if( !GLEE_EXT_framebuffer_object || !GLEE_EXT_packed_depth_stencil )
+	{
+		const char *renderer = reinterpret_cast<const char*>(glGetString(GL_RENDERER));
+		cout << "Error: offscreen rendering requires EXT_framebuffer_object "
+			 << "and EXT_packed_depth_stencil, which the OpenGL renderer ("
+			 << (renderer != nullptr ? renderer : "unknown") << ") doesn't have. "
+			 << "Is a graphics driver installed?" << endl;
+		destroy();
+		return false;
+	}
+
+	width  = w;
+	height = h;
+
+	glGenFramebuffersEXT(1, &framebuffer);
+	glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, framebuffer);
+
+	glGenRenderbuffersEXT(1, &colorBuffer);
+	glBindRenderbufferEXT(GL_RENDERBUFFER_EXT, colorBuffer);
+	glRenderbufferStorageEXT(GL_RENDERBUFFER_EXT, GL_RGBA8, width, height);
+	glFramebufferRenderbufferEXT(GL_FRAMEBUFFER_EXT, GL_COLOR_ATTACHMENT0_EXT,
+								 GL_RENDERBUFFER_EXT, colorBuffer);
+
+	// Shadows use the stencil buffer, so depth and stencil are packed together
+	glGenRenderbuffersEXT(1, &depthBuffer);
+	glBindRenderbufferEXT(GL_RENDERBUFFER_EXT, depthBuffer);
+	glRenderbufferStorageEXT(GL_RENDERBUFFER_EXT, GL_DEPTH24_STENCIL8_EXT, width, height);
+	glFramebufferRenderbufferEXT(GL_FRAMEBUFFER_EXT, GL_DEPTH_ATTACHMENT_EXT,
+								 GL_RENDERBUFFER_EXT, depthBuffer);
+	glFramebufferRenderbufferEXT(GL_FRAMEBUFFER_EXT, GL_STENCIL_ATTACHMENT_EXT,
+								 GL_RENDERBUFFER_EXT, depthBuffer);
+
+	if( glCheckFramebufferStatusEXT(GL_FRAMEBUFFER_EXT) != GL_FRAMEBUFFER_COMPLETE_EXT )
+	{
+		cout << "Error: offscreen framebuffer is incomplete." << endl;
+		destroy();
+		return false;
+	}
+
+	return true;
+}
+
+/* destroy() - Releases the framebuffer and the context --------- */
+void OffscreenContext::destroy()
+{
+	if( hasContext() && framebuffer != 0 )
+	{
+		glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, 0);
+		glDeleteRenderbuffersEXT(1, &depthBuffer);
+		glDeleteRenderbuffersEXT(1, &colorBuffer);
+		glDeleteFramebuffersEXT(1, &framebuffer);
+	}
+	framebuffer = colorBuffer = depthBuffer = 0;
+
+	destroyContext();
+	width = height = 0;
+}
+
+/* readPixels() - Copies the framebuffer into 'bgra' (width*height*4 bytes) */
+void OffscreenContext::readPixels(unsigned char *bgra) const
+{
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glReadBuffer(GL_COLOR_ATTACHMENT0_EXT);
+	glReadPixels(0, 0, width, height, GL_BGRA_EXT, GL_UNSIGNED_BYTE, bgra);
+}
+
+
+/* ==================================================================
+ * FrameWriter class
+ * ==================================================================
+ */
+
+FrameWriter::FrameWriter(const int width, const int height, const int numBuffers)
+	: width(width)
+	, height(height)
+	, frames(numBuffers)
+	, nextFill(0)
+	, nextWrite(0)
+	, numWritten(0)
+	, freeFrames(numBuffers, numBuffers)
+	, filledFrames(0, numBuffers)
+	, worker()
+{
+	for each(auto& frame in frames)
+		frame.pixels.resize(static_cast<size_t>(width) * height * 4);
+
+	worker.start(&FrameWriter::run, this);
+}
+
+FrameWriter::~FrameWriter()
+{
+	finish();
+}
+
+/* acquire() - Waits for a free frame buffer and returns its pixels */
+unsigned char* FrameWriter::acquire()
+{
+	freeFrames.wait();
+	return &frames[nextFill].pixels[0];
+}
+
+/* submit() - Queues the last acquired frame to be written to 'filename' */
+void FrameWriter::submit(const string& filename)
+{
+	frames[nextFill].filename = filename;
+	nextFill = (nextFill + 1) % frames.size();
+	filledFrames.post();
+}
+
+/* finish() - Waits for all queued frames to be written ---------- */
+/* Returns the number of frames successfully written ------------- */
+int FrameWriter::finish()
+{
+	if( worker.isRunning() )
+	{
+		// An empty filename tells the worker to stop
+		acquire();
+		submit(string());
+		worker.join();
+	}
+	return numWritten;
+}
+
+/* run() - Worker thread entry point ----------------------------- */
+void FrameWriter::run(void *pWriter)
+{
+	reinterpret_cast<FrameWriter*>(pWriter)->writeFrames();
+}
+
+/* writeFrames() - Writes frames in submission order until told to stop */
+void FrameWriter::writeFrames()
+{
+	for(;;)
+	{
+		filledFrames.wait();
+
+		const Frame& frame = frames[nextWrite];
+		nextWrite = (nextWrite + 1) % frames.size();
+
+		if( frame.filename.empty() )
+			break;
+
+		if( writeTGA(frame.filename, width, height, &frame.pixels[0]) )
+			++numWritten;
+		else
+			cout << "Error: failed to write frame " << frame.filename << endl;
+
+		freeFrames.post();
+	}
+}
+
+
+/* ==================================================================
+ * FrameExporter class
+ * ==================================================================
+ */
+
+FrameExporter::FrameExporter(MainView& view)
+	: view(view)
+{ }
+
+/* exportLap() - Renders 'numFrames' evenly spaced steps of one lap from */
+/* each view and writes them to 'directory' as <view>_<frame>.tga */
+/* Returns the number of image files written --------------------- */
+int FrameExporter::exportLap(const string& directory, const int numFrames,
+							 const int width, const int height)
+{
+	OffscreenContext context;
+	if( numFrames <= 0 || !context.create(width, height) )
+		return 0;
+
+	MainWindow *window = view.getWindow();
+	Curve&      curve  = window->getCurve();
+
+	const bool  oldDetail   = window->isLevelOfDetail();
+	const float lapLength   = static_cast<float>(curve.numSegments());
+	const ViewType views[]  = { arcball, train, overhead };
+	const int      numViews = sizeof(views) / sizeof(views[0]);
+
+	FrameWriter writer(width, height);
+	char filename[32];
+
+	// Full detail, so frames don't depend on the size they're rendered at
+	window->setLevelOfDetail(false);
+
+	for(int frame = 0; frame < numFrames; ++frame)
+	{
+		const float t = lapLength * frame / numFrames;
+		curve.selectedSegment = static_cast<int>(std::floor(t));
+
+		for(int i = 0; i < numViews; ++i)
+		{
+			view.renderOffscreen(views[i], width, height, t);
+
+			// Read back on this thread, encode and write on the worker
+			context.readPixels(writer.acquire());
+
+			sprintf_s(filename, "_%05d.tga", frame);
+			writer.submit(directory + "/" + ViewTypeNames[views[i]] + filename);
+		}
+	}
+
+	window->setLevelOfDetail(oldDetail);
+
+	return writer.finish();
+}
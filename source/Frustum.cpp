@@ -0,0 +1,120 @@
+/*
+ * Frustum.cpp
+ */
+#include "Frustum.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+
+/* ==================================================================
+ * BoundingBox struct
+ * ==================================================================
+ */
+BoundingBox::BoundingBox()
+	: minimum( (std::numeric_limits<float>::max)(),  (std::numeric_limits<float>::max)(),  (std::numeric_limits<float>::max)())
+	, maximum(-(std::numeric_limits<float>::max)(), -(std::numeric_limits<float>::max)(), -(std::numeric_limits<float>::max)())
+{ }
+
+/* add() - Grows the box to hold 'point' ------------------------- */
+void BoundingBox::add(const Vec3f& point)
+{
+	minimum.set((std::min)(minimum.x(), point.x()), (std::min)(minimum.y(), point.y()), (std::min)(minimum.z(), point.z()));
+	maximum.set((std::max)(maximum.x(), point.x()), (std::max)(maximum.y(), point.y()), (std::max)(maximum.z(), point.z()));
+}
+
+/* add() - Grows the box to hold 'box' --------------------------- */
+void BoundingBox::add(const BoundingBox& box)
+{
+	if( box.isEmpty() )
+		return;
+	add(box.minimum);
+	add(box.maximum);
+}
+
+/* pad() - Grows the box by 'amount' on every side --------------- */
+void BoundingBox::pad(const float amount)
+{
+	if( isEmpty() )
+		return;
+	minimum.set(minimum.x() - amount, minimum.y() - amount, minimum.z() - amount);
+	maximum.set(maximum.x() + amount, maximum.y() + amount, maximum.z() + amount);
+}
+
+Vec3f BoundingBox::center() const
+{
+	return 0.5f * (minimum + maximum);
+}
+
+Vec3f BoundingBox::extents() const
+{
+	return difference(maximum, minimum);
+}
+
+
+/* ==================================================================
+ * Frustum class
+ * ==================================================================
+ */
+Frustum::Frustum()
+	: valid(false)
+{
+	for(int i = 0; i < 6; ++i)
+		planes[i][0] = planes[i][1] = planes[i][2] = planes[i][3] = 0.f;
+}
+
+/* Extracts the planes from the rows of projection * modelview ---- */
+/* (Gribb & Hartmann), the matrices are OpenGL style column major -- */
+Frustum::Frustum(const float modelview[16], const float projection[16])
+	: valid(true)
+{
+	float m[16];
+	for(int column = 0; column < 4; ++column)
+	{
+		for(int row = 0; row < 4; ++row)
+		{
+			m[column * 4 + row] = projection[0 * 4 + row] * modelview[column * 4 + 0]
+								+ projection[1 * 4 + row] * modelview[column * 4 + 1]
+								+ projection[2 * 4 + row] * modelview[column * 4 + 2]
+								+ projection[3 * 4 + row] * modelview[column * 4 + 3];
+		}
+	}
+
+	// Left, right, bottom, top, near, far: row 3 plus or minus rows 0, 1, 2
+	for(int i = 0; i < 6; ++i)
+	{
+		const int   row  = i / 2;
+		const float sign = (i % 2 == 0) ? 1.f : -1.f;
+		for(int k = 0; k < 4; ++k)
+			planes[i][k] = m[k * 4 + 3] + sign * m[k * 4 + row];
+
+		const float length = std::sqrt(planes[i][0] * planes[i][0] + planes[i][1] * planes[i][1]
+									 + planes[i][2] * planes[i][2]);
+		if( length > 0.f )
+		{
+			for(int k = 0; k < 4; ++k)
+				planes[i][k] /= length;
+		}
+	}
+}
+
+/* intersects() - False only if 'box' is entirely outside a plane, - */
+/* so a few boxes just outside the corners are kept --------------- */
+bool Frustum::intersects(const BoundingBox& box) const
+{
+	if( !valid || box.isEmpty() )
+		return true;
+
+	for(int i = 0; i < 6; ++i)
+	{
+		// The corner furthest along the plane's normal
+		const float x = (planes[i][0] >= 0.f) ? box.maximum.x() : box.minimum.x();
+		const float y = (planes[i][1] >= 0.f) ? box.maximum.y() : box.minimum.y();
+		const float z = (planes[i][2] >= 0.f) ? box.maximum.z() : box.minimum.z();
+
+		if( planes[i][0] * x + planes[i][1] * y + planes[i][2] * z + planes[i][3] < 0.f )
+			return false;
+	}
+	return true;
+}
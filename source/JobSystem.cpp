@@ -0,0 +1,273 @@
+/*
+ * JobSystem.cpp
+ */
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <cassert>
+
+
+/* ==================================================================
+ * JobSystem class
+ * ==================================================================
+ */
+JobSystem::JobSystem()
+	: sharedLock()
+	, numWorkers((std::min)(numHardwareThreads() - 1, static_cast<int>(maxWorkers)))
+	, workerSlot(TlsAlloc())
+	, wakeups(0, 0x7fffffff)
+	, sleeping(0)
+	, stopping(0)
+{
+	assert(workerSlot != TLS_OUT_OF_INDEXES);
+
+	// Everything else has to be set up before the first one starts
+	for(int i = 0; i < numWorkers; ++i)
+	{
+		starts[i].system = this;
+		starts[i].number = i + 1;
+		workers[i].start(&JobSystem::workerMain, &starts[i]);
+	}
+}
+
+JobSystem::~JobSystem()
+{
+	InterlockedExchange(&stopping, 1);
+	wakeups.post(numWorkers);
+	for(int i = 0; i < numWorkers; ++i)
+		workers[i].join();
+
+	TlsFree(workerSlot);
+}
+
+/* get() - Returns the single job system, starting its workers the */
+/* first time. Call it once on the main thread before any other --- */
+/* thread can, the first call isn't thread safe -------------------- */
+JobSystem& JobSystem::get()
+{
+	static JobSystem jobs;
+	return jobs;
+}
+
+/* init() - Sets up 'job' to call function(pData), as a child of ---- */
+/* 'parent' if there is one, which won't finish before it does. ---- */
+/* Children have to be added before their parent finishes ---------- */
+void JobSystem::init(Job& job, JobFunction function, void *pData, Job *parent, const ProfileStage stage)
+{
+	job.function     = function;
+	job.data         = pData;
+	job.parent       = parent;
+	job.continuation = nullptr;
+	job.stage        = stage;
+	job.unfinished   = 1;
+
+	if( parent != nullptr )
+		InterlockedIncrement(&parent->unfinished);
+}
+
+/* setContinuation() - Runs 'continuation' once 'job' and all its -- */
+/* children have finished, has to be set before 'job' is run ------- */
+void JobSystem::setContinuation(Job& job, Job& continuation)
+{
+	job.continuation = &continuation;
+}
+
+/* run() - Queues 'job' to be run by any thread -------------------- */
+void JobSystem::run(Job& job)
+{
+	push(&job);
+}
+
+/* wait() - Runs queued jobs until 'job' has finished -------------- */
+void JobSystem::wait(const Job& job)
+{
+	const int number = currentDeque();
+	while( !isDone(job) )
+	{
+		Job *other = next(number);
+		if( other != nullptr )
+			execute(other);
+		else
+			SwitchToThread(); // the rest are running on other threads
+	}
+}
+
+struct ParallelForRange
+{
+	ParallelForFunction function;
+	void               *data;
+	int                 begin;
+	int                 end;
+};
+
+/* runRange() - Job function, calls a parallelFor's function for --- */
+/* each index in a range ------------------------------------------- */
+static void runRange(void *pRange)
+{
+	const ParallelForRange *range = reinterpret_cast<ParallelForRange*>(pRange);
+	for(int i = range->begin; i < range->end; ++i)
+		range->function(i, range->data);
+}
+
+/* parallelFor() - Calls function(i, pData) for every i in [0,count) */
+/* as a few jobs per thread, returns when all calls are done. A ---- */
+/* single call is made straight away on the calling thread --------- */
+void JobSystem::parallelFor(const int count, ParallelForFunction function, void *pData,
+							const ProfileStage stage)
+{
+	static const int rangesPerThread = 4;
+	static const int maxRanges       = rangesPerThread * (maxWorkers + 1);
+
+	if( count <= 0 )
+		return;
+
+	// Queueing it would only wake a worker to steal it while we wait
+	if( count == 1 )
+	{
+		const LONGLONG start = Profiler::get().now();
+		function(0, pData);
+		if( stage != numProfileStages )
+			Profiler::get().record(stage, start, Profiler::get().now());
+		return;
+	}
+
+	const int numRanges = (std::min)(count, rangesPerThread * (numWorkers + 1));
+
+	Job              root;
+	Job              jobs[maxRanges];
+	ParallelForRange ranges[maxRanges];
+
+	init(root, nullptr, nullptr, nullptr, numProfileStages);
+	for(int i = 0; i < numRanges; ++i)
+	{
+		ranges[i].function = function;
+		ranges[i].data     = pData;
+		ranges[i].begin    = static_cast<int>(static_cast<__int64>(count) * i / numRanges);
+		ranges[i].end      = static_cast<int>(static_cast<__int64>(count) * (i + 1) / numRanges);
+
+		init(jobs[i], &runRange, &ranges[i], &root, stage);
+		run(jobs[i]);
+	}
+
+	// The root has nothing of its own to do
+	finish(&root);
+	wait(root);
+}
+
+/* workerMain() - Thread function, runs a worker until stopped ----- */
+void JobSystem::workerMain(void *pStart)
+{
+	const WorkerStart *start = reinterpret_cast<WorkerStart*>(pStart);
+	start->system->work(start->number);
+}
+
+/* work() - Runs jobs, sleeping whenever there are none to run ----- */
+void JobSystem::work(const int number)
+{
+	TlsSetValue(workerSlot, reinterpret_cast<void*>(static_cast<size_t>(number)));
+
+	while( stopping == 0 )
+	{
+		Job *job = next(number);
+		if( job == nullptr )
+		{
+			// Count in as sleeping before looking one last time, so a
+			// job queued meanwhile is either found here or wakes us
+			InterlockedIncrement(&sleeping);
+			job = next(number);
+			if( job == nullptr && stopping == 0 )
+				wakeups.wait();
+			InterlockedDecrement(&sleeping);
+		}
+
+		if( job != nullptr )
+			execute(job);
+	}
+}
+
+/* currentDeque() - The calling thread's deque, 0 if it's not a worker */
+int JobSystem::currentDeque() const
+{
+	return static_cast<int>(reinterpret_cast<size_t>(TlsGetValue(workerSlot)));
+}
+
+/* push() - Queues 'job' on the calling thread's deque, or runs it - */
+/* straight away if that's full ------------------------------------ */
+void JobSystem::push(Job *job)
+{
+	const int number = currentDeque();
+
+	bool queued;
+	if( number == 0 )
+	{
+		ScopedLock lock(sharedLock);
+		queued = deques[0].push(job);
+	}
+	else
+	{
+		queued = deques[number].push(job);
+	}
+
+	if( !queued )
+		execute(job);
+	else if( sleeping > 0 )
+		wakeups.post();
+}
+
+/* next() - The next job for deque 'number's thread: its own newest, */
+/* or else the oldest in another deque, nullptr if they're all empty */
+Job* JobSystem::next(const int number)
+{
+	Job *job;
+	if( number == 0 )
+	{
+		ScopedLock lock(sharedLock);
+		job = deques[0].pop();
+	}
+	else
+	{
+		job = deques[number].pop();
+	}
+
+	// Start stealing after our own deque, so thieves spread out
+	const int numDeques = numWorkers + 1;
+	for(int i = 1; job == nullptr && i < numDeques; ++i)
+	{
+		JobDeque& victim = deques[(number + i) % numDeques];
+		while( job == nullptr && !victim.isEmpty() )
+			job = victim.steal();
+	}
+
+	return job;
+}
+
+/* execute() - Runs 'job' on the calling thread -------------------- */
+void JobSystem::execute(Job *job)
+{
+	const LONGLONG start = Profiler::get().now();
+
+	if( job->function != nullptr )
+		job->function(job->data);
+
+	if( job->stage != numProfileStages )
+		Profiler::get().record(job->stage, start, Profiler::get().now());
+
+	finish(job);
+}
+
+/* finish() - Marks one part of 'job' done, and if that was the last */
+/* one starts its continuation and tells its parent ---------------- */
+void JobSystem::finish(Job *job)
+{
+	// Whoever waits on the job can let it go as soon as it's done
+	Job *parent       = job->parent;
+	Job *continuation = job->continuation;
+
+	if( InterlockedDecrement(&job->unfinished) != 0 )
+		return;
+
+	if( continuation != nullptr )
+		push(continuation);
+	if( parent != nullptr )
+		finish(parent);
+}
@@ -0,0 +1,94 @@
+/*
+ * LevelOfDetail.cpp
+ */
+#include "LevelOfDetail.h"
+
+#include <cmath>
+
+
+/* ==================================================================
+ * ScreenProjection struct
+ * ==================================================================
+ */
+ScreenProjection::ScreenProjection()
+	: perspective(false)
+	, eye()
+	, pixelSize(0.f)
+{ }
+
+/* Takes the camera from OpenGL style (column major) matrices, the */
+/* modelview can't have any scaling in it ------------------------- */
+ScreenProjection::ScreenProjection(const float modelview[16], const float projection[16],
+								   const int viewportHeight)
+	: perspective(projection[11] != 0.f)
+	, eye()
+	, pixelSize(0.f)
+{
+	// The eye is -R^T * t for a modelview with rotation R and translation t
+	const float *m = modelview;
+	eye.set(-(m[0] * m[12] + m[1] * m[13] + m[2]  * m[14]),
+			-(m[4] * m[12] + m[5] * m[13] + m[6]  * m[14]),
+			-(m[8] * m[12] + m[9] * m[13] + m[10] * m[14]));
+
+	// A pixel spans 2 / (P[5] * height) in y, at a depth of 1 when the
+	// projection is perspective, everywhere when it's orthographic
+	if( projection[5] != 0.f && viewportHeight > 0 )
+		pixelSize = 2.f / (std::fabs(projection[5]) * viewportHeight);
+}
+
+/* worldPerPixel() - World size of a pixel at 'point' ------------ */
+float ScreenProjection::worldPerPixel(const Vec3f& point) const
+{
+	return perspective ? pixelSize * (point - eye).magnitude() : pixelSize;
+}
+
+/* pixelsAcross() - Roughly how many pixels wide a sphere at ----- */
+/* 'center' looks, as big as the screen if the eye is inside it --- */
+float ScreenProjection::pixelsAcross(const Vec3f& center, const float radius) const
+{
+	if( !isValid() )
+		return 0.f;
+
+	const float perPixel = worldPerPixel(center);
+	if( perPixel <= pixelSize * radius )
+		return 2.f * radius / pixelSize;
+	return 2.f * radius / perPixel;
+}
+
+
+/* ==================================================================
+ * LevelOfDetail class
+ * ==================================================================
+ */
+const float LevelOfDetail::defaultHysteresis = 0.2f;
+
+LevelOfDetail::LevelOfDetail(const float highPixels, const float mediumPixels, const float hysteresis)
+	: highPixels(highPixels)
+	, mediumPixels(mediumPixels)
+	, hysteresis(hysteresis)
+{ }
+
+/* levelFor() - Level for 'pixels' ignoring the hysteresis ------- */
+DetailLevel LevelOfDetail::levelFor(const float pixels) const
+{
+	if( pixels >= highPixels )   return detailHigh;
+	if( pixels >= mediumPixels ) return detailMedium;
+	return detailLow;
+}
+
+/* select() - Gets the level for something 'pixels' across that -- */
+/* was drawn at 'current' last frame ----------------------------- */
+DetailLevel LevelOfDetail::select(const float pixels, const DetailLevel current) const
+{
+	// Only more detail if it's well over the threshold...
+	const DetailLevel finer = levelFor(pixels / (1.f + hysteresis));
+	if( finer < current )
+		return finer;
+
+	// ...and only less if it's well under
+	const DetailLevel coarser = levelFor(pixels / (1.f - hysteresis));
+	if( coarser > current )
+		return coarser;
+
+	return current;
+}
@@ -11,6 +11,8 @@
 
 #include "MathUtils.h"
 #include "GLUtils.h"
+#include "Profiler.h"
+#include "AllocationCounter.h"
 
 #include "TrainFiles/Utilities/ArcBallCam.H"
 #include "TrainFiles/Utilities/3DUtils.h"
@@ -33,6 +35,8 @@
 
 #include <iostream>
 #include <cassert>
+#include <cmath>
+#include <cstdio>
 #include <sstream>
 #include <string>
 #include <vector>
@@ -54,19 +58,70 @@ string ViewTypeNames[] = { "Arcball", "Train", "Overhead" };
 MainView::MainView(int x, int y, int w, int h, const char *l)
 	: Fl_Gl_Window(x,y,w,h,l)
 	, arcballCam()
+	, modelviewMatrix()
+	, projectionMatrix()
+	, projection()
+	, frustum()
+	, trainDetail(detailHigh)
 	, selectedPoint(-1)
+	, viewportWidth(0)
+	, viewportHeight(0)
+	, frameArena()
+	, frameNumber(0)
+	, allocatingFrames(0)
 	, viewType(arcball)
 {
 	mode( FL_RGB | FL_ALPHA | FL_DEPTH | FL_DOUBLE );
 	resetArcball();
+
+	viewport[0] = viewport[1] = viewport[2] = viewport[3] = 0;
+
+	for(int i = 0; i < numSceneryObjects; ++i)
+		sceneryDetail[i] = detailHigh;
 }
 
 /* draw() - Draws to the screen ---------------------------------- */
 void MainView::draw()
 {
-	float t = window->getRotation();
+	const long allocations = numAllocations();
+
+	window->readTrainPose(trainPose);
+	const float t = trainPose.t;
 
 	updateTextWidget(t);
+	drawScene(t);
+	updateProfileWidget();
+
+	checkFrameAllocations(numAllocations() - allocations);
+	frameArena.reset();
+}
+
+/* renderOffscreen() - Draws the scene from the specified view into */
+/* whatever framebuffer is current, at the specified size, with --- */
+/* the train at 't' ---------------------------------------------- */
+void MainView::renderOffscreen(ViewType type, int width, int height, const float t)
+{
+	const ViewType oldViewType = viewType;
+
+	viewType       = type;
+	viewportWidth  = width;
+	viewportHeight = height;
+
+	trainPose = window->trainPoseAt(t);
+
+	const long allocations = numAllocations();
+	drawScene(trainPose.t);
+	checkFrameAllocations(numAllocations() - allocations);
+	frameArena.reset();
+
+	viewportWidth  = 0;
+	viewportHeight = 0;
+	viewType       = oldViewType;
+}
+
+/* drawScene() - Draws the track, train and scenery at 't' ------- */
+void MainView::drawScene(const float t)
+{
 	openglFrameSetup();
 
 	// Draw everything once without shadows
@@ -76,13 +131,15 @@ void MainView::draw()
 	else
 	{
 		drawCurve(t, true, false);
-		drawTrain(t);
+		drawTrain(trainPose);
 		drawSelectedControlPoint(false);
 	}
 
 	// Draw everything again with shadows if they are enabled
 	if( window->isShadowed() && viewType != overhead )
 	{
+		ScopedTimer timer(stageShadows);
+
 		glPushMatrix();
 			// Translate down to the ground plane
 			glTranslatef(0.f, -20.f, 0.f);
@@ -95,7 +152,7 @@ void MainView::draw()
 			else
 			{
 				drawCurve(t, true, true);
-				drawTrain(t, true);
+				drawTrain(trainPose, true);
 				drawSelectedControlPoint(true);
 			}
 
@@ -123,11 +180,15 @@ int MainView::handle(int event)
 		if( lastPush == 1 )
 		{
 			pick();
+			// A whole drag is undone in one step
+			window->getHistory().beginStep();
 			damage(1);
 			return 1;
 		}
 		break;
 	case FL_RELEASE:
+		if( lastPush == 1 )
+			window->getHistory().endStep();
 		damage(1);
 		lastPush = 0;
 		return 1;
@@ -135,10 +196,11 @@ int MainView::handle(int event)
 		if ( lastPush == 1 && selectedPoint >=0 && viewType != train )
 		{
 			try {
-				CtrlPoint& cp = window->getPoints().at(selectedPoint);
+				const CtrlPoint& cp = window->getPoints().at(selectedPoint);
 
 				double r1x, r1y, r1z, r2x, r2y, r2z;
-				getMouseLine(r1x,r1y,r1z, r2x,r2y,r2z);
+				getMouseLine(modelviewMatrix, projectionMatrix, viewport,
+							 r1x,r1y,r1z, r2x,r2y,r2z);
 
 				double rx, ry, rz;
 				mousePoleGo(r1x,r1y,r1z, r2x,r2y,r2z,
@@ -148,17 +210,26 @@ int MainView::handle(int event)
 					rx, ry, rz,
 					(Fl::event_state() & FL_CTRL) != 0);
 
-				cp.pos().x(static_cast<float>(rx));
-				cp.pos().y(static_cast<float>(ry));
-				cp.pos().z(static_cast<float>(rz));
-
-				window->getCurve().regenerateSegments();
+				// Only the segments around the dragged point are rebuilt
+				window->getCurve().moveControlPoint(selectedPoint,
+					Vec3f(static_cast<float>(rx), static_cast<float>(ry), static_cast<float>(rz)));
 
 				damage(1);
 			} catch(std::out_of_range&) {}
 		}
 		break;
 	case FL_FOCUS:
+	case FL_UNFOCUS:
+	case FL_LEAVE:
+		// A drag's release can go to another window, so end its undo
+		// step once the button is up or the window has lost focus
+		if( lastPush == 1 && (event == FL_UNFOCUS || Fl::event_buttons() == 0) )
+		{
+			window->getHistory().closeSteps();
+			lastPush = 0;
+		}
+		if( event == FL_LEAVE )
+			break;
 		return 1;
 	case FL_ENTER: // take focus anytime mouse enters window
 		focus(this);
@@ -183,56 +254,63 @@ int MainView::handle(int event)
 			viewType = overhead;
 			window->setViewType(2);
 		}
+		if( (ks & FL_CTRL) && k == 'z' )
+		{
+			window->undo();
+			return 1;
+		}
+		if( (ks & FL_CTRL) && k == 'y' )
+		{
+			window->redo();
+			return 1;
+		}
 		break;
 	}
 
 	return Fl_Gl_Window::handle(event);
 }
 
-/* pick() - Performs OpenGL picking ------------------------------ */
+/* pick() - Picks the control point under the mouse ------------- */
+/* Each point is tested as the sphere around its cube against a -- */
+/* 5x5 pixel box at the mouse, on the CPU, and the closest hit wins */
 void MainView::pick()
 {
+	static const float pickSize    = 5.f;           // pixels
+	static const float pointRadius = 2.f * 1.732f;  // around CtrlPoint's cube
+
 	// Don't pick if in train view
 	if( viewType == train )
 		return;
 
-	// Make sure we're current so we can use OpenGL
-	make_current();
+	ScopedTimer timer(stagePick);
 
-	// Get the mouse position
-	int mx = Fl::event_x();
-	int my = Fl::event_y();
+	updateCamera();
 
-	// Get the viewport
-	int viewport[4];
-	glGetIntegerv(GL_VIEWPORT, viewport);
+	// Get the mouse position, with y up like the viewport
+	const float mx = static_cast<float>(Fl::event_x());
+	const float my = static_cast<float>(viewport[3] - Fl::event_y());
 
-	// Setup the pick matrix on the stack
-	glMatrixMode(GL_PROJECTION);
-	glLoadIdentity();
-	gluPickMatrix((double)mx, (double)(viewport[3] - my), 5, 5, viewport);
+	selectedPoint = -1;
+	float nearest = 1.f;
 
-	setupProjection();
+	const ControlPointVector& points = window->getPoints();
+	for(size_t i = 0; i < points.size(); ++i)
+	{
+		const Vec3f& center(points[i].pos());
 
-	// Draw objects (but only what has been 'hit')
-	GLuint buf[100];
-	glSelectBuffer(100, buf);
-	glRenderMode(GL_SELECT);
-	glInitNames();
-	glPushName(0);
+		Vec3f onScreen;
+		if( !project(center, modelviewMatrix, projectionMatrix, viewport, onScreen)
+		 || onScreen.z() < 0.f || onScreen.z() > nearest )
+			continue;
 
-	ControlPointVectorConstIter it  = window->getPoints().begin();
-	ControlPointVectorConstIter end = window->getPoints().end();
-	for(int i = 0; it != end; ++it, ++i)
-	{
-		glLoadName((GLuint)(i + 1));
-		it->draw(false); //dont draw shadows for the hit object, let mainView->Draw() do that
+		const float reach = 0.5f * pickSize + pointRadius / projection.worldPerPixel(center);
+		if( std::fabs(onScreen.x() - mx) <= reach && std::fabs(onScreen.y() - my) <= reach )
+		{
+			selectedPoint = static_cast<int>(i);
+			nearest = onScreen.z();
+		}
 	}
 
-	// See how picking did back in drawing mode
-	int hits = glRenderMode(GL_RENDER);
-	selectedPoint = hits ? buf[3] - 1 : -1;
-
 	if( selectedPoint != -1 )
 	{
 		try {
@@ -255,86 +333,124 @@ void MainView::resetArcball()
 	arcballCam.setup(this, 40.f, 250.f, 0.2f, 0.4f, 0.f);
 }
 
-/* setupProject() - Sets up projection & modelview matrices ------ */
-void MainView::setupProjection()
+/* updateCamera() - Builds the camera matrices for the view ----- */
+void MainView::updateCamera()
 {
-	const float aspect = static_cast<float>(w()) / static_cast<float>(h());
+	const float aspect = static_cast<float>(viewWidth()) / static_cast<float>(viewHeight());
 	const float width  = (aspect >= 1) ? 110 : 110 * aspect;
 	const float height = (aspect >= 1) ? 110 / aspect : 110;
 
 	switch(viewType)
 	{
-		case arcball: arcballCam.setProjection(false); break;
+		case arcball:
+			projectionMatrix = arcballCam.getProjection(aspect);
+			modelviewMatrix  = arcballCam.getModelview();
+		break;
 		case train:
 		{
-			glMatrixMode(GL_PROJECTION);
-			glLoadIdentity(); // No picking in train view
-			gluPerspective(65.0, aspect, 0.1, 1000.0);
-
-			glMatrixMode(GL_MODELVIEW);
-			glLoadIdentity();
-
-			Curve& curve(window->getCurve());
-			const float t = window->getRotation();
-
-			// Calculate the orientation matrix values
-			const Vec3f& p(-1.f * curve.getPosition(t));
-			const Vec3f& d(-1.f * curve.getDirection(t));
-			const Vec3f& tangent(normalize(d));
-
-			Vec3f normal;
-			if( curve.getCurveType() != lines )
-				normal = curve.getOrientation(t);
-			else // lines shouldn't interpolate orientation
-				normal = curve.getSegment(curve.selectedSegment)->getStartPoint().orient();
-
-			const Vec3f binormal(normalize(cross(normal, tangent)));
-			normal = normalize(cross(tangent, binormal));
-
-			// Apply the orientation matrix
-			const Vec3f& z(tangent), y(normal), x(binormal);
-			// Note: matrix is transpose of typical orientation
-			GLfloat m[] = {
-				x.x(), y.x(), z.x(), 0.f,
-				x.y(), y.y(), z.y(), 0.f,
-				x.z(), y.z(), z.z(), 0.f,
-				0.f,   0.f,   0.f,   1.f
-			};
-			glMultMatrixf(m);
-
-			// Move to the correct position, offset on y to be on top of track
-			glTranslatef(p.x(), p.y() - 3.f * y.y(), p.z());
+			// The camera looks back along the train, so flip its frame
+			const Vec3f p(-1.f * trainPose.position);
+			const Vec3f z(-1.f * trainPose.tangent);
+			const Vec3f x(-1.f * trainPose.binormal);
+			const Vec3f& y(trainPose.normal);
+
+			projectionMatrix = Mat4::perspective(65.f, aspect, 0.1f, 1000.f);
+
+			// Orient, then move to the correct position, offset on y to be on top of track
+			modelviewMatrix = Mat4::fromRows(x, y, z)
+							* Mat4::translation(Vec3f(p.x(), p.y() - 3.f * y.y(), p.z()));
 		}
 		break;
 		case overhead:
-		{
-			glMatrixMode(GL_PROJECTION);
-			// Note: no glLoadIdentity() here, caller clears projection (for picking)
-			glOrtho(-width, width, -height, height, 200, -200);
-
-			glMatrixMode(GL_MODELVIEW);
-			glLoadIdentity();
-			glRotatef(-90.f, 1.f, 0.f, 0.f);
-		}
+			projectionMatrix = Mat4::ortho(-width, width, -height, height, 200.f, -200.f);
+			modelviewMatrix  = Mat4::rotation(-90.f, Vec3f(1.f, 0.f, 0.f));
 		break;
 	};
 
-	glViewport(0, 0, w(), h());
+	viewport[0] = 0;
+	viewport[1] = 0;
+	viewport[2] = viewWidth();
+	viewport[3] = viewHeight();
+
+	projection = ScreenProjection(modelviewMatrix.data(), projectionMatrix.data(), viewport[3]);
+	frustum    = Frustum(modelviewMatrix.data(), projectionMatrix.data());
+}
+
+/* setupProject() - Sets up projection & modelview matrices ------ */
+void MainView::setupProjection()
+{
+	updateCamera();
+
+	glMatrixMode(GL_PROJECTION);
+	glLoadMatrixf(projectionMatrix.data());
+
+	glMatrixMode(GL_MODELVIEW);
+	glLoadMatrixf(modelviewMatrix.data());
+
+	glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
 }
 
 /* updateTextWidget() - Prints rotation amount to text widget ---- */
 void MainView::updateTextWidget( const float t )
 {
-	stringstream ss, ss1;
-	ss  << "t = " << t;
-	ss1 << "s = " << (window->isArcLengthParam ? window->arcLengthStep() : 0.f);
+	static const size_t size = 32;
+
+	char *text  = frameArena.allocate<char>(size);
+	char *text1 = frameArena.allocate<char>(size);
+	sprintf_s(text,  size, "t = %g", t);
+	sprintf_s(text1, size, "s = %g", (window->isArcLengthParam ? window->arcLengthStep() : 0.f));
+
+	window->setDebugText(text, text1);
+}
+
+/* updateProfileWidget() - Prints per-stage frame timings to the side panel */
+void MainView::updateProfileWidget()
+{
+	static const size_t lineSize = 48;
+	static const size_t size     = lineSize * (numProfileStages + 1);
+
+	Profiler& profiler = Profiler::get();
+	profiler.summarizeFrame();
+
+	char  *text   = frameArena.allocate<char>(size);
+	size_t length = 0;
+	text[0] = '\0';
+	for(int i = 0; i < numProfileStages; ++i)
+	{
+		const ProfileStage stage = static_cast<ProfileStage>(i);
+		length += sprintf_s(text + length, size - length, "%.2f ms  %s\n",
+							profiler.getStageMs(stage), ProfileStageNames[stage].c_str());
+	}
+
+	const Curve& curve(window->getCurve());
+	sprintf_s(text + length, size - length, "%d drawn, %d culled segments\n",
+			  curve.getNumDrawnSegments(), curve.getNumCulledSegments());
+
+	window->setProfileText(text);
+}
+
+/* checkFrameAllocations() - Reports frames that touched the heap, */
+/* only active in TRACK_ALLOCATIONS builds, the first few frames are */
+/* allowed to allocate while buffers settle to their steady-state size */
+void MainView::checkFrameAllocations( const long allocations )
+{
+#ifdef TRACK_ALLOCATIONS
+	static const int warmupFrames = 10;
 
-	window->setDebugText(ss.str(), ss1.str());
+	if( ++frameNumber > warmupFrames && allocations > 0 )
+	{
+		++allocatingFrames;
+		cout << "Warning: frame " << frameNumber << " made "
+			 << allocations << " heap allocations" << endl;
+	}
+#endif
 }
 
 /* openglFrameSetup() - Clears framebuffers and sets projection -- */
 void MainView::openglFrameSetup()
 {
+	ScopedTimer timer(stageFrameSetup);
+
 	glClearColor(0.f, 0.f, 0.2f, 1.f);
 	glClearStencil(0);
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
@@ -342,8 +458,6 @@ void MainView::openglFrameSetup()
 
 	glColorMaterial(GL_FRONT_AND_BACK, GL_AMBIENT_AND_DIFFUSE);
 
-	glMatrixMode(GL_PROJECTION);
-	glLoadIdentity();
 	setupProjection();
 	// TODO: call these once only, not every frame
 
@@ -394,9 +508,36 @@ void MainView::openglFrameSetup()
 	glLightfv(GL_LIGHT2, GL_DIFFUSE, yellowLight);
 }
 
+/* selectDetail() - Picks the detail to draw something 'radius' - */
+/* big at 'center' with, given it was drawn at 'current' last time */
+DetailLevel MainView::selectDetail(const LevelOfDetail& lod, const Vec3f& center, const float radius,
+								   DetailLevel& current)
+{
+	if( !window->isLevelOfDetail() || !projection.isValid() )
+		current = detailHigh;
+	else
+		current = lod.select(projection.pixelsAcross(center, radius), current);
+	return current;
+}
+
+// Pixels across an object needs to be to draw it in high or medium detail
+static const LevelOfDetail sceneryDetailLevels(150.f, 40.f);
+static const LevelOfDetail trainDetailLevels(40.f, 6.f);
+
 /* drawScenery() - Draws the floor plane and assorted scenery ------ */
 void MainView::drawScenery(bool doShadows)
 {
+	ScopedTimer timer(stageScenery);
+
+	static const int sphereSlices[numDetailLevels] = { 20, 10, 6 };
+	static const int sphereStacks[numDetailLevels] = { 20,  8, 4 };
+	static const int coneSlices  [numDetailLevels] = { 10,  8, 5 };
+	static const int coneStacks  [numDetailLevels] = { 10,  2, 1 };
+
+	const DetailLevel sphere = selectDetail(sceneryDetailLevels, Vec3f(-50.f, -10.f,  50.f), 10.f, sceneryDetail[scenerySphere]);
+	const DetailLevel teapot = selectDetail(sceneryDetailLevels, Vec3f(-50.f, -14.f, -50.f), 12.f, sceneryDetail[sceneryTeapot]);
+	const DetailLevel cone   = selectDetail(sceneryDetailLevels, Vec3f( 50.f,  -5.f,  50.f), 12.f, sceneryDetail[sceneryCone]);
+
 	if( !doShadows ) glDisable(GL_BLEND);
 
 	if( !doShadows )
@@ -428,14 +569,21 @@ void MainView::drawScenery(bool doShadows)
 			if( !doShadows ) glColor4ub(0, 0, 255, 255);
 			glTranslatef(-50.f, 10.f, 50.f);
 			glRotatef(-90.f, 1.f, 0.f, 0.f);
-			glutSolidSphere(10.f, 20, 20);
+			glutSolidSphere(10.f, sphereSlices[sphere], sphereStacks[sphere]);
 		glPopMatrix();
 
 		glPushMatrix();
 			if( !doShadows ) glColor4ub(200, 50, 200, 255);
 			glTranslatef(-50.f, 6.f, -50.f);
 			glRotatef(-45.f, 0.f, 1.f, 0.f);
-			glutSolidTeapot(8.f);
+			if( teapot == detailHigh )
+				glutSolidTeapot(8.f);
+			else
+			{
+				// Far enough away that its squashed body will do
+				glScalef(1.f, 0.75f, 1.f);
+				glutSolidSphere(8.f, sphereSlices[teapot], sphereStacks[teapot]);
+			}
 		glPopMatrix();
 
 		glLineWidth(5.f);
@@ -445,7 +593,7 @@ void MainView::drawScenery(bool doShadows)
 			glPushMatrix();
 				glTranslatef(50.f, 5.f, 50.f);
 				glRotatef(-90.f, 1.f, 0.f, 0.f);
-				glutSolidCone(10.f, 20.f, 10, 10);
+				glutSolidCone(10.f, 20.f, coneSlices[cone], coneStacks[cone]);
 			glPopMatrix();
 
 			if( !doShadows ) glColor4ub(139, 69, 19, 255);
@@ -470,40 +618,83 @@ void MainView::drawScenery(bool doShadows)
 /* drawCurve() - Draws the window's curve object ----------------- */
 void MainView::drawCurve(const float t, bool drawPoints, bool doShadows)
 {
+	ScopedTimer timer(stageCurve);
+
 	Curve& curve(window->getCurve());
 	curve.selectedSegment = static_cast<int>(std::floor(t));
 
+	// The shadow pass reuses the samples picked for the lit pass
+	if( !doShadows )
+	{
+		Tessellation tessellation(curve.getTessellation());
+		tessellation.levelOfDetail = window->isLevelOfDetail();
+		tessellation.view          = projection;
+		curve.setTessellation(tessellation);
+		curve.setFrustum(frustum);
+	}
+
 	curve.draw(drawPoints, doShadows);
 
+	if( !doShadows && window->isCheckingClearance() )
+		drawClearance();
+
 	if(window->isHighlightedSegPts())
 	{
 		curve.drawSelectedSegment(drawPoints, doShadows);
 	}
 }
 
-/* drawTrain() - Draws the train at the specified parameter ------ */
-void MainView::drawTrain( const float t, bool doingShadows )
+/* drawClearance() - Marks where the track is too close to itself, */
+/* in red where it crosses and orange where it only comes close --- */
+void MainView::drawClearance()
 {
-	Curve& curve = window->getCurve();
+	const vector<ClearanceViolation>& violations = window->getClearance().getViolations();
+	if( violations.empty() )
+		return;
+
+	glDisable(GL_LIGHTING);
+	glLineWidth(3.f);
+	glPointSize(8.f);
+
+	glBegin(GL_LINES);
+		for each(const auto& v in violations)
+		{
+			if( v.intersecting ) glColor4ub(255,   0, 0, 255);
+			else                 glColor4ub(255, 140, 0, 255);
+			glVertex3fv(v.pointA.v());
+			glVertex3fv(v.pointB.v());
+		}
+	glEnd();
+
+	glBegin(GL_POINTS);
+		for each(const auto& v in violations)
+		{
+			if( v.intersecting ) glColor4ub(255,   0, 0, 255);
+			else                 glColor4ub(255, 140, 0, 255);
+			glVertex3fv(v.pointA.v());
+			glVertex3fv(v.pointB.v());
+		}
+	glEnd();
+
+	glPointSize(1.f);
+	glLineWidth(1.f);
+	glEnable(GL_LIGHTING);
+}
 
-	// Calculate the orientation matrix values 
-	const Vec3f& p(curve.getPosition(t));
-	const Vec3f& d(curve.getDirection(t));
-	const Vec3f& tangent(normalize(d));
+/* drawTrain() - Draws the train at the specified pose ----------- */
+void MainView::drawTrain( const TrainPose& pose, bool doingShadows )
+{
+	ScopedTimer timer(stageTrain);
 
-	Vec3f normal;
-	if( curve.getCurveType() != lines )
-		normal = curve.getOrientation(t);
-	else // lines shouldn't interpolate orientation
-		normal = curve.getSegment(curve.selectedSegment)->getStartPoint().pos();
+	if( !pose.valid )
+		return;
 
-	const Vec3f binormal(normalize(cross(normal, tangent)));
-	normal = normalize(cross(tangent, binormal));
+	const Vec3f& p(pose.position);
 
 	glPushMatrix();
 
 	// Apply the orientation + translation matrix
-	const Vec3f& z(tangent), y(normal), x(binormal);
+	const Vec3f& z(pose.tangent), y(pose.normal), x(pose.binormal);
 	GLfloat m[] = {
 		x.x(), x.y(), x.z(), 0.f,
 		y.x(), y.y(), y.z(), 0.f,
@@ -516,6 +707,17 @@ void MainView::drawTrain( const float t, bool doingShadows )
 
 	if(!doingShadows) glColor3d(0.3, 0.5, 1.0);
 
+	const DetailLevel detail = selectDetail(trainDetailLevels, p, 8.f, trainDetail);
+	if( detail == detailLow )
+	{
+		// A few pixels across, a box the size of the body will do
+		glTranslatef(1.f, 3.5f, 0.f);
+		glScalef(14.f, 5.f, 5.f);
+		glutSolidCube(1.f);
+		glPopMatrix();
+		return;
+	}
+
 	// inside face
 	glBegin(GL_POLYGON);
 		glNormal3d(0.0, 0.0, 1.0);
@@ -591,7 +793,13 @@ void MainView::drawTrain( const float t, bool doingShadows )
 		glVertex3f( 3.f, 6.f,   2.5f);
 	glEnd();
 
-	// wheels
+	// wheels, too small to see in medium detail
+	if( detail != detailHigh )
+	{
+		glPopMatrix();
+		return;
+	}
+
 	if(!doingShadows) glColor3d(0.0, 0.0, 0.0);
 
 	glTranslatef(5.f, 0.f, 2.55f);
@@ -644,7 +852,7 @@ void MainView::drawTrain( const float t, bool doingShadows )
 /* drawSelectedControlPoint() - Draws the selected point highlighted */
 void MainView::drawSelectedControlPoint(bool doShadows)
 {
-	auto points = window->getPoints();
+	const ControlPointVector& points = window->getPoints();
 	if( selectedPoint >= 0 && selectedPoint < (signed)points.size() )
 	{
 		if( !doShadows ) glColor4ub(250, 20, 20, 255);
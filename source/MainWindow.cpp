@@ -13,6 +13,10 @@
 #include "Curve.h"
 #include "Callback.h"
 #include "MathUtils.h"
+#include "Profiler.h"
+#include "TrackFile.h"
+#include "TrackParser.h"
+#include "MeshExporter.h"
 
 #pragma warning(push)
 #pragma warning(disable:4312)
@@ -25,24 +29,26 @@
 #include <Fl/Fl_Group.h>
 #include <Fl/Fl_Button.h>
 #include <Fl/Fl_Output.h>
+#include <Fl/Fl_Multiline_Output.h>
 #include <Fl/Fl_Choice.h>
 #include <Fl/Fl_Slider.h>
 #include <Fl/Fl_Value_Slider.h>
+#include <Fl/Fl_Progress.h>
 #include <Fl/Fl_ask.h>
 #pragma warning(pop)
 
 #include <iostream>
-#include <fstream>
 #include <cassert>
+#include <cstring>
 #include <sstream>
 #include <string>
 #include <vector>
 
-using std::ifstream;
-using std::ofstream;
 using std::stringstream;
 using std::string;
 using std::vector;
+using std::cout;
+using std::cerr;
 using std::endl;
 
 
@@ -74,35 +80,67 @@ MainWindow::MainWindow(const int x, const int y)
 	, pointResetButton(nullptr)
 	, pointPitchMoreButton(nullptr)
 	, pointRollMoreButton (nullptr)
+	, undoButton      (nullptr)
+	, redoButton      (nullptr)
 	, tensionSlider   (nullptr)
+	, profileOutput   (nullptr)
+	, saveTraceButton (nullptr)
+	, exportMeshButton(nullptr)
+	, lodButton       (nullptr)
+	, clearanceButton (nullptr)
+	, clearanceOutput (nullptr)
+	, trackIOProgress (nullptr)
 	, curve           (cardinal)
+	, trackIO         ()
+	, journal         ()
+	, journalMark     (0)
+	, compacting      (false)
+	, history         ()
+	, clearance       ()
+	, checkingClearance(false)
+	, clearanceRevision(0)
 	, animating       (false)
 	, isArcLengthParam(true)
 	, highlightSegPts (false)
 	, shadows         (true)
+	, levelOfDetail   (true)
+	, batchMode       (false)
 	, speed           (2.f)
 	, rotation        (0.f)
 	, rotationStep    (0.01f)
+	, simulation      ()
 {
 	createWidgets();
 	resetPoints();
 
+	// The default points are as far back as undo goes
+	history.reset(curve);
+	curve.setHistory(&history);
+
 	Fl::add_idle(idleCallback, this); 
 }
 
+/* setOutputText() - Sets an output widget's text, if it changed - */
+static void setOutputText( Fl_Output *output, const char *text )
+{
+	assert(output != nullptr && text != nullptr);
+	if( strcmp(output->value(), text) != 0 )
+		output->value(text);
+}
+
 /* setDebugText() - Called to update fltk multiline output text -- */
-void MainWindow::setDebugText( const string& text, const string& text1 )
+void MainWindow::setDebugText( const char *text, const char *text1 )
 {
-	assert(textOutput != nullptr);
-	textOutput->value("");
-	textOutput->value(text.c_str());
+	setOutputText(textOutput, text);
 
-	if( !text1.empty() )
-	{
-		assert(textOutput1 != nullptr);
-		textOutput1->value("");
-		textOutput1->value(text1.c_str());
-	}
+	if( text1 != nullptr && text1[0] != '\0' )
+		setOutputText(textOutput1, text1);
+}
+
+/* setProfileText() - Called to update the frame profiler output -- */
+void MainWindow::setProfileText( const char *text )
+{
+	setOutputText(profileOutput, text);
 }
 
 /* createWidgets() - Called on construction to build fltk widgets  */
@@ -252,6 +290,17 @@ void MainWindow::createWidgets()
 		pointRollLessButton->selection_color((Fl_Color)3);
 		pointRollLessButton->callback((Fl_Callback*)pointRollLessButtonCallback, this);
 
+		// Create undo and redo buttons (also Ctrl+Z and Ctrl+Y)
+		undoButton = new Fl_Button(690, 205, 50, 20, "Undo");
+		undoButton->type(FL_NORMAL_BUTTON);
+		undoButton->selection_color((Fl_Color)3);
+		undoButton->callback((Fl_Callback*)undoButtonCallback, this);
+
+		redoButton = new Fl_Button(745, 205, 50, 20, "Redo");
+		redoButton->type(FL_NORMAL_BUTTON);
+		redoButton->selection_color((Fl_Color)3);
+		redoButton->callback((Fl_Callback*)redoButtonCallback, this);
+
 		// Create a phantom widget to help resize things
 		Fl_Box *resizeBox = new Fl_Box(5, 5, 590, 590);
 		widgets->resizable(resizeBox);
@@ -264,6 +313,46 @@ void MainWindow::createWidgets()
 		tensionSlider->type(FL_HORIZONTAL);
 		tensionSlider->callback((Fl_Callback*)tensionSliderCallback, this);
 
+		// Create a text display for the per-stage frame timings
+		profileOutput = new Fl_Multiline_Output(605, 305, 185, 120);
+		profileOutput->textsize(11);
+
+		// Create a button to save the recorded timings as a chrome trace
+		saveTraceButton = new Fl_Button(605, 430, 90, 20, "Save Trace");
+		saveTraceButton->type(FL_NORMAL_BUTTON);
+		saveTraceButton->selection_color((Fl_Color)3);
+		saveTraceButton->callback((Fl_Callback*)saveTraceButtonCallback, this);
+
+		// Create a button to export the track as a triangle mesh
+		exportMeshButton = new Fl_Button(605, 455, 90, 20, "Export Mesh");
+		exportMeshButton->type(FL_NORMAL_BUTTON);
+		exportMeshButton->selection_color((Fl_Color)3);
+		exportMeshButton->callback((Fl_Callback*)exportMeshButtonCallback, this);
+
+		// Create a button to draw things with less detail as they get smaller on screen
+		lodButton = new Fl_Button(700, 455, 90, 20, "LOD");
+		lodButton->type(FL_TOGGLE_BUTTON);
+		lodButton->value(1);
+		lodButton->selection_color((Fl_Color)3); // yellow when pressed
+		lodButton->callback((Fl_Callback*)lodButtonCallback, this);
+
+		// Create a button to check where the track passes too close to itself
+		clearanceButton = new Fl_Button(605, 480, 90, 20, "Clearance");
+		clearanceButton->type(FL_TOGGLE_BUTTON);
+		clearanceButton->value(0);
+		clearanceButton->selection_color((Fl_Color)3); // yellow when pressed
+		clearanceButton->callback((Fl_Callback*)clearanceButtonCallback, this);
+
+		clearanceOutput = new Fl_Output(700, 480, 90, 20);
+
+		// Create a progress bar for background loads and saves, hidden until one runs
+		trackIOProgress = new Fl_Progress(700, 430, 90, 20);
+		trackIOProgress->minimum(0.f);
+		trackIOProgress->maximum(1.f);
+		trackIOProgress->selection_color((Fl_Color)3);
+		trackIOProgress->labelsize(11);
+		trackIOProgress->hide();
+
 		widgets->end();
 	}
 	end();
@@ -272,6 +361,10 @@ void MainWindow::createWidgets()
 /* resetPoints() - Called to reset control points to a standard configuration */
 void MainWindow::resetPoints()
 {
+	// The default points don't come from a file, so there's nothing to journal
+	closeJournal();
+
+	curve.beginEdit();
 	curve.clearPoints();
 
 	const float step = TWO_PI / 5.f;
@@ -283,93 +376,475 @@ void MainWindow::resetPoints()
 		curve.addControlPoint(point);
 	}
 
-	curve.regenerateSegments();
+	curve.commitEdit();
+	history.recordReplace(curve);
 }
 
-/* loadPoints() - Loads control points from a text file ---------- */
-void MainWindow::loadPoints(const string& filename)
+/* loadPoints() - Loads control points from a text file, false if - */
+/* it couldn't be read and the default points were used instead, -- */
+/* or in batch mode, with the curve left as it was ---------------- */
+bool MainWindow::loadPoints(const string& filename)
 {
-	/* File Format:
+	ScopedTimer timer(stageFileLoad);
+
+	closeJournal();
+
+	if( isBinaryTrackFile(filename) )
+		return loadBinaryPoints(filename);
+
+	/* File Format: (see TrackParser.h)
 	 * ------------
-	 * [1]   - number of control points (integer)
-	 * [2..] - control point position and orientation
-	 *         (3 floats each, separated by spaces)
+	 * [1]   - number of control points (integer, optional)
+	 * [2..] - control point position and optionally orientation
+	 *         (3 or 6 floats, separated by spaces, # comments)
 	 */
-	ifstream file(filename);
-	if( file.is_open() )
-	{
-		// Get the number of points but don't worry about validating it,
-		// since its not used and could be a lie anyways...
-		int numPoints = 0;
-		file >> numPoints;
-
-		// Get the points
-		curve.clearPoints();
-		float px, py, pz;	// position
-		float ox, oy, oz;	// orientation
-		while( file >> px >> py >> pz >> ox >> oy >> oz )
+	try {
+		// Large files are parsed in parallel, either way the curve
+		// is only regenerated once all the points are in
+		ControlPointVector points;
+		readTextTrackFile(filename, points);
+		curve.swapPoints(points);
+		history.reset(curve);
+		return true;
+	} catch(TrackParseError& e) {
+		if( batchMode )
 		{
-			const Vec3f position(px, py, pz);
-			const Vec3f orientation(ox, oy, oz);
-			curve.addControlPoint(CtrlPoint(position, orientation));
+			reportError(e.what());
+			return false;
 		}
+		stringstream ss;
+		ss << e.what() << endl
+		   << "Using default control points instead." << endl;
+		fl_alert("%s", ss.str().c_str());
+		resetPoints();
+		return false;
 	}
-	else // file didn't open...
-	{
+}
+
+/* loadBinaryPoints() - Loads control points from a binary track file */
+bool MainWindow::loadBinaryPoints(const string& filename)
+{
+	try {
+		MappedTrack track(filename);
+		ControlPointVector points;
+		track.copyTo(points);
+
+		curve.beginEdit();
+		curve.swapPoints(points);
+		if( track.hasCurveSettings() )
+			setCurveSettings(track.curveType(), track.tension());
+		curve.commitEdit();
+		history.reset(curve);
+		return true;
+	} catch(TrackFileError& e) {
+		if( batchMode )
+		{
+			reportError(e.what());
+			return false;
+		}
 		stringstream ss;
-		ss << "Error - failed to open file: " << filename << endl
-			<< "Using default control points instead." << endl;
-		fl_alert(ss.str().c_str());
+		ss << e.what() << endl
+		   << "Using default control points instead." << endl;
+		fl_alert("%s", ss.str().c_str());
 		resetPoints();
+		return false;
 	}
 }
 
-/* savePoints() - Saves the control points to a text file -------- */
-void MainWindow::savePoints(const string& filename)
+/* setCurveSettings() - Sets the curve type and tension, and the widgets showing them */
+void MainWindow::setCurveSettings(const CurveType type, const float tension)
 {
-	ofstream file(filename);
-	if( file.is_open() )
+	curve.setCurveType(type);
+	curve.tension = tension;
+
+	curveTypeChoice->value(type);
+	tensionSlider->value(tension);
+}
+
+/* savePoints() - Saves the control points to a text file, -------- */
+/* or to a binary track file (with the curve settings) if 'filename' */
+/* ends in .trk, or a compressed one if it ends in .trz. False if -- */
+/* it couldn't be written ------------------------------------------ */
+bool MainWindow::savePoints(const string& filename)
+{
+	try {
+		if( hasBinaryTrackExtension(filename) )
+			writeBinaryTrackFile(filename, curve, hasCompressedTrackExtension(filename));
+		else
+			writeTextTrackFile(filename, curve.getControlPoints());
+		return true;
+	} catch(TrackFileError& e) {
+		reportError(e.what());
+		return false;
+	}
+}
+
+/* exportMesh() - Writes the track's rails, ties and optionally the */
+/* train path as a triangle mesh, binary if 'filename' ends in .trm */
+void MainWindow::exportMesh(const string& filename, const bool includePath)
+{
+	try {
+		MeshExporter exporter(curve);
+		exporter.exportMesh(filename, includePath);
+
+		cout << "Exported " << exporter.getNumTriangles() << " triangles to " << filename << endl;
+	} catch(TrackFileError& e) {
+		reportError(e.what());
+	}
+}
+
+/* toggleClearance() - Turns the live clearance check on or off -- */
+void MainWindow::toggleClearance()
+{
+	checkingClearance = !checkingClearance;
+	if( checkingClearance )
 	{
-		// Save number of points
-		file << curve.numControlPoints();
+		// Check straight away whatever the curve's revision
+		clearanceRevision = curve.getRevision() - 1;
+		updateClearance();
+	}
+	else
+		setOutputText(clearanceOutput, "");
+}
+
+/* updateClearance() - Called while idle, shows a finished check --- */
+/* and starts another if the track has changed since the last one -- */
+/* was started. The last result stays up while the next one runs -- */
+void MainWindow::updateClearance()
+{
+	if( !checkingClearance )
+		return;
+
+	if( !clearance.isBusy() )
+	{
+		const CurveSnapshotPtr snapshot(curve.getSnapshot());
+		if( snapshot && snapshot->getRevision() != clearanceRevision && clearance.start(snapshot) )
+			clearanceRevision = snapshot->getRevision();
+	}
+
+	if( !clearance.poll() )
+		return;
+
+	const size_t numTooClose = clearance.getViolations().size();
+	const size_t numCrossing = clearance.numIntersections();
+
+	char text[32];
+	if( numTooClose == 0 )
+		sprintf_s(text, sizeof(text), "All clear");
+	else
+		sprintf_s(text, sizeof(text), "%u close, %u cross",
+				  static_cast<unsigned int>(numTooClose - numCrossing), static_cast<unsigned int>(numCrossing));
+	setOutputText(clearanceOutput, text);
+	damageMe();
+}
 
-		// Save each point's position and orientation
-		for each(const auto& point in curve.getControlPoints())
+/* loadPointsAsync() - Starts loading control points on a worker thread, */
+/* the current track stays up until pollTrackIO() swaps the new one in */
+void MainWindow::loadPointsAsync(const string& filename)
+{
+	if( !trackIO.startLoad(filename, curve) )
+	{
+		fl_alert("Please wait for \"%s\" to finish.", trackIO.getFilename().c_str());
+		return;
+	}
+
+	trackIOProgress->label("Loading");
+	trackIOProgress->value(0.f);
+	trackIOProgress->show();
+}
+
+/* savePointsAsync() - Starts saving a copy of the control points on a */
+/* worker thread, the track can keep being edited while it's written */
+void MainWindow::savePointsAsync(const string& filename)
+{
+	if( !trackIO.startSave(filename, curve) )
+	{
+		fl_alert("Please wait for \"%s\" to finish.", trackIO.getFilename().c_str());
+		return;
+	}
+
+	// Records from here on aren't in the snapshot being saved
+	journalMark = journal.numRecords();
+
+	trackIOProgress->label("Saving");
+	trackIOProgress->value(0.f);
+	trackIOProgress->show();
+}
+
+/* pollTrackIO() - Called between frames to finish background loads/saves */
+void MainWindow::pollTrackIO()
+{
+	switch(trackIO.poll(curve))
+	{
+	case AsyncTrackIO::idle:
+		// Fold a long journal into a snapshot of the curve
+		if( journal.needsCompaction(curve.numControlPoints()) )
+			compactJournalAsync();
+		return;
+
+	case AsyncTrackIO::running:
+		if( trackIOProgress->value() != trackIO.getProgress() )
+			trackIOProgress->value(trackIO.getProgress());
+		return;
+
+	case AsyncTrackIO::loaded:
+		// Replaying the journal is part of the load as far as undo goes
+		curve.setHistory(nullptr);
+		openJournal(trackIO.getFilename());
+		history.recordReplace(curve);
+		curve.setHistory(&history);
+
+		// The new curve may have brought its own type and tension
+		curveTypeChoice->value(curve.getCurveType());
+		tensionSlider->value(curve.tension);
+		setRotation(0.f);
+		damageMe();
+		break;
+
+	case AsyncTrackIO::saved:
+		if( compacting ) compactJournal();
+		else             rebaseJournal(trackIO.getFilename());
+		break;
+
+	case AsyncTrackIO::failed:
+		if( compacting )
 		{
-			const Vec3f& p(point.pos());
-			const Vec3f& o(point.orient());
+			closeJournal();
+			fl_alert("%s\nEdits won't be journaled.", trackIO.getError().c_str());
+		}
+		else
+			fl_alert("%s\nThe current track was kept.", trackIO.getError().c_str());
+		break;
+	}
+
+	compacting = false;
+	trackIOProgress->hide();
+}
 
-			file << endl;
-			file << p.x() << " " << p.y() << " " << p.z() << " ";
-			file << o.x() << " " << o.y() << " " << o.z() << " ";
+/* openJournal() - Replays the journal of the track just loaded from */
+/* 'filename' and journals further edits to it ------------------- */
+void MainWindow::openJournal(const string& filename)
+{
+	curve.setJournal(nullptr);
+	try {
+		const int numReplayed = journal.open(filename, curve);
+		if( numReplayed > 0 )
+		{
+			cout << "Replayed " << numReplayed << " edits from "
+				 << EditJournal::journalFilename(filename) << endl;
 		}
+		curve.setJournal(&journal);
+	} catch(TrackFileError& e) {
+		closeJournal();
+		fl_alert("%s\nEdits won't be journaled.", e.what());
+	}
+}
+
+/* rebaseJournal() - Called once the track has been saved to 'filename', */
+/* the journal keeps only the edits made while the save was running */
+void MainWindow::rebaseJournal(const string& filename)
+{
+	try {
+		// (without a journal, edits made during the save aren't kept)
+		if( journal.isOpen() )
+			journal.rebase(filename, journalMark);
+		else
+			journal.start(filename);
+		curve.setJournal(&journal);
+	} catch(TrackFileError& e) {
+		closeJournal();
+		fl_alert("%s\nEdits won't be journaled.", e.what());
+	}
+}
+
+/* compactJournalAsync() - Starts saving a snapshot of the curve -- */
+/* for the journal to build on, the track file itself is only ever - */
+/* written when the user saves it ---------------------------------- */
+void MainWindow::compactJournalAsync()
+{
+	if( !trackIO.startSave(EditJournal::newSnapshotFilename(journal.getTrackFilename()), curve) )
+		return;
+
+	// Records from here on aren't in the snapshot being saved
+	journalMark = journal.numRecords();
+	compacting  = true;
+}
+
+/* compactJournal() - Called once the snapshot has been saved, the - */
+/* journal keeps only the edits made while it was running --------- */
+void MainWindow::compactJournal()
+{
+	try {
+		// (the journal may have been closed while the snapshot was saved)
+		if( journal.isOpen() )
+			journal.compact(journalMark);
+	} catch(TrackFileError& e) {
+		closeJournal();
+		fl_alert("%s\nEdits won't be journaled.", e.what());
 	}
-	else // file didn't open...
+}
+
+/* snapshotJournal() - Compacts the journal onto a snapshot of the */
+/* curve as it is now, for changes that can't be journaled as edits */
+void MainWindow::snapshotJournal()
+{
+	if( !journal.isOpen() )
+		return;
+
+	if( trackIO.isBusy() )
 	{
-		stringstream ss;
-		ss << "Error - failed to open file \"" << filename
-			<< "\" for writing." << endl;
-		fl_alert(ss.str().c_str());
+		// A save or compaction is running and owns the snapshot file,
+		// so empty the journal rather than let stale edits replay
+		try {
+			journal.start(journal.getTrackFilename());
+		} catch(TrackFileError&) {
+			// (it's closed below either way)
+		}
+		closeJournal();
+		fl_alert("The track is being saved, so edits won't be journaled until it's saved again.");
+		return;
+	}
+
+	try {
+		writeBinaryTrackFile(EditJournal::newSnapshotFilename(journal.getTrackFilename()), curve);
+		journal.compact(journal.numRecords());
+	} catch(TrackFileError& e) {
+		closeJournal();
+		fl_alert("%s\nEdits won't be journaled.", e.what());
 	}
 }
 
+/* closeJournal() - Stops journaling edits, the journal file is kept */
+void MainWindow::closeJournal()
+{
+	curve.setJournal(nullptr);
+	journal.close();
+}
+
+/* reportError() - Shows an error, on stderr in batch mode where -- */
+/* there's nobody to close a dialog ------------------------------- */
+void MainWindow::reportError(const string& message)
+{
+	if( batchMode )
+		cerr << message << endl;
+	else
+		fl_alert("%s", message.c_str());
+}
+
+/* undo() - Undoes the most recent edit, drag or load ------------ */
+void MainWindow::undo()
+{
+	const int numPoints = curve.numControlPoints();
+	undoApplied(history.undo(curve), numPoints);
+}
+
+/* redo() - Redoes the most recently undone edit, drag or load --- */
+void MainWindow::redo()
+{
+	const int numPoints = curve.numControlPoints();
+	undoApplied(history.redo(curve), numPoints);
+}
+
+/* undoApplied() - Brings the window up to date after an undo or redo */
+void MainWindow::undoApplied(const UndoHistory::Result result, const int numPointsBefore)
+{
+	if( result == UndoHistory::nothingDone )
+		return;
+
+	// Replacing every point isn't journaled, so the journal starts over
+	// from a snapshot. Going back to another track leaves the journal
+	// of this one as it was, which matches the track as last edited
+	if( result == UndoHistory::pointsReplaced )
+		snapshotJournal();
+	else if( result == UndoHistory::curveReplaced )
+		closeJournal();
+
+	// Any step can take the curve type and tension back
+	curveTypeChoice->value(curve.getCurveType());
+	tensionSlider->value(curve.tension);
+
+	// Reset t so we don't try to access out of bounds
+	if( curve.numControlPoints() != numPointsBefore )
+		setRotation(0.f);
+
+	damageMe();
+}
+
 /* advanceTrain() - Moves the train in the specified direction --- */
 void MainWindow::advanceTrain(int dir)
 {
-	if( isArcLengthParam )
+	if( simulation.isRunning() )
 	{
-		const float vel = dir * speed * 0.07f;
-		rotation += arcLengthStep(vel);
+		simulation.post(TrainSimulation::step, static_cast<float>(dir));
+		return;
 	}
+
+	curve.publish();
+	const CurveSnapshotPtr snapshot(curve.getSnapshot());
+	if( snapshot && snapshot->numSegments() > 0 )
+		rotation = TrainSimulation::advance(*snapshot, rotation, static_cast<float>(dir), speed, isArcLengthParam);
+}
+
+/* flushTrainCommands() - Hands the simulation any commands that -- */
+/* were waiting for room in its queue ------------------------------ */
+void MainWindow::flushTrainCommands()
+{
+	simulation.flush();
+}
+
+/* startSimulation() - Moves the train on its own thread from now on */
+void MainWindow::startSimulation()
+{
+	curve.publish();
+	simulation.start(curve, rotation, speed, animating, isArcLengthParam);
+}
+
+/* readTrainPose() - Gets the pose to draw the train at this frame, */
+/* the simulation's latest if it's running and has caught up with -- */
+/* the last setRotation(), so a stale pose doesn't undo it --------- */
+void MainWindow::readTrainPose(TrainPose& pose)
+{
+	if( simulation.isRunning() && simulation.readPose(pose) )
+		rotation = pose.t;
 	else
-	{
-		rotation += dir * speed * 0.01f;
-	}
+		pose = trainPoseAt(rotation);
+}
+
+/* trainPoseAt() - The train's pose at 't' on the curve as it is now */
+TrainPose MainWindow::trainPoseAt(const float t)
+{
+	curve.publish();
+	const CurveSnapshotPtr snapshot(curve.getSnapshot());
+	return snapshot ? TrainSimulation::poseAt(*snapshot, t) : TrainPose();
+}
+
+/* setSpeed() - Sets how fast the train moves -------------------- */
+void MainWindow::setSpeed(float s)
+{
+	speed = s;
+	simulation.post(TrainSimulation::setSpeed, s);
+}
+
+/* setRotation() - Puts the train at 'r' on the track ------------ */
+void MainWindow::setRotation(float r)
+{
+	rotation = r;
+	simulation.post(TrainSimulation::setPosition, r);
+}
 
-	if( rotation >= curve.numControlPoints() )
-		rotation = 0.f;
-	if( rotation < 0 )
-		rotation += curve.numControlPoints();
+/* toggleAnimating() - Starts or stops the train ----------------- */
+void MainWindow::toggleAnimating()
+{
+	animating = !animating;
+	simulation.post(TrainSimulation::setAnimating, animating ? 1.f : 0.f);
+}
+
+/* toggleArcParam() - Switches between moving evenly in t and ---- */
+/* evenly along the track ---------------------------------------- */
+void MainWindow::toggleArcParam()
+{
+	isArcLengthParam = !isArcLengthParam;
+	simulation.post(TrainSimulation::setArcLength, isArcLengthParam ? 1.f : 0.f);
 }
 
 /* damageMe() - Called to force an update of the window ---------- */
@@ -0,0 +1,239 @@
+/*
+ * Mat4.cpp
+ */
+#include "Mat4.h"
+
+#include <cmath>
+
+
+/* invert() - Inverts a column major 4x4 matrix by cofactors, false */
+/* if it's singular ------------------------------------------------ */
+static bool invert(const double a[16], double inverse[16])
+{
+	inverse[0]  =  a[5] * a[10] * a[15] - a[5] * a[11] * a[14] - a[9] * a[6] * a[15]
+				 + a[9] * a[7]  * a[14] + a[13] * a[6] * a[11] - a[13] * a[7] * a[10];
+	inverse[4]  = -a[4] * a[10] * a[15] + a[4] * a[11] * a[14] + a[8] * a[6] * a[15]
+				 - a[8] * a[7]  * a[14] - a[12] * a[6] * a[11] + a[12] * a[7] * a[10];
+	inverse[8]  =  a[4] * a[9]  * a[15] - a[4] * a[11] * a[13] - a[8] * a[5] * a[15]
+				 + a[8] * a[7]  * a[13] + a[12] * a[5] * a[11] - a[12] * a[7] * a[9];
+	inverse[12] = -a[4] * a[9]  * a[14] + a[4] * a[10] * a[13] + a[8] * a[5] * a[14]
+				 - a[8] * a[6]  * a[13] - a[12] * a[5] * a[10] + a[12] * a[6] * a[9];
+	inverse[1]  = -a[1] * a[10] * a[15] + a[1] * a[11] * a[14] + a[9] * a[2] * a[15]
+				 - a[9] * a[3]  * a[14] - a[13] * a[2] * a[11] + a[13] * a[3] * a[10];
+	inverse[5]  =  a[0] * a[10] * a[15] - a[0] * a[11] * a[14] - a[8] * a[2] * a[15]
+				 + a[8] * a[3]  * a[14] + a[12] * a[2] * a[11] - a[12] * a[3] * a[10];
+	inverse[9]  = -a[0] * a[9]  * a[15] + a[0] * a[11] * a[13] + a[8] * a[1] * a[15]
+				 - a[8] * a[3]  * a[13] - a[12] * a[1] * a[11] + a[12] * a[3] * a[9];
+	inverse[13] =  a[0] * a[9]  * a[14] - a[0] * a[10] * a[13] - a[8] * a[1] * a[14]
+				 + a[8] * a[2]  * a[13] + a[12] * a[1] * a[10] - a[12] * a[2] * a[9];
+	inverse[2]  =  a[1] * a[6]  * a[15] - a[1] * a[7]  * a[14] - a[5] * a[2] * a[15]
+				 + a[5] * a[3]  * a[14] + a[13] * a[2] * a[7]  - a[13] * a[3] * a[6];
+	inverse[6]  = -a[0] * a[6]  * a[15] + a[0] * a[7]  * a[14] + a[4] * a[2] * a[15]
+				 - a[4] * a[3]  * a[14] - a[12] * a[2] * a[7]  + a[12] * a[3] * a[6];
+	inverse[10] =  a[0] * a[5]  * a[15] - a[0] * a[7]  * a[13] - a[4] * a[1] * a[15]
+				 + a[4] * a[3]  * a[13] + a[12] * a[1] * a[7]  - a[12] * a[3] * a[5];
+	inverse[14] = -a[0] * a[5]  * a[14] + a[0] * a[6]  * a[13] + a[4] * a[1] * a[14]
+				 - a[4] * a[2]  * a[13] - a[12] * a[1] * a[6]  + a[12] * a[2] * a[5];
+	inverse[3]  = -a[1] * a[6]  * a[11] + a[1] * a[7]  * a[10] + a[5] * a[2] * a[11]
+				 - a[5] * a[3]  * a[10] - a[9]  * a[2] * a[7]  + a[9]  * a[3] * a[6];
+	inverse[7]  =  a[0] * a[6]  * a[11] - a[0] * a[7]  * a[10] - a[4] * a[2] * a[11]
+				 + a[4] * a[3]  * a[10] + a[8]  * a[2] * a[7]  - a[8]  * a[3] * a[6];
+	inverse[11] = -a[0] * a[5]  * a[11] + a[0] * a[7]  * a[9]  + a[4] * a[1] * a[11]
+				 - a[4] * a[3]  * a[9]  - a[8]  * a[1] * a[7]  + a[8]  * a[3] * a[5];
+	inverse[15] =  a[0] * a[5]  * a[10] - a[0] * a[6]  * a[9]  - a[4] * a[1] * a[10]
+				 + a[4] * a[2]  * a[9]  + a[8]  * a[1] * a[6]  - a[8]  * a[2] * a[5];
+
+	const double determinant = a[0] * inverse[0] + a[1] * inverse[4] + a[2] * inverse[8] + a[3] * inverse[12];
+	if( determinant == 0.0 )
+		return false;
+
+	for(int i = 0; i < 16; ++i)
+		inverse[i] /= determinant;
+	return true;
+}
+
+/* camera() - The projection times the modelview, in doubles ------- */
+static void camera(const Mat4& modelview, const Mat4& projection, double result[16])
+{
+	for(int column = 0; column < 4; ++column)
+	{
+		for(int row = 0; row < 4; ++row)
+		{
+			double sum = 0.0;
+			for(int k = 0; k < 4; ++k)
+				sum += static_cast<double>(projection(row, k)) * modelview(k, column);
+			result[column * 4 + row] = sum;
+		}
+	}
+}
+
+
+/* ==================================================================
+ * Mat4 class
+ * ==================================================================
+ */
+Mat4::Mat4()
+{
+	for(int i = 0; i < 16; ++i)
+		m[i] = (i % 5 == 0) ? 1.f : 0.f;
+}
+
+Mat4::Mat4(const float columnMajor[16])
+{
+	for(int i = 0; i < 16; ++i)
+		m[i] = columnMajor[i];
+}
+
+/* translation() - Like glTranslatef() ----------------------------- */
+Mat4 Mat4::translation(const Vec3f& offset)
+{
+	Mat4 result;
+	result.m[12] = offset.x();
+	result.m[13] = offset.y();
+	result.m[14] = offset.z();
+	return result;
+}
+
+/* rotation() - Like glRotatef() ----------------------------------- */
+Mat4 Mat4::rotation(const float degrees, const Vec3f& axis)
+{
+	const Vec3f a(normalize(axis));
+	const float radians = degrees * 3.14159265f / 180.f;
+	const float c = std::cos(radians);
+	const float s = std::sin(radians);
+	const float x = a.x(), y = a.y(), z = a.z();
+
+	Mat4 result;
+	result.m[0] = x * x * (1.f - c) + c;
+	result.m[1] = y * x * (1.f - c) + z * s;
+	result.m[2] = x * z * (1.f - c) - y * s;
+	result.m[4] = x * y * (1.f - c) - z * s;
+	result.m[5] = y * y * (1.f - c) + c;
+	result.m[6] = y * z * (1.f - c) + x * s;
+	result.m[8] = x * z * (1.f - c) + y * s;
+	result.m[9] = y * z * (1.f - c) - x * s;
+	result.m[10] = z * z * (1.f - c) + c;
+	return result;
+}
+
+/* fromRows() - A rotation with 'x', 'y' and 'z' as its rows, so it */
+/* turns those axes onto the standard ones ------------------------- */
+Mat4 Mat4::fromRows(const Vec3f& x, const Vec3f& y, const Vec3f& z)
+{
+	Mat4 result;
+	for(int column = 0; column < 3; ++column)
+	{
+		result.m[column * 4 + 0] = x.v()[column];
+		result.m[column * 4 + 1] = y.v()[column];
+		result.m[column * 4 + 2] = z.v()[column];
+	}
+	return result;
+}
+
+/* perspective() - Like gluPerspective() --------------------------- */
+Mat4 Mat4::perspective(const float fovyDegrees, const float aspect, const float zNear, const float zFar)
+{
+	const float f = 1.f / std::tan(fovyDegrees * 3.14159265f / 360.f);
+
+	Mat4 result;
+	result.m[0]  = f / aspect;
+	result.m[5]  = f;
+	result.m[10] = (zFar + zNear) / (zNear - zFar);
+	result.m[11] = -1.f;
+	result.m[14] = 2.f * zFar * zNear / (zNear - zFar);
+	result.m[15] = 0.f;
+	return result;
+}
+
+/* ortho() - Like glOrtho() ---------------------------------------- */
+Mat4 Mat4::ortho(const float left, const float right, const float bottom, const float top,
+				 const float zNear, const float zFar)
+{
+	Mat4 result;
+	result.m[0]  = 2.f / (right - left);
+	result.m[5]  = 2.f / (top - bottom);
+	result.m[10] = -2.f / (zFar - zNear);
+	result.m[12] = -(right + left) / (right - left);
+	result.m[13] = -(top + bottom) / (top - bottom);
+	result.m[14] = -(zFar + zNear) / (zFar - zNear);
+	return result;
+}
+
+Mat4 Mat4::operator*(const Mat4& rhs) const
+{
+	Mat4 result;
+	for(int column = 0; column < 4; ++column)
+	{
+		for(int row = 0; row < 4; ++row)
+		{
+			float sum = 0.f;
+			for(int k = 0; k < 4; ++k)
+				sum += m[k * 4 + row] * rhs.m[column * 4 + k];
+			result.m[column * 4 + row] = sum;
+		}
+	}
+	return result;
+}
+
+/* transformPoint() - Transforms 'point', dividing through by w ---- */
+Vec3f Mat4::transformPoint(const Vec3f& point) const
+{
+	const float x = point.x(), y = point.y(), z = point.z();
+	const float w = m[3] * x + m[7] * y + m[11] * z + m[15];
+	const float scale = (w != 0.f) ? 1.f / w : 1.f;
+	return Vec3f((m[0] * x + m[4] * y + m[8]  * z + m[12]) * scale,
+				 (m[1] * x + m[5] * y + m[9]  * z + m[13]) * scale,
+				 (m[2] * x + m[6] * y + m[10] * z + m[14]) * scale);
+}
+
+// ---------------------------------------------------------------
+
+bool project(const Vec3f& world, const Mat4& modelview, const Mat4& projection,
+			 const int viewport[4], Vec3f& window)
+{
+	double c[16];
+	camera(modelview, projection, c);
+
+	const double x = world.x(), y = world.y(), z = world.z();
+	const double w = c[3] * x + c[7] * y + c[11] * z + c[15];
+	if( w == 0.0 )
+		return false;
+
+	const double ndcX = (c[0] * x + c[4] * y + c[8]  * z + c[12]) / w;
+	const double ndcY = (c[1] * x + c[5] * y + c[9]  * z + c[13]) / w;
+	const double ndcZ = (c[2] * x + c[6] * y + c[10] * z + c[14]) / w;
+
+	window.set(static_cast<float>(viewport[0] + viewport[2] * (ndcX + 1.0) * 0.5),
+			   static_cast<float>(viewport[1] + viewport[3] * (ndcY + 1.0) * 0.5),
+			   static_cast<float>((ndcZ + 1.0) * 0.5));
+	return true;
+}
+
+// Inverted in doubles, like GLU, since the near plane is close enough
+// to lose the depth in floats
+bool unProject(const Vec3f& window, const Mat4& modelview, const Mat4& projection,
+			   const int viewport[4], Vec3f& world)
+{
+	double c[16], inverse[16];
+	camera(modelview, projection, c);
+	if( !invert(c, inverse) || viewport[2] == 0 || viewport[3] == 0 )
+		return false;
+
+	const double ndc[4] = {
+		2.0 * (window.x() - viewport[0]) / viewport[2] - 1.0,
+		2.0 * (window.y() - viewport[1]) / viewport[3] - 1.0,
+		2.0 * window.z() - 1.0,
+		1.0
+	};
+
+	double out[4];
+	for(int row = 0; row < 4; ++row)
+		out[row] = inverse[row] * ndc[0] + inverse[4 + row] * ndc[1] + inverse[8 + row] * ndc[2] + inverse[12 + row] * ndc[3];
+	if( out[3] == 0.0 )
+		return false;
+
+	world.set(static_cast<float>(out[0] / out[3]),
+			  static_cast<float>(out[1] / out[3]),
+			  static_cast<float>(out[2] / out[3]));
+	return true;
+}
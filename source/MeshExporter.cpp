@@ -0,0 +1,385 @@
+/*
+ * MeshExporter.cpp
+ */
+#include "MeshExporter.h"
+#include "CurveSegments.h"
+#include "MathUtils.h"
+#include "TrackFile.h"
+#include "Profiler.h"
+
+#include <algorithm>
+#include <cstring>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+using std::string;
+using std::vector;
+
+
+// Tie box sizes, in track units, the rails' are the segments'
+static const float tieSpacing     = 3.f;   // arc length between ties
+static const float tieHalfWidth   = 0.5f;
+static const float tieOverhang    = 1.5f;  // past each rail
+static const float tieDepth       = 0.4f;
+static const float pathHalfWidth  = 0.5f;
+static const float pathLift       = 0.05f; // above the ties
+static const int   maxTiesPerSegment = 4096;
+
+static const size_t fileBufferSize = 1 << 20;
+
+/* Frame struct - position and orthonormal basis at a point on a segment */
+struct Frame
+{
+	Vec3f pos, dir, side, up;
+};
+
+/* frameAt() - Evaluates the segment's position and basis at 't' -- */
+static Frame frameAt(CurveSegment& segment, const float t)
+{
+	Frame f;
+	f.pos = segment.getPosition(t);
+	f.dir = normalize(segment.getDirection(t));
+
+	Vec3f up(normalize(segment.getOrientation(t)));
+	Vec3f side(cross(f.dir, up));
+	if( side.magnitude() < 1e-6f )
+		generateBasis(f.dir, up, side);   // orientation along the track
+	else
+		side = normalize(side);
+
+	f.side = side;
+	f.up   = cross(side, f.dir);
+	return f;
+}
+
+static inline void addVertex(vector<float>& vertices, const Vec3f& v)
+{
+	vertices.push_back(v.x());
+	vertices.push_back(v.y());
+	vertices.push_back(v.z());
+}
+
+static inline void addQuad(vector<unsigned int>& indices, const unsigned int a, const unsigned int b,
+						   const unsigned int c, const unsigned int d)
+{
+	const unsigned int quad[] = { a, b, c, a, c, d };
+	indices.insert(indices.end(), quad, quad + 6);
+}
+
+/* tessellate() - Builds the rails, ties and path for one segment, */
+/* sampled so the rails stay within 'tolerance' of the true curve -- */
+static void tessellate(CurveSegment& segment, const float tolerance, const bool includePath,
+					   MeshExporter::Piece& piece)
+{
+	segment.computeSamples(tolerance, piece.params);
+
+	const int   numSamples    = piece.params.size();
+	const float radius        = CurveSegment::radius;
+	const float railHalfWidth = CurveSegment::railHalfWidth;
+	const float railHeight    = CurveSegment::railHeight;
+
+	piece.vertices.clear();
+	piece.rails.clear();
+	piece.ties.clear();
+	piece.path.clear();
+	piece.text.clear();
+	piece.arcLengths.clear();
+
+	// Rails: a rectangular section swept through each sample, the
+	// four corners of both rails' sections are stored per sample
+	Vec3f lastPos;
+	for(int i = 0; i < numSamples; ++i)
+	{
+		const Frame f(frameAt(segment, piece.params[i]));
+		for(int rail = 0; rail < 2; ++rail)
+		{
+			const Vec3f center(f.pos + (rail == 0 ? radius : -radius) * f.side);
+			addVertex(piece.vertices, center + -railHalfWidth * f.side);
+			addVertex(piece.vertices, center +  railHalfWidth * f.side);
+			addVertex(piece.vertices, center +  railHalfWidth * f.side + railHeight * f.up);
+			addVertex(piece.vertices, center + -railHalfWidth * f.side + railHeight * f.up);
+		}
+
+		const float length = (i == 0) ? 0.f : (f.pos - lastPos).magnitude();
+		piece.arcLengths.push_back((i == 0) ? 0.f : piece.arcLengths.back() + length);
+		lastPos = f.pos;
+	}
+
+	for(int i = 0; i + 1 < numSamples; ++i)
+	{
+		for(int rail = 0; rail < 2; ++rail)
+		{
+			const unsigned int ring = i * 8 + rail * 4;
+			const unsigned int next = ring + 8;
+			for(unsigned int k = 0; k < 4; ++k)
+			{
+				const unsigned int k1 = (k + 1) % 4;
+				addQuad(piece.rails, ring + k, ring + k1, next + k1, next + k);
+			}
+		}
+	}
+
+	// Ties: boxes under the rails spread evenly along the segment's arc length
+	const float segmentLength = piece.arcLengths.back();
+	const int   numTies = (std::min)(maxTiesPerSegment,
+						  (std::max)(1, static_cast<int>(segmentLength / tieSpacing + 0.5f)));
+
+	static const unsigned int boxFaces[6][4] = {
+		{ 0, 2, 3, 1 }, { 4, 5, 7, 6 },   // back, front
+		{ 0, 1, 5, 4 }, { 2, 6, 7, 3 },   // sides
+		{ 0, 4, 6, 2 }, { 1, 3, 7, 5 }    // bottom, top
+	};
+
+	int sample = 0;
+	for(int tie = 0; tie < numTies; ++tie)
+	{
+		const float s = (tie + 0.5f) * segmentLength / numTies;
+		while( sample + 2 < numSamples && piece.arcLengths[sample + 1] < s )
+			++sample;
+
+		const float span  = piece.arcLengths[sample + 1] - piece.arcLengths[sample];
+		const float local = (span > 0.f) ? (s - piece.arcLengths[sample]) / span : 0.f;
+		const float t0    = piece.params[sample];
+		const Frame f(frameAt(segment, t0 + local * (piece.params[sample + 1] - t0)));
+
+		const unsigned int first = piece.vertices.size() / 3;
+		const float halfLength = radius + railHalfWidth + tieOverhang;
+		for(int corner = 0; corner < 8; ++corner)
+		{
+			const float along = (corner & 4) ? tieHalfWidth : -tieHalfWidth;
+			const float across = (corner & 2) ? halfLength : -halfLength;
+			const float height = (corner & 1) ? 0.f : -tieDepth;
+			addVertex(piece.vertices, f.pos + along * f.dir + across * f.side + height * f.up);
+		}
+		for(int face = 0; face < 6; ++face)
+		{
+			addQuad(piece.ties, first + boxFaces[face][0], first + boxFaces[face][1],
+								first + boxFaces[face][2], first + boxFaces[face][3]);
+		}
+	}
+
+	// Path: a flat ribbon along the center of the track
+	if( includePath )
+	{
+		const unsigned int first = piece.vertices.size() / 3;
+		for(int i = 0; i < numSamples; ++i)
+		{
+			const Frame f(frameAt(segment, piece.params[i]));
+			addVertex(piece.vertices, f.pos + -pathHalfWidth * f.side + pathLift * f.up);
+			addVertex(piece.vertices, f.pos +  pathHalfWidth * f.side + pathLift * f.up);
+		}
+		for(int i = 0; i + 1 < numSamples; ++i)
+		{
+			const unsigned int v = first + i * 2;
+			addQuad(piece.path, v, v + 1, v + 3, v + 2);
+		}
+	}
+}
+
+/* appendFaces() - Appends OBJ face lines for 'indices' ---------- */
+static void appendFaces(string& text, const char *group, const vector<unsigned int>& indices,
+						const unsigned __int64 firstIndex)
+{
+	if( indices.empty() )
+		return;
+
+	char line[80];
+	text += group;
+	for(size_t i = 0; i < indices.size(); i += 3)
+	{
+		sprintf_s(line, sizeof(line), "f %I64u %I64u %I64u\n",
+				  firstIndex + indices[i], firstIndex + indices[i + 1], firstIndex + indices[i + 2]);
+		text += line;
+	}
+}
+
+/* hasTrackMeshExtension() - True if 'filename' ends in .trm ------ */
+bool hasTrackMeshExtension(const string& filename)
+{
+	return hasExtension(filename, trackMeshExtension);
+}
+
+
+/* ==================================================================
+ * MeshExporter class
+ * ==================================================================
+ */
+
+MeshExporter::MeshExporter(Curve& curve)
+	: curve(curve)
+	, includePath(false)
+	, binary(false)
+	, file(nullptr)
+	, firstSegment(0)
+	, filling(0)
+	, writing(0)
+	, writer()
+	, writeFailed(false)
+	, numVertices(0)
+	, numTriangles(0)
+{
+	numPieces[0] = numPieces[1] = 0;
+}
+
+MeshExporter::~MeshExporter()
+{
+	finishWriting();
+	if( file != nullptr )
+		fclose(file);
+}
+
+/* exportMesh() - Writes the curve's track as a triangle mesh, as -- */
+/* binary if 'filename' ends in .trm or else as OBJ text --------- */
+/* Throws TrackFileError on failure ------------------------------ */
+void MeshExporter::exportMesh(const string& filename, const bool includePath)
+{
+	ScopedTimer timer(stageMeshExport);
+
+	this->includePath = includePath;
+	binary       = hasTrackMeshExtension(filename);
+	writeFailed  = false;
+	numVertices  = 0;
+	numTriangles = 0;
+
+	if( curve.numSegments() == 0 )
+		curve.regenerateSegments();
+
+	if( fopen_s(&file, filename.c_str(), "wb") != 0 || file == nullptr )
+	{
+		file = nullptr;
+		throw TrackFileError("Error - failed to open file \"" + filename + "\" for writing.");
+	}
+	setvbuf(file, nullptr, _IOFBF, fileBufferSize);
+
+	TrackMeshHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, trackMeshMagic, sizeof(trackMeshMagic));
+	header.version    = trackMeshVersion;
+	header.headerSize = sizeof(TrackMeshHeader);
+	header.flags      = includePath ? trackMeshHasPath : 0;
+
+	// The header's counts are filled in once everything is written
+	bool ok = binary ? fwrite(&header, sizeof(header), 1, file) == 1
+					 : fprintf(file, "# Track mesh: rails, ties%s\n", includePath ? ", path" : "") > 0;
+
+	const int numSegments = curve.numSegments();
+	for(firstSegment = 0; ok && firstSegment < numSegments; firstSegment += segmentsPerBatch)
+	{
+		const int count = (std::min)(segmentsPerBatch, numSegments - firstSegment);
+		if( batches[filling].size() < static_cast<size_t>(count) )
+			batches[filling].resize(count);
+		numPieces[filling] = count;
+
+		parallelFor(count, &MeshExporter::tessellateTask, this);
+
+		for(int i = 0; i < count; ++i)
+		{
+			Piece& piece = batches[filling][i];
+			piece.firstVertex = numVertices;
+			numVertices  += piece.vertices.size() / 3;
+			numTriangles += (piece.rails.size() + piece.ties.size() + piece.path.size()) / 3;
+		}
+
+		if( !binary )
+			parallelFor(count, &MeshExporter::formatTask, this);
+
+		// Write this batch while the next one is tessellated
+		finishWriting();
+		ok = !writeFailed;
+		writing = filling;
+		writer.start(&MeshExporter::run, this);
+		filling = 1 - filling;
+	}
+
+	finishWriting();
+	ok = ok && !writeFailed;
+
+	if( ok && binary )
+	{
+		header.numBlocks    = numSegments;
+		header.numVertices  = numVertices;
+		header.numTriangles = numTriangles;
+		ok = fseek(file, 0, SEEK_SET) == 0 && fwrite(&header, sizeof(header), 1, file) == 1;
+	}
+
+	ok = (fclose(file) == 0) && ok;
+	file = nullptr;
+	if( !ok )
+		throw TrackFileError("Error - failed writing file \"" + filename + "\".");
+}
+
+/* tessellateTask() - parallelFor task, tessellates one segment of the batch */
+void MeshExporter::tessellateTask(const int index, void *pExporter)
+{
+	MeshExporter *exporter = reinterpret_cast<MeshExporter*>(pExporter);
+
+	CurveSegment *segment = exporter->curve.getSegment(exporter->firstSegment + index);
+	tessellate(*segment, exporter->curve.getTessellation().tolerance, exporter->includePath,
+			   exporter->batches[exporter->filling][index]);
+}
+
+/* formatTask() - parallelFor task, formats one segment as OBJ lines */
+void MeshExporter::formatTask(const int index, void *pExporter)
+{
+	MeshExporter *exporter = reinterpret_cast<MeshExporter*>(pExporter);
+	Piece& piece = exporter->batches[exporter->filling][index];
+
+	char line[80];
+	for(size_t i = 0; i < piece.vertices.size(); i += 3)
+	{
+		sprintf_s(line, sizeof(line), "v %.9g %.9g %.9g\n",
+				  piece.vertices[i], piece.vertices[i + 1], piece.vertices[i + 2]);
+		piece.text += line;
+	}
+
+	// OBJ indices start at 1
+	const unsigned __int64 firstIndex = piece.firstVertex + 1;
+	appendFaces(piece.text, "g rails\n", piece.rails, firstIndex);
+	appendFaces(piece.text, "g ties\n",  piece.ties,  firstIndex);
+	appendFaces(piece.text, "g path\n",  piece.path,  firstIndex);
+}
+
+/* run() - Writer thread entry point ----------------------------- */
+void MeshExporter::run(void *pExporter)
+{
+	MeshExporter *exporter = reinterpret_cast<MeshExporter*>(pExporter);
+	exporter->writeBatch(exporter->writing);
+}
+
+/* writeBatch() - Writes every piece of a tessellated batch ------ */
+void MeshExporter::writeBatch(const int batch)
+{
+	bool ok = true;
+	for(int i = 0; i < numPieces[batch] && ok; ++i)
+	{
+		const Piece& piece = batches[batch][i];
+		if( !binary )
+		{
+			ok = fwrite(piece.text.data(), 1, piece.text.size(), file) == piece.text.size();
+			continue;
+		}
+
+		TrackMeshBlock block;
+		block.numVertices      = piece.vertices.size() / 3;
+		block.numRailTriangles = piece.rails.size() / 3;
+		block.numTieTriangles  = piece.ties.size()  / 3;
+		block.numPathTriangles = piece.path.size()  / 3;
+
+		ok = fwrite(&block, sizeof(block), 1, file) == 1
+		  && fwrite(&piece.vertices[0], sizeof(float), piece.vertices.size(), file) == piece.vertices.size()
+		  && fwrite(&piece.rails[0], sizeof(unsigned int), piece.rails.size(), file) == piece.rails.size()
+		  && fwrite(&piece.ties[0],  sizeof(unsigned int), piece.ties.size(),  file) == piece.ties.size();
+		if( ok && !piece.path.empty() )
+			ok = fwrite(&piece.path[0], sizeof(unsigned int), piece.path.size(), file) == piece.path.size();
+	}
+
+	if( !ok )
+		writeFailed = true;
+}
+
+/* finishWriting() - Waits for the writer to finish its batch ---- */
+void MeshExporter::finishWriting()
+{
+	writer.join();
+}
@@ -0,0 +1,288 @@
+/*
+ * PackedPoints.cpp
+ */
+#include "PackedPoints.h"
+#include "Threads.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+using std::vector;
+
+static const float maxSteps  = 65535.f;   // per axis in a tile
+static const float octSteps  = 127.f;     // per octahedral coordinate
+
+
+/* octFold() - Folds the lower half of the octahedron over the ---- */
+/* upper one, or back again ---------------------------------------- */
+static void octFold(float& u, float& v)
+{
+	const float foldedU = (1.f - std::fabs(v)) * ((u >= 0.f) ? 1.f : -1.f);
+	const float foldedV = (1.f - std::fabs(u)) * ((v >= 0.f) ? 1.f : -1.f);
+	u = foldedU;
+	v = foldedV;
+}
+
+/* octDecode() - The direction two octahedral coordinates stand for */
+static Vec3f octDecode(const signed char e[2])
+{
+	float u = e[0] / octSteps;
+	float v = e[1] / octSteps;
+	const float y = 1.f - std::fabs(u) - std::fabs(v);
+	if( y < 0.f )
+		octFold(u, v);
+	return normalize(Vec3f(u, y, v));
+}
+
+/* octEncode() - The octahedral coordinates of the closest of the -- */
+/* four steps around 'direction', which has to be unit length ------ */
+static void octEncode(const Vec3f& direction, signed char e[2])
+{
+	e[0] = e[1] = 0;
+
+	const float l1 = std::fabs(direction.x()) + std::fabs(direction.y()) + std::fabs(direction.z());
+	if( l1 == 0.f )
+		return;
+
+	float u = direction.x() / l1;
+	float v = direction.z() / l1;
+	if( direction.y() < 0.f )
+		octFold(u, v);
+
+	float best = -2.f;
+	for(int corner = 0; corner < 4; ++corner)
+	{
+		const float eu = (corner & 1) ? std::ceil(u * octSteps) : std::floor(u * octSteps);
+		const float ev = (corner & 2) ? std::ceil(v * octSteps) : std::floor(v * octSteps);
+
+		signed char candidate[2];
+		candidate[0] = static_cast<signed char>((std::max)(-octSteps, (std::min)(octSteps, eu)));
+		candidate[1] = static_cast<signed char>((std::max)(-octSteps, (std::min)(octSteps, ev)));
+
+		const float match = dot(octDecode(candidate), direction);
+		if( match > best )
+		{
+			best = match;
+			e[0] = candidate[0];
+			e[1] = candidate[1];
+		}
+	}
+}
+
+
+/* ==================================================================
+ * PackedPoints class
+ * ==================================================================
+ */
+PackedPoints::PackedPoints(const CurveType type, const float tension)
+	: type(type)
+	, tension(tension)
+	, points()
+	, tiles()
+	, packing(nullptr)
+	, positionError(0.f)
+	, orientError(0.f)
+{
+	segmentBasis(type, tension, basis);
+}
+
+/* pack() - Replaces the packed points with 'controlPoints' -------- */
+void PackedPoints::pack(const ControlPointVector& controlPoints)
+{
+	const int numTiles = (controlPoints.size() + tileSize - 1) / tileSize;
+
+	points.resize(controlPoints.size());
+	tiles.resize(numTiles);
+
+	packing = &controlPoints;
+	parallelFor(numTiles, &PackedPoints::packTask, this);
+	packing = nullptr;
+
+	positionError = 0.f;
+	orientError   = 0.f;
+	for each(const Tile& tile in tiles)
+	{
+		positionError = (std::max)(positionError, tile.positionError);
+		orientError   = (std::max)(orientError,   tile.orientError);
+	}
+}
+
+/* unpack() - Replaces 'controlPoints' with the packed points ------ */
+void PackedPoints::unpack(ControlPointVector& controlPoints) const
+{
+	controlPoints.resize(points.size());
+	for(int i = 0; i < numPoints(); ++i)
+		controlPoints[i] = getPoint(i);
+}
+
+/* packTask() - parallelFor task, packs one tile ------------------- */
+void PackedPoints::packTask(const int index, void *pPacked)
+{
+	reinterpret_cast<PackedPoints*>(pPacked)->packTile(index);
+}
+
+/* packTile() - Fits a tile around its points and packs them, ------ */
+/* measuring how far each one moved -------------------------------- */
+void PackedPoints::packTile(const int index)
+{
+	const ControlPointVector& source = *packing;
+
+	const int first = index * tileSize;
+	const int last  = (std::min)(first + tileSize, static_cast<int>(source.size()));
+
+	float low[3], high[3];
+	for(int axis = 0; axis < 3; ++axis)
+		low[axis] = high[axis] = source[first].pos().v()[axis];
+	for(int i = first + 1; i < last; ++i)
+	{
+		for(int axis = 0; axis < 3; ++axis)
+		{
+			low [axis] = (std::min)(low [axis], source[i].pos().v()[axis]);
+			high[axis] = (std::max)(high[axis], source[i].pos().v()[axis]);
+		}
+	}
+
+	Tile& tile = tiles[index];
+	tile.corner = Vec3f(low[0], low[1], low[2]);
+	tile.step   = Vec3f((high[0] - low[0]) / maxSteps, (high[1] - low[1]) / maxSteps, (high[2] - low[2]) / maxSteps);
+	tile.positionError = 0.f;
+	tile.orientError   = 0.f;
+
+	for(int i = first; i < last; ++i)
+	{
+		const Vec3f& position(source[i].pos());
+		Point& point = points[i];
+
+		for(int axis = 0; axis < 3; ++axis)
+		{
+			const float step  = tile.step.v()[axis];
+			const float steps = (step > 0.f) ? std::floor((position.v()[axis] - low[axis]) / step + 0.5f) : 0.f;
+			point.position[axis] = static_cast<unsigned short>((std::max)(0.f, (std::min)(maxSteps, steps)));
+		}
+
+		const Vec3f direction(normalize(source[i].orient()));
+		octEncode(direction, point.orient);
+
+		tile.positionError = (std::max)(tile.positionError, magnitude(difference(positionOf(i), position)));
+		if( magnitude(direction) > 0.f )
+		{
+			const float match = (std::min)(1.f, dot(orientOf(i), direction));
+			tile.orientError = (std::max)(tile.orientError, std::acos(match));
+		}
+	}
+}
+
+/* setCurveType() - Evaluates segments as 'curveType' from now on -- */
+void PackedPoints::setCurveType(const CurveType curveType)
+{
+	type = curveType;
+	segmentBasis(type, tension, basis);
+}
+
+/* setTension() - Sets the tension of cardinal segments ------------ */
+void PackedPoints::setTension(const float newTension)
+{
+	tension = newTension;
+	segmentBasis(type, tension, basis);
+}
+
+/* getPoint() - Unpacks the specified control point ---------------- */
+CtrlPoint PackedPoints::getPoint(const int id) const
+{
+	return CtrlPoint(positionOf(id), orientOf(id));
+}
+
+/* positionOf() - Unpacks the specified point's position ----------- */
+Vec3f PackedPoints::positionOf(const int id) const
+{
+	const Tile&  tile  = tiles[id / tileSize];
+	const Point& point = points[id];
+	return Vec3f(tile.corner.x() + tile.step.x() * point.position[0],
+				 tile.corner.y() + tile.step.y() * point.position[1],
+				 tile.corner.z() + tile.step.z() * point.position[2]);
+}
+
+/* orientOf() - Unpacks the specified point's orientation ---------- */
+Vec3f PackedPoints::orientOf(const int id) const
+{
+	return octDecode(points[id].orient);
+}
+
+/* pointsOf() - Unpacks the positions of a segment's control points */
+/* (previous, start, end, next), wrapping around like Curve does --- */
+void PackedPoints::pointsOf(const int segment, Vec3f p[4]) const
+{
+	const int n = numPoints();
+
+	// The first segment wraps around to the last point for its previous control,
+	// unless there are too few points for that to make sense
+	const int prev = (segment > 0) ? (segment - 1) : ((n >= 4) ? (n - 1) : 0);
+
+	p[0] = positionOf(prev);
+	p[1] = positionOf(segment);
+	p[2] = positionOf((segment + 1) % n);
+	p[3] = positionOf((segment + 2) % n);
+}
+
+/* segmentAt() - The segment 't' falls on, and the t on it --------- */
+/* There have to be points, t wraps around outside [0, n) ---------- */
+int PackedPoints::segmentAt(const float t, float& tUnit) const
+{
+	const float n = static_cast<float>(numSegments());
+
+	float wrapped = std::fmod(t, n);
+	if( wrapped < 0.f )
+		wrapped += n;
+
+	const int segment = (std::min)(static_cast<int>(wrapped), numSegments() - 1);
+	tUnit = wrapped - segment;
+	return segment;
+}
+
+Vec3f PackedPoints::getPosition(const float t) const
+{
+	float tUnit;
+	const int segment = segmentAt(t, tUnit);
+
+	Vec3f p[4];
+	pointsOf(segment, p);
+
+	Vec3f position;
+	for(int k = 0; k < 4; ++k)
+	{
+		const float w = ((basis[k][3] * tUnit + basis[k][2]) * tUnit + basis[k][1]) * tUnit + basis[k][0];
+		position += w * p[k];
+	}
+	return position;
+}
+
+Vec3f PackedPoints::getDirection(const float t) const
+{
+	float tUnit;
+	const int segment = segmentAt(t, tUnit);
+
+	Vec3f p[4];
+	pointsOf(segment, p);
+
+	Vec3f direction;
+	for(int k = 0; k < 4; ++k)
+	{
+		const float w = (3.f * basis[k][3] * tUnit + 2.f * basis[k][2]) * tUnit + basis[k][1];
+		direction += w * p[k];
+	}
+	return direction.normalize();
+}
+
+Vec3f PackedPoints::getOrientation(const float t) const
+{
+	float tUnit;
+	const int segment = segmentAt(t, tUnit);
+	return lerp(-tUnit, orientOf(segment), orientOf((segment + 1) % numPoints()));
+}
+
+/* getMemoryUsed() - Bytes held by the packed points --------------- */
+size_t PackedPoints::getMemoryUsed() const
+{
+	return sizeof(*this) + points.capacity() * sizeof(Point) + tiles.capacity() * sizeof(Tile);
+}
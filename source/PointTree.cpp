@@ -0,0 +1,319 @@
+/*
+ * PointTree.cpp
+ */
+#include "PointTree.h"
+
+#include <cassert>
+#include <memory>
+#include <vector>
+
+using std::vector;
+using std::make_shared;
+
+
+/* bytes() - Memory held by this node, not counting its children - */
+size_t PointTreeNode::bytes() const
+{
+	return sizeof(PointTreeNode)
+		 + points.capacity()   * sizeof(CtrlPoint)
+		 + children.capacity() * sizeof(PointTreeNodePtr);
+}
+
+/* makeUnique() - Copies 'node' if any other tree shares it, so it can be changed */
+static PointTreeNode& makeUnique(PointTreeNodePtr& node, size_t& bytes)
+{
+	if( node.use_count() > 1 )
+	{
+		node = make_shared<PointTreeNode>(*node);
+		bytes += node->bytes();
+	}
+	return *node;
+}
+
+/* sumCounts() - Recounts an internal node's points from its children */
+static void sumCounts(PointTreeNode& node)
+{
+	node.count = 0;
+	for each(const auto& child in node.children)
+		node.count += child->count;
+}
+
+/* samePoint() - True if two points have identical values -------- */
+static bool samePoint(const CtrlPoint& a, const CtrlPoint& b)
+{
+	return a.pos().x()    == b.pos().x()    && a.pos().y()    == b.pos().y()    && a.pos().z()    == b.pos().z()
+		&& a.orient().x() == b.orient().x() && a.orient().y() == b.orient().y() && a.orient().z() == b.orient().z();
+}
+
+/* insertAt() - Inserts a point before 'index' in the subtree ---- */
+/* Returns the new right sibling if the node had to split, else nullptr */
+static PointTreeNodePtr insertAt(PointTreeNodePtr& nodePtr, int index, const CtrlPoint& point, size_t& bytes)
+{
+	PointTreeNode& node = makeUnique(nodePtr, bytes);
+	++node.count;
+
+	if( node.isLeaf() )
+	{
+		node.points.insert(node.points.begin() + index, point);
+		if( node.points.size() <= PointTree::maxLeafPoints )
+			return PointTreeNodePtr();
+
+		PointTreeNodePtr sibling = make_shared<PointTreeNode>();
+		const size_t half = node.points.size() / 2;
+		sibling->points.assign(node.points.begin() + half, node.points.end());
+		sibling->count = sibling->points.size();
+		node.points.erase(node.points.begin() + half, node.points.end());
+		node.count = node.points.size();
+		bytes += sibling->bytes();
+		return sibling;
+	}
+
+	// Inserting at the end of a child is the same as at the start of the next
+	size_t c = 0;
+	while( c + 1 < node.children.size() && index > node.children[c]->count )
+		index -= node.children[c++]->count;
+
+	PointTreeNodePtr split = insertAt(node.children[c], index, point, bytes);
+	if( !split )
+		return PointTreeNodePtr();
+
+	node.children.insert(node.children.begin() + c + 1, split);
+	if( node.children.size() <= PointTree::maxChildren )
+		return PointTreeNodePtr();
+
+	PointTreeNodePtr sibling = make_shared<PointTreeNode>();
+	const size_t half = node.children.size() / 2;
+	sibling->children.assign(node.children.begin() + half, node.children.end());
+	node.children.erase(node.children.begin() + half, node.children.end());
+	sumCounts(*sibling);
+	sumCounts(node);
+	bytes += sibling->bytes();
+	return sibling;
+}
+
+/* eraseAt() - Erases the point at 'index' in the subtree -------- */
+/* Children left empty are removed, but nodes aren't merged ------ */
+static void eraseAt(PointTreeNodePtr& nodePtr, int index, size_t& bytes)
+{
+	PointTreeNode& node = makeUnique(nodePtr, bytes);
+	--node.count;
+
+	if( node.isLeaf() )
+	{
+		node.points.erase(node.points.begin() + index);
+		return;
+	}
+
+	size_t c = 0;
+	while( index >= node.children[c]->count )
+		index -= node.children[c++]->count;
+
+	eraseAt(node.children[c], index, bytes);
+	if( node.children[c]->count == 0 )
+		node.children.erase(node.children.begin() + c);
+}
+
+/* diffNodes() - Appends the indices of points that differ between */
+/* two subtrees of the same shape, returns false if the shapes differ */
+static bool diffNodes(const PointTreeNode *a, const PointTreeNode *b, int offset, vector<int>& changed)
+{
+	if( a == b )
+		return true;
+	if( a->count != b->count || a->isLeaf() != b->isLeaf() )
+		return false;
+
+	if( a->isLeaf() )
+	{
+		for(size_t i = 0; i < a->points.size(); ++i)
+		{
+			if( !samePoint(a->points[i], b->points[i]) )
+				changed.push_back(offset + i);
+		}
+		return true;
+	}
+
+	if( a->children.size() != b->children.size() )
+		return false;
+
+	for(size_t c = 0; c < a->children.size(); ++c)
+	{
+		if( !diffNodes(a->children[c].get(), b->children[c].get(), offset, changed) )
+			return false;
+		offset += a->children[c]->count;
+	}
+	return true;
+}
+
+
+/* ==================================================================
+ * PointTree class
+ * ==================================================================
+ */
+
+PointTree::PointTree()
+	: root()
+{ }
+
+/* Builds a tree holding a copy of 'points', adding the bytes it allocated to 'bytes' */
+PointTree::PointTree(const vector<CtrlPoint>& points, size_t *bytes)
+	: root()
+{
+	if( points.empty() )
+		return;
+
+	size_t allocated = 0;
+
+	// Full leaves, then full internal nodes a level at a time up to the root
+	vector<PointTreeNodePtr> level;
+	level.reserve(points.size() / maxLeafPoints + 1);
+	for(size_t first = 0; first < points.size(); first += maxLeafPoints)
+	{
+		const size_t last = (points.size() - first > maxLeafPoints) ? first + maxLeafPoints : points.size();
+
+		PointTreeNodePtr leaf = make_shared<PointTreeNode>();
+		leaf->points.assign(points.begin() + first, points.begin() + last);
+		leaf->count = leaf->points.size();
+		allocated += leaf->bytes();
+		level.push_back(leaf);
+	}
+
+	while( level.size() > 1 )
+	{
+		vector<PointTreeNodePtr> parents;
+		parents.reserve(level.size() / maxChildren + 1);
+		for(size_t first = 0; first < level.size(); first += maxChildren)
+		{
+			const size_t last = (level.size() - first > maxChildren) ? first + maxChildren : level.size();
+
+			PointTreeNodePtr parent = make_shared<PointTreeNode>();
+			parent->children.assign(level.begin() + first, level.begin() + last);
+			sumCounts(*parent);
+			allocated += parent->bytes();
+			parents.push_back(parent);
+		}
+		level.swap(parents);
+	}
+
+	root = level.front();
+	if( bytes != nullptr )
+		*bytes += allocated;
+}
+
+/* at() - Gets the point at 'index' in O(log n) ------------------ */
+const CtrlPoint& PointTree::at(int index) const
+{
+	assert(index >= 0 && index < size());
+
+	const PointTreeNode *node = root.get();
+	while( !node->isLeaf() )
+	{
+		size_t c = 0;
+		while( index >= node->children[c]->count )
+			index -= node->children[c++]->count;
+		node = node->children[c].get();
+	}
+	return node->points[index];
+}
+
+/* copyTo() - Replaces 'points' with every point in the tree ----- */
+void PointTree::copyTo(vector<CtrlPoint>& points) const
+{
+	points.clear();
+	points.reserve(size());
+	if( !root )
+		return;
+
+	// Depth first, children pushed right to left so the leaves come off in order
+	vector<const PointTreeNode*> stack(1, root.get());
+	while( !stack.empty() )
+	{
+		const PointTreeNode *node = stack.back();
+		stack.pop_back();
+
+		if( node->isLeaf() )
+		{
+			points.insert(points.end(), node->points.begin(), node->points.end());
+			continue;
+		}
+		for(size_t c = node->children.size(); c-- > 0; )
+			stack.push_back(node->children[c].get());
+	}
+}
+
+/* set() - Replaces the point at 'index' ------------------------- */
+size_t PointTree::set(const int index, const CtrlPoint& point)
+{
+	assert(index >= 0 && index < size());
+
+	size_t bytes = 0;
+	int    local = index;
+
+	PointTreeNode *node = &makeUnique(root, bytes);
+	while( !node->isLeaf() )
+	{
+		size_t c = 0;
+		while( local >= node->children[c]->count )
+			local -= node->children[c++]->count;
+		node = &makeUnique(node->children[c], bytes);
+	}
+	node->points[local] = point;
+	return bytes;
+}
+
+/* insert() - Inserts a point before 'index', or at the end if it's size() */
+size_t PointTree::insert(const int index, const CtrlPoint& point)
+{
+	assert(index >= 0 && index <= size());
+
+	size_t bytes = 0;
+	if( !root )
+	{
+		root = make_shared<PointTreeNode>();
+		bytes += root->bytes();
+	}
+
+	PointTreeNodePtr split = insertAt(root, index, point, bytes);
+	if( split )
+	{
+		PointTreeNodePtr newRoot = make_shared<PointTreeNode>();
+		newRoot->children.push_back(root);
+		newRoot->children.push_back(split);
+		sumCounts(*newRoot);
+		bytes += newRoot->bytes();
+		root = newRoot;
+	}
+	return bytes;
+}
+
+/* erase() - Erases the point at 'index' ------------------------- */
+size_t PointTree::erase(const int index)
+{
+	assert(index >= 0 && index < size());
+
+	size_t bytes = 0;
+	eraseAt(root, index, bytes);
+
+	if( root->count == 0 )
+	{
+		root.reset();
+		return bytes;
+	}
+	while( !root->isLeaf() && root->children.size() == 1 )
+	{
+		PointTreeNodePtr child = root->children.front();
+		root = child;
+	}
+	return bytes;
+}
+
+/* diff() - Finds the indices of the points that differ between two */
+/* trees where one was made from the other by set() alone, in ---- */
+/* O(k log n) for k changed points since shared subtrees are skipped */
+/* Returns false if the trees don't have the same shape ---------- */
+bool PointTree::diff(const PointTree& a, const PointTree& b, vector<int>& changed)
+{
+	changed.clear();
+	if( !a.root || !b.root )
+		return a.size() == b.size();
+	return diffNodes(a.root.get(), b.root.get(), 0, changed);
+}
@@ -0,0 +1,166 @@
+/*
+ * Profiler.cpp
+ */
+#include "Profiler.h"
+
+#include <cstdio>
+#include <string>
+
+using std::string;
+
+// Map ProfileStage enum value to string representation
+std::string ProfileStageNames[] = {
+	"openglFrameSetup",
+	"drawScenery",
+	"drawCurve",
+	"drawTrain",
+	"shadows",
+	"pick",
+	"regenerateSegments",
+	"loadPoints",
+	"exportMesh",
+	"checkClearance",
+	"jobs"
+};
+
+
+/* ==================================================================
+ * Profiler class
+ * ==================================================================
+ */
+
+Profiler::Profiler()
+	: nextSample(0)
+	, frequency(1)
+	, epoch(0)
+	, lastSummarized(0)
+{
+	LARGE_INTEGER value;
+	QueryPerformanceFrequency(&value);
+	frequency = value.QuadPart;
+	QueryPerformanceCounter(&value);
+	epoch = value.QuadPart;
+
+	for(int i = 0; i < capacity; ++i)
+		samples[i].sequence = 0;
+	for(int i = 0; i < numProfileStages; ++i)
+		stageMs[i] = 0.f;
+}
+
+/* get() - Returns the single profiler instance ------------------ */
+Profiler& Profiler::get()
+{
+	static Profiler profiler;
+	return profiler;
+}
+
+/* now() - Returns the current performance counter value --------- */
+LONGLONG Profiler::now() const
+{
+	LARGE_INTEGER value;
+	QueryPerformanceCounter(&value);
+	return value.QuadPart;
+}
+
+/* record() - Stores a timing sample, safe to call from any thread */
+void Profiler::record(const ProfileStage stage, const LONGLONG start, const LONGLONG end)
+{
+	const long index = InterlockedIncrement(&nextSample) - 1;
+	Sample& sample   = samples[index & (capacity - 1)];
+
+	// Mark the slot as being written before touching its contents
+	InterlockedExchange(&sample.sequence, 0);
+	sample.stage    = stage;
+	sample.threadId = GetCurrentThreadId();
+	sample.start    = start;
+	sample.end      = end;
+	InterlockedExchange(&sample.sequence, index + 1);
+}
+
+/* readSample() - Copies sample 'index' out of the ring, false if --- */
+/* it isn't complete or was overwritten while it was being copied -- */
+bool Profiler::readSample(const long index, Sample& copy) const
+{
+	const Sample& sample = samples[index & (capacity - 1)];
+	if( sample.sequence != index + 1 )
+		return false;
+
+	copy.stage    = sample.stage;
+	copy.threadId = sample.threadId;
+	copy.start    = sample.start;
+	copy.end      = sample.end;
+
+	// A writer that claimed the slot meanwhile has cleared the sequence
+	MemoryBarrier();
+	if( sample.sequence != index + 1 )
+		return false;
+
+	return copy.stage >= 0 && copy.stage < numProfileStages;
+}
+
+/* summarizeFrame() - Totals the samples recorded since the last call */
+/* Stages that weren't hit keep their last measured time --------- */
+void Profiler::summarizeFrame()
+{
+	const long last = nextSample;
+	if( last - lastSummarized > capacity )
+		lastSummarized = last - capacity;
+
+	LONGLONG ticks[numProfileStages] = { 0 };
+	bool     seen [numProfileStages] = { false };
+
+	for(; lastSummarized < last; ++lastSummarized)
+	{
+		if( samples[lastSummarized & (capacity - 1)].sequence != lastSummarized + 1 )
+			break; // still being written, pick it up next frame
+
+		Sample sample;
+		if( !readSample(lastSummarized, sample) )
+			continue; // overwritten while it was read, it's lost
+
+		ticks[sample.stage] += sample.end - sample.start;
+		seen [sample.stage]  = true;
+	}
+
+	for(int i = 0; i < numProfileStages; ++i)
+	{
+		if( seen[i] )
+			stageMs[i] = static_cast<float>(1000.0 * ticks[i] / frequency);
+	}
+}
+
+/* writeChromeTrace() - Writes the samples in the ring as a Chrome trace */
+/* (load it in chrome://tracing) --------------------------------- */
+bool Profiler::writeChromeTrace(const string& filename) const
+{
+	FILE *file = nullptr;
+	if( fopen_s(&file, filename.c_str(), "w") != 0 || file == nullptr )
+		return false;
+
+	const long   last  = nextSample;
+	const long   first = (last > capacity) ? last - capacity : 0;
+	const double toUs  = 1000000.0 / frequency;
+
+	fprintf(file, "{\"traceEvents\":[");
+	bool firstEvent = true;
+	for(long i = first; i < last; ++i)
+	{
+		Sample sample;
+		if( !readSample(i, sample) )
+			continue;
+
+		fprintf(file, "%s\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%lu,"
+					  "\"ts\":%.3f,\"dur\":%.3f}",
+				firstEvent ? "" : ",",
+				ProfileStageNames[sample.stage].c_str(),
+				sample.threadId,
+				(sample.start - epoch) * toUs,
+				(sample.end - sample.start) * toUs);
+		firstEvent = false;
+	}
+	fprintf(file, "\n],\"displayTimeUnit\":\"ms\"}\n");
+
+	const bool ok = (ferror(file) == 0);
+	fclose(file);
+	return ok;
+}
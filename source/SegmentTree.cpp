@@ -0,0 +1,101 @@
+/*
+ * SegmentTree.cpp
+ */
+#include "SegmentTree.h"
+
+#include <algorithm>
+#include <vector>
+
+using std::vector;
+
+
+/* CenterLess - orders segment numbers by their box's center on an axis */
+struct CenterLess
+{
+	const vector<Vec3f>& centers;
+	const int axis;
+
+	CenterLess(const vector<Vec3f>& centers, const int axis) : centers(centers), axis(axis) { }
+	bool operator()(const int a, const int b) const { return centers[a].v()[axis] < centers[b].v()[axis]; }
+
+private:
+	CenterLess& operator=(const CenterLess&);
+};
+
+
+/* ==================================================================
+ * SegmentTree class
+ * ==================================================================
+ */
+SegmentTree::SegmentTree()
+	: nodes()
+	, order()
+	, centers()
+	, boxes(nullptr)
+{ }
+
+/* build() - Builds the tree over one box per segment ------------- */
+void SegmentTree::build(const vector<BoundingBox>& segmentBoxes)
+{
+	const int n = segmentBoxes.size();
+
+	nodes.clear();
+	order.resize(n);
+	centers.resize(n);
+	if( n == 0 )
+		return;
+
+	for(int i = 0; i < n; ++i)
+	{
+		centers[i] = segmentBoxes[i].center();
+		order[i]   = i;
+	}
+
+	boxes = &segmentBoxes;
+	nodes.reserve(2 * (n / maxLeafSegments + 1));
+	build(0, n);
+	boxes = nullptr;
+}
+
+/* clear() - Empties the tree ------------------------------------- */
+void SegmentTree::clear()
+{
+	nodes.clear();
+	order.clear();
+	centers.clear();
+}
+
+/* build() - Builds the subtree over order[first, first + count), -- */
+/* splitting at the median center along the longest axis, returns - */
+/* the node's index ---------------------------------------------- */
+int SegmentTree::build(const int first, const int count)
+{
+	const int index = nodes.size();
+	nodes.push_back(Node());
+
+	BoundingBox bounds;
+	for(int i = first; i < first + count; ++i)
+		bounds.add((*boxes)[order[i]]);
+
+	nodes[index].bounds = bounds;
+	nodes[index].left   = -1;
+	nodes[index].right  = -1;
+	nodes[index].first  = first;
+	nodes[index].count  = count;
+	if( count <= maxLeafSegments )
+		return index;
+
+	const Vec3f size(bounds.extents());
+	const int axis = (size.x() >= size.y() && size.x() >= size.z()) ? 0 : (size.y() >= size.z()) ? 1 : 2;
+
+	const int half = count / 2;
+	std::nth_element(order.begin() + first, order.begin() + first + half, order.begin() + first + count,
+					 CenterLess(centers, axis));
+
+	const int left  = build(first, half);
+	const int right = build(first + half, count - half);
+	nodes[index].left  = left;
+	nodes[index].right = right;
+	nodes[index].count = 0;
+	return index;
+}
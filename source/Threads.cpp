@@ -0,0 +1,70 @@
+/*
+ * Threads.cpp
+ */
+#include "Threads.h"
+#include "JobSystem.h"
+
+#include <process.h>
+#include <cassert>
+
+
+/* ==================================================================
+ * Thread class
+ * ==================================================================
+ */
+
+Thread::Thread()
+	: handle(NULL)
+	, function(nullptr)
+	, data(nullptr)
+{ }
+
+Thread::~Thread()
+{
+	join();
+}
+
+/* start() - Starts running the specified function on a new thread */
+void Thread::start(Function f, void *pData)
+{
+	assert(handle == NULL && f != nullptr);
+
+	function = f;
+	data     = pData;
+	handle   = reinterpret_cast<HANDLE>(
+		_beginthreadex(NULL, 0, &Thread::entryPoint, this, 0, NULL));
+}
+
+/* join() - Blocks until the thread's function has returned ------ */
+void Thread::join()
+{
+	if( handle == NULL )
+		return;
+
+	WaitForSingleObject(handle, INFINITE);
+	CloseHandle(handle);
+	handle = NULL;
+}
+
+/* entryPoint() - Called on the new thread, runs the thread function */
+unsigned __stdcall Thread::entryPoint(void *pThread)
+{
+	Thread *thread = reinterpret_cast<Thread*>(pThread);
+	thread->function(thread->data);
+	return 0;
+}
+
+// ---------------------------------------------------------------
+
+int numHardwareThreads()
+{
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return (info.dwNumberOfProcessors > 0) ? static_cast<int>(info.dwNumberOfProcessors) : 1;
+}
+
+// Runs on the job system's workers rather than starting threads each call
+void parallelFor(const int count, ParallelForFunction function, void *pData)
+{
+	JobSystem::get().parallelFor(count, function, pData);
+}
@@ -0,0 +1,528 @@
+/*
+ * TrackFile.cpp
+ */
+#include "TrackFile.h"
+#include "TrackParser.h"
+#include "Threads.h"
+
+#include <algorithm>
+#include <sstream>
+#include <cstring>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+using std::stringstream;
+using std::string;
+using std::vector;
+
+// Text tracks smaller than this aren't worth splitting up
+static const size_t minParallelTextBytes = 4 << 20;
+static const size_t minTextChunkBytes    = 1 << 20;
+
+
+// zlib ships inside fltkzlib.lib without its headers, so the few calls used are declared here
+extern "C"
+{
+	int           compress2(unsigned char *dest, unsigned long *destLen,
+							const unsigned char *source, unsigned long sourceLen, int level);
+	unsigned long compressBound(unsigned long sourceLen);
+	int           uncompress(unsigned char *dest, unsigned long *destLen,
+							 const unsigned char *source, unsigned long sourceLen);
+}
+static const int              zlibOk           = 0;  // Z_OK
+static const int              zlibDefaultLevel = -1; // Z_DEFAULT_COMPRESSION
+static const unsigned __int64 maxZlibBytes     = static_cast<unsigned long>(-1);
+
+
+/* throwNotATrackFile() - Throws the error for a malformed binary track */
+static void throwNotATrackFile(const string& filename)
+{
+	stringstream ss;
+	ss << "Error - " << filename << " is not a version 1 to "
+	   << trackFileVersion << " binary track file";
+	throw TrackFileError(ss.str());
+}
+
+/* packVectors() - Copies 'count' positions or orientations into 'out' as floats */
+/* Orientations are normalized, as the curve doesn't keep them so after edits */
+static void packVectors(const ControlPointVector& points, const size_t first, const size_t count,
+						const bool orientations, float *out)
+{
+	for(size_t i = 0; i < count; ++i, out += 3)
+	{
+		const Vec3f v(orientations ? normalize(points[first + i].orient()) : points[first + i].pos());
+		out[0] = v.x();
+		out[1] = v.y();
+		out[2] = v.z();
+	}
+}
+
+/* align() - Rounds 'offset' up to a multiple of 16 bytes ------- */
+static unsigned __int64 align(const unsigned __int64 offset)
+{
+	return (offset + 15) & ~static_cast<unsigned __int64>(15);
+}
+
+
+/* ==================================================================
+ * MappedFile class
+ * ==================================================================
+ */
+
+MappedFile::MappedFile(const string& filename)
+	: file(INVALID_HANDLE_VALUE)
+	, mapping(NULL)
+	, view(nullptr)
+	, size(0)
+{
+	file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+					   OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if( file == INVALID_HANDLE_VALUE )
+		throw TrackFileError("Error - failed to open file: " + filename);
+
+	LARGE_INTEGER fileSize;
+	if( !GetFileSizeEx(file, &fileSize)
+	 || static_cast<unsigned __int64>(fileSize.QuadPart) > static_cast<size_t>(-1) )
+	{
+		close();
+		throw TrackFileError("Error - bad file size: " + filename);
+	}
+	size = static_cast<size_t>(fileSize.QuadPart);
+
+	// Empty files can't be mapped, but there's nothing to map anyways
+	if( size == 0 )
+		return;
+
+	mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if( mapping != NULL )
+		view = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+	if( view == nullptr )
+	{
+		close();
+		throw TrackFileError("Error - failed to map file: " + filename);
+	}
+}
+
+MappedFile::~MappedFile()
+{
+	close();
+}
+
+/* close() - Unmaps the view and releases the file handles ------- */
+void MappedFile::close()
+{
+	if( view != nullptr )
+		UnmapViewOfFile(view);
+	if( mapping != NULL )
+		CloseHandle(mapping);
+	if( file != INVALID_HANDLE_VALUE )
+		CloseHandle(file);
+
+	view    = nullptr;
+	mapping = NULL;
+	file    = INVALID_HANDLE_VALUE;
+	size    = 0;
+}
+
+
+/* ==================================================================
+ * MappedTrack class
+ * ==================================================================
+ */
+
+MappedTrack::MappedTrack(const string& filename)
+	: file(filename)
+	, header(nullptr)
+	, positionData(nullptr)
+	, orientationData(nullptr)
+	, inflated()
+{
+	const size_t size = file.getSize();
+	if( size < trackFileV1Size )
+		throw TrackFileError("Error - bad track file size: " + filename);
+
+	// Validate the header against the size of the mapping,
+	// version 1 headers stop short of the curve settings
+	header = reinterpret_cast<const TrackFileHeader*>(file.data());
+
+	const unsigned int minHeaderSize = (header->version >= 2) ? sizeof(TrackFileHeader) : trackFileV1Size;
+	if( memcmp(header->magic, trackFileMagic, sizeof(trackFileMagic)) != 0
+	 || header->version < 1 || header->version > trackFileVersion
+	 || header->headerSize < minHeaderSize
+	 || header->headerSize > size
+	 || (header->version < 2 && header->flags != 0)
+	 || (header->version >= 2 && header->curveType > bspline)
+	 || header->positionsOffset < header->headerSize
+	 || header->positionsOffset > size )
+	{
+		throwNotATrackFile(filename);
+	}
+
+	if( header->flags & trackFileCompressed )
+	{
+		inflate(filename);
+		return;
+	}
+
+	const unsigned __int64 arrayBytes = header->numPoints * 3 * sizeof(float);
+	if( header->numPoints > size / (6 * sizeof(float))
+	 || header->orientationsOffset < header->headerSize
+	 || header->positionsOffset    % sizeof(float) != 0
+	 || header->orientationsOffset % sizeof(float) != 0
+	 || header->positionsOffset    > size - arrayBytes
+	 || header->orientationsOffset > size - arrayBytes )
+	{
+		throwNotATrackFile(filename);
+	}
+
+	positionData    = reinterpret_cast<const float*>(file.data() + header->positionsOffset);
+	orientationData = reinterpret_cast<const float*>(file.data() + header->orientationsOffset);
+}
+
+MappedTrack::~MappedTrack()
+{ }
+
+/* inflate() - Decompresses the point arrays out of the mapping -- */
+void MappedTrack::inflate(const string& filename)
+{
+	const unsigned __int64 payloadSize = header->payloadSize;
+	const unsigned __int64 numFloats   = header->numPoints * 6;
+
+	// zlib can't expand data by more than about 1032:1, which also
+	// keeps a bad point count from asking for a huge allocation
+	if( payloadSize > file.getSize() - header->positionsOffset
+	 || header->numPoints > (payloadSize * 1032) / (6 * sizeof(float)) + 1
+	 || numFloats * sizeof(float) > maxZlibBytes )
+	{
+		throwNotATrackFile(filename);
+	}
+
+	if( numFloats == 0 )
+		return;
+
+	inflated.resize(static_cast<size_t>(numFloats));
+
+	unsigned long inflatedSize = static_cast<unsigned long>(numFloats * sizeof(float));
+	const int result = uncompress(reinterpret_cast<unsigned char*>(&inflated[0]), &inflatedSize,
+		reinterpret_cast<const unsigned char*>(file.data() + header->positionsOffset),
+		static_cast<unsigned long>(payloadSize));
+	if( result != zlibOk || inflatedSize != numFloats * sizeof(float) )
+		throw TrackFileError("Error - corrupt compressed points in " + filename);
+
+	positionData    = &inflated[0];
+	orientationData = positionData + numPoints() * 3;
+}
+
+/* copyTo() - Replaces 'points' with the points in the mapping --- */
+/* writeBinaryTrackFile() normalizes orientations, so they're ----- */
+/* copied as-is (a file from elsewhere is trusted to do the same) - */
+void MappedTrack::copyTo(ControlPointVector& points) const
+{
+	const size_t n = numPoints();
+	const float *p = positions();
+	const float *o = orientations();
+
+	points.assign(n, CtrlPoint());
+	for(size_t i = 0; i < n; ++i, p += 3, o += 3)
+	{
+		points[i].pos   ().set(p[0], p[1], p[2]);
+		points[i].orient().set(o[0], o[1], o[2]);
+	}
+}
+
+
+// ---------------------------------------------------------------
+
+/* isBinaryTrackFile() - Checks the first bytes of a file for the magic number */
+bool isBinaryTrackFile(const string& filename)
+{
+	FILE *file = nullptr;
+	if( fopen_s(&file, filename.c_str(), "rb") != 0 || file == nullptr )
+		return false;
+
+	char magic[sizeof(trackFileMagic)];
+	const bool isBinary = fread(magic, sizeof(magic), 1, file) == 1
+					   && memcmp(magic, trackFileMagic, sizeof(magic)) == 0;
+	fclose(file);
+
+	return isBinary;
+}
+
+/* hasExtension() - True if 'filename' ends in 'extension', ignoring case */
+bool hasExtension(const string& filename, const string& extension)
+{
+	if( filename.size() < extension.size() )
+		return false;
+
+	string ending(filename.substr(filename.size() - extension.size()));
+	std::transform(ending.begin(), ending.end(), ending.begin(), ::tolower);
+	return ending == extension;
+}
+
+/* hasBinaryTrackExtension() - True if 'filename' ends in .trk or .trz */
+bool hasBinaryTrackExtension(const string& filename)
+{
+	return hasExtension(filename, trackFileExtension)
+		|| hasExtension(filename, trackFileCompressedExtension);
+}
+
+/* hasCompressedTrackExtension() - True if 'filename' ends in .trz */
+bool hasCompressedTrackExtension(const string& filename)
+{
+	return hasExtension(filename, trackFileCompressedExtension);
+}
+
+/* writeBinaryTrackFile() - Writes the curve's points and settings in the */
+/* binary track format, optionally zlib compressing the points --- */
+/* Throws TrackFileError on failure ------------------------------ */
+void writeBinaryTrackFile(const string& filename, const Curve& curve, const bool compress)
+{
+	writeBinaryTrackFile(filename, curve.getControlPoints(), curve.getCurveType(), curve.tension, compress);
+}
+
+void writeBinaryTrackFile(const string& filename, const ControlPointVector& points,
+						  const CurveType curveType, const float tension, const bool compress)
+{
+	const unsigned __int64 n          = points.size();
+	const unsigned __int64 arrayBytes = n * 3 * sizeof(float);
+
+	TrackFileHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, trackFileMagic, sizeof(trackFileMagic));
+	header.version            = trackFileVersion;
+	header.headerSize         = sizeof(TrackFileHeader);
+	header.flags              = compress ? trackFileCompressed : 0;
+	header.numPoints          = n;
+	header.positionsOffset    = align(sizeof(TrackFileHeader));
+	header.orientationsOffset = compress ? 0 : align(header.positionsOffset + arrayBytes);
+	header.curveType          = curveType;
+	header.tension            = tension;
+
+	// Compress the whole payload up front, since its size goes in the header
+	vector<unsigned char> payload;
+	if( compress )
+	{
+		if( 2 * arrayBytes > maxZlibBytes )
+			throw TrackFileError("Error - too many points to compress into \"" + filename + "\".");
+
+		// (one extra float keeps &arrays[0] valid for an empty curve)
+		vector<float> arrays(static_cast<size_t>(n * 6) + 1);
+		packVectors(points, 0, points.size(), false, &arrays[0]);
+		packVectors(points, 0, points.size(), true,  &arrays[points.size() * 3]);
+
+		const unsigned long sourceSize  = static_cast<unsigned long>(2 * arrayBytes);
+		unsigned long       payloadSize = compressBound(sourceSize);
+		payload.resize(payloadSize);
+		if( compress2(&payload[0], &payloadSize, reinterpret_cast<const unsigned char*>(&arrays[0]),
+					  sourceSize, zlibDefaultLevel) != zlibOk )
+		{
+			throw TrackFileError("Error - failed compressing points for \"" + filename + "\".");
+		}
+		payload.resize(payloadSize);
+		header.payloadSize = payloadSize;
+	}
+
+	FILE *file = nullptr;
+	if( fopen_s(&file, filename.c_str(), "wb") != 0 || file == nullptr )
+		throw TrackFileError("Error - failed to open file \"" + filename + "\" for writing.");
+
+	static const char padding[16] = { 0 };
+	bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+	ok = ok && fwrite(padding, 1, static_cast<size_t>(header.positionsOffset - sizeof(header)), file)
+			   == header.positionsOffset - sizeof(header);
+
+	if( compress )
+	{
+		ok = ok && fwrite(&payload[0], 1, payload.size(), file) == payload.size();
+	}
+	else
+	{
+		// Write each array through a small buffer so large tracks aren't copied whole
+		static const size_t bufferPoints = 4096;
+		float buffer[bufferPoints * 3];
+
+		for(int array = 0; array < 2 && ok; ++array)
+		{
+			if( array == 1 )
+			{
+				const size_t pad = static_cast<size_t>(
+					header.orientationsOffset - (header.positionsOffset + arrayBytes));
+				ok = fwrite(padding, 1, pad, file) == pad;
+			}
+
+			for(size_t first = 0; first < points.size() && ok; first += bufferPoints)
+			{
+				const size_t count = (std::min)(bufferPoints, points.size() - first);
+				packVectors(points, first, count, array == 1, buffer);
+				ok = fwrite(buffer, 3 * sizeof(float), count, file) == count;
+			}
+		}
+	}
+
+	ok = (fclose(file) == 0) && ok;
+	if( !ok )
+		throw TrackFileError("Error - failed writing file \"" + filename + "\".");
+}
+
+/* writeTextTrackFile() - Writes 'points' in the text track format */
+/* Throws TrackFileError on failure ------------------------------ */
+void writeTextTrackFile(const string& filename, const ControlPointVector& points)
+{
+	FILE *file = nullptr;
+	if( fopen_s(&file, filename.c_str(), "w") != 0 || file == nullptr )
+		throw TrackFileError("Error - failed to open file \"" + filename + "\" for writing.");
+
+	// Point count, then each point's position and orientation
+	bool ok = fprintf(file, "%u", static_cast<unsigned int>(points.size())) > 0;
+	for(size_t i = 0; i < points.size() && ok; ++i)
+	{
+		const Vec3f& p(points[i].pos());
+		const Vec3f& o(points[i].orient());
+		ok = fprintf(file, "\n%g %g %g %g %g %g ",
+					 p.x(), p.y(), p.z(), o.x(), o.y(), o.z()) > 0;
+	}
+
+	ok = (fclose(file) == 0) && ok;
+	if( !ok )
+		throw TrackFileError("Error - failed writing file \"" + filename + "\".");
+}
+
+// ---------------------------------------------------------------
+
+/* appendRows() - Converts every remaining row of 'parser' to a control point */
+static void appendRows(TrackParser& parser, ControlPointVector& points)
+{
+	TrackRow row;
+	while( parser.next(row) )
+	{
+		const Vec3f position(row.pos[0], row.pos[1], row.pos[2]);
+		const Vec3f orientation(row.orient[0], row.orient[1], row.orient[2]);
+		points.push_back(CtrlPoint(position, orientation));
+	}
+}
+
+struct TextChunk
+{
+	const char        *first;
+	const char        *last;
+	ControlPointVector points;
+	int                numLines;
+	bool               failed;
+};
+
+struct TextChunkJob
+{
+	const string      *filename;
+	vector<TextChunk> *chunks;
+	volatile long     *progress;  // may be nullptr
+	volatile long      numDone;
+};
+
+/* parseTextChunk() - parallelFor body, parses one chunk of a mapped text track */
+/* Line numbers are relative to the chunk, and errors are only flagged here */
+/* since they have to be reported relative to the whole file ----- */
+static void parseTextChunk(const int index, void *pJob)
+{
+	TextChunkJob& job   = *reinterpret_cast<TextChunkJob*>(pJob);
+	TextChunk&    chunk = (*job.chunks)[index];
+
+	try {
+		TrackParser parser(*job.filename, chunk.first, chunk.last, 0, index == 0);
+		appendRows(parser, chunk.points);
+		chunk.numLines = parser.linesRead();
+	} catch(...) {
+		chunk.failed = true;
+	}
+
+	if( job.progress != nullptr )
+	{
+		const long numDone = InterlockedIncrement(&job.numDone);
+		InterlockedExchange(job.progress, 1000 * numDone / static_cast<long>(job.chunks->size()));
+	}
+}
+
+/* readTextChunks() - Parses a mapped text track on all cores ------ */
+/* The file is split into newline aligned chunks, which are joined in order */
+static void readTextChunks(const string& filename, const char *data, const size_t size,
+						   ControlPointVector& points, volatile long *progress)
+{
+	// A few chunks per thread keeps the threads busy if some lines are longer
+	const size_t chunkSize = (std::max)(size / (numHardwareThreads() * 4), minTextChunkBytes);
+
+	vector<TextChunk> chunks;
+	for(size_t begin = 0; begin < size; )
+	{
+		size_t end = (std::min)(begin + chunkSize, size);
+		const char *newline = static_cast<const char*>(memchr(data + end - 1, '\n', size - end + 1));
+		end = (newline != nullptr) ? (newline - data) + 1 : size;
+
+		TextChunk chunk;
+		chunk.first    = data + begin;
+		chunk.last     = data + end;
+		chunk.numLines = 0;
+		chunk.failed   = false;
+		chunks.push_back(chunk);
+
+		begin = end;
+	}
+
+	TextChunkJob job = { &filename, &chunks, progress, 0 };
+	parallelFor(static_cast<int>(chunks.size()), &parseTextChunk, &job);
+
+	size_t numPoints = 0;
+	int    firstLine = 0;
+	for(size_t i = 0; i < chunks.size(); ++i)
+	{
+		TextChunk& chunk = chunks[i];
+
+		// Parse a bad chunk again knowing its first line, so the
+		// error reports the right line of the file
+		if( chunk.failed )
+		{
+			chunk.points.clear();
+			TrackParser parser(filename, chunk.first, chunk.last, firstLine, i == 0);
+			appendRows(parser, chunk.points);
+			chunk.numLines = parser.linesRead() - firstLine;
+		}
+
+		numPoints += chunk.points.size();
+		firstLine += chunk.numLines;
+	}
+
+	ControlPointVector newPoints;
+	newPoints.reserve(numPoints);
+	for each(auto& chunk in chunks)
+	{
+		newPoints.insert(newPoints.end(), chunk.points.begin(), chunk.points.end());
+		ControlPointVector().swap(chunk.points);
+	}
+	points.swap(newPoints);
+}
+
+/* readTextTrackFile() - Replaces 'points' with the points in a text track */
+/* If given, 'progress' is set to the thousandths of the file parsed so far */
+/* Throws TrackParseError if the file can't be read or is malformed */
+void readTextTrackFile(const string& filename, ControlPointVector& points, volatile long *progress)
+{
+	try {
+		MappedFile file(filename);
+		if( file.getSize() >= minParallelTextBytes && numHardwareThreads() > 1 )
+		{
+			readTextChunks(filename, file.data(), file.getSize(), points, progress);
+			return;
+		}
+	} catch(TrackFileError&) {
+		// Couldn't be mapped whole (e.g. out of address space), stream it instead
+	}
+
+	TrackParser parser(filename);
+
+	ControlPointVector newPoints;
+	newPoints.reserve(parser.pointsToReserve());
+	appendRows(parser, newPoints);
+	points.swap(newPoints);
+
+	if( progress != nullptr )
+		InterlockedExchange(progress, 1000);
+}
@@ -0,0 +1,598 @@
+/*
+ * TrackFitter.cpp
+ */
+#include "TrackFitter.h"
+#include "Threads.h"
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+#include <vector>
+
+using std::vector;
+using std::pair;
+
+
+const float TrackFitter::defaultTolerance = 0.1f;
+const float TrackFitter::defaultTension   = 0.5f;
+const int   TrackFitter::maxRounds        = 8;
+
+static const int    chunkSamples    = 1 << 16;  // decimated as a unit
+static const int    chunksPerThread = 4;
+static const int    maxIterations   = 200;      // of conjugate gradients
+static const double solveTolerance  = 1e-7;     // residual, relative to the right hand side
+static const float  ridgeScale      = 1e-6f;    // keeps the normal equations positive definite
+static const int    correctionPasses = 3;       // of fitting and reparameterizing per round
+static const int    newtonSteps     = 3;        // per sample, per reparameterization
+
+
+/* distanceSq() - Squared distance from 'p' to the line from 'a' to 'b' */
+static float distanceSq(const Vec3f& p, const Vec3f& a, const Vec3f& b)
+{
+	float d[3], ap[3];
+	float dd = 0.f, apd = 0.f;
+	for(int axis = 0; axis < 3; ++axis)
+	{
+		d[axis]  = b.v()[axis] - a.v()[axis];
+		ap[axis] = p.v()[axis] - a.v()[axis];
+		dd  += d[axis] * d[axis];
+		apd += ap[axis] * d[axis];
+	}
+
+	const float t = (dd > 0.f) ? (std::min)(1.f, (std::max)(0.f, apd / dd)) : 0.f;
+
+	float sum = 0.f;
+	for(int axis = 0; axis < 3; ++axis)
+	{
+		const float e = ap[axis] - t * d[axis];
+		sum += e * e;
+	}
+	return sum;
+}
+
+/* distance() - Distance between 'a' and 'b' ---------------------- */
+static float distance(const Vec3f& a, const Vec3f& b)
+{
+	return magnitude(difference(a, b));
+}
+
+
+/* ==================================================================
+ * TrackFitter class
+ * ==================================================================
+ */
+TrackFitter::TrackFitter(const CurveType type, const float tolerance, const float tension)
+	: type(type)
+	, tension(tension)
+	, tolerance(tolerance)
+	, samples(nullptr)
+	, numSamples(0)
+	, keep()
+	, kept()
+	, fresh()
+	, params()
+	, sums()
+	, errors()
+	, worst()
+	, numChunks(0)
+	, numRounds(0)
+	, maxError(0.f)
+{
+	segmentBasis(type, tension, basis);
+}
+
+/* sample() - Position of a sample, 'numSamples' is the loop's end */
+inline const Vec3f& TrackFitter::sample(const int index) const
+{
+	return (*samples)[(index < numSamples) ? index : 0].pos();
+}
+
+/* weightsAt() - The weights of a segment's control points --------- */
+/* (previous, start, end, next) at t ------------------------------- */
+inline void TrackFitter::weightsAt(const float t, float w[4]) const
+{
+	for(int k = 0; k < 4; ++k)
+		w[k] = ((basis[k][3] * t + basis[k][2]) * t + basis[k][1]) * t + basis[k][0];
+}
+
+/* fit() - Replaces 'points' with a curve of this fitter's type --- */
+/* that follows 'polyline' (a closed loop) within the tolerance, --- */
+/* if it can in maxRounds ------------------------------------------ */
+void TrackFitter::fit(const ControlPointVector& polyline, ControlPointVector& points)
+{
+	samples    = &polyline;
+	numSamples = polyline.size();
+	numRounds  = 0;
+	maxError   = 0.f;
+
+	// A loop that repeats its first sample at the end closes itself
+	if( numSamples > 1 && distance(polyline.front().pos(), polyline.back().pos()) == 0.f )
+		--numSamples;
+
+	if( numSamples < 4 )
+	{
+		ControlPointVector(polyline.begin(), polyline.begin() + numSamples).swap(points);
+		return;
+	}
+
+	decimate();
+
+	const int maxThreads = numHardwareThreads();
+	for(int axis = 0; axis < 3; ++axis)
+	{
+		fitted[axis].resize(kept.size());
+		for(size_t i = 0; i < kept.size(); ++i)
+			fitted[axis][i] = sample(kept[i]).v()[axis];
+	}
+
+	// Splitting can leave a round worse than the one before, so the
+	// closest round is kept
+	vector<int>   bestKept;
+	vector<float> bestFitted[3];
+	float         bestError = 0.f;
+
+	params.resize(numSamples);
+	fresh.assign(kept.size(), 1);
+	for(;;)
+	{
+		const int n = kept.size();
+		numChunks = (std::min)(n, chunksPerThread * maxThreads);
+		++numRounds;
+
+		// New spans start with their samples spread by length along them
+		parallelFor(numChunks, &TrackFitter::spreadTask, this);
+
+		errors.resize(n);
+		worst.resize(n);
+		if( type == lines )
+			parallelFor(numChunks, &TrackFitter::measureTask, this);
+
+		// Fitting moves the curve, so move each sample's parameter to
+		// where the curve is now closest and fit again
+		for(int pass = 0; type != lines && pass < correctionPasses; ++pass)
+		{
+			sums.resize(n);
+			parallelFor(numChunks, &TrackFitter::sumTask, this);
+			solve();
+			parallelFor(numChunks, &TrackFitter::measureTask, this);
+		}
+		maxError = *std::max_element(errors.begin(), errors.end());
+
+		if( bestKept.empty() || maxError < bestError )
+		{
+			bestKept  = kept;
+			bestError = maxError;
+			for(int axis = 0; axis < 3; ++axis)
+				bestFitted[axis] = fitted[axis];
+		}
+
+		if( maxError <= tolerance || numRounds == maxRounds )
+			break;
+
+		// Split the spans that are still too far away at their worst sample,
+		// kept away from the span's ends so neither half is left with
+		// too few samples to fit. Everything else starts from where it
+		// was fitted
+		vector<int>   newKept;
+		vector<char>  newFresh;
+		vector<float> newFitted[3];
+		for(int span = 0; span < n; ++span)
+		{
+			const int first  = kept[span];
+			const int last   = (span + 1 < n) ? kept[span + 1] : numSamples;
+			const int margin = (last - first) / 4;
+			const bool split = errors[span] > tolerance && margin > 0;
+			const int  at    = (std::min)(last - margin, (std::max)(first + margin, worst[span]));
+
+			newKept.push_back(kept[span]);
+			newFresh.push_back(split);
+			for(int axis = 0; axis < 3; ++axis)
+				newFitted[axis].push_back(fitted[axis][span]);
+
+			if( split )
+			{
+				newKept.push_back(at);
+				newFresh.push_back(1);
+				for(int axis = 0; axis < 3; ++axis)
+					newFitted[axis].push_back(sample(at).v()[axis]);
+			}
+		}
+
+		if( newKept.size() == kept.size() )
+			break;
+
+		kept.swap(newKept);
+		fresh.swap(newFresh);
+		for(int axis = 0; axis < 3; ++axis)
+			fitted[axis].swap(newFitted[axis]);
+	}
+
+	if( bestError < maxError )
+	{
+		kept.swap(bestKept);
+		maxError = bestError;
+		for(int axis = 0; axis < 3; ++axis)
+			fitted[axis].swap(bestFitted[axis]);
+	}
+
+	ControlPointVector newPoints;
+	newPoints.reserve(kept.size());
+	for(size_t i = 0; i < kept.size(); ++i)
+	{
+		const Vec3f pos(fitted[0][i], fitted[1][i], fitted[2][i]);
+		newPoints.push_back(CtrlPoint(pos, (*samples)[kept[i]].orient()));
+	}
+	points.swap(newPoints);
+
+	samples = nullptr;
+}
+
+/* decimate() - Keeps the samples Douglas-Peucker needs to hold ---- */
+/* the polyline within the tolerance, a chunk at a time in parallel */
+void TrackFitter::decimate()
+{
+	keep.assign(numSamples + 1, 0);
+	keep[0] = keep[numSamples] = 1;
+
+	numChunks = (numSamples + chunkSamples - 1) / chunkSamples;
+	parallelFor(numChunks, &TrackFitter::decimateTask, this);
+
+	kept.clear();
+	for(int i = 0; i < numSamples; ++i)
+	{
+		if( keep[i] )
+			kept.push_back(i);
+	}
+
+	// Curves need four points, split the longest spans until there are
+	while( kept.size() < 4 )
+	{
+		size_t longest = 0;
+		int    longestCount = 0;
+		for(size_t span = 0; span < kept.size(); ++span)
+		{
+			const int end   = (span + 1 < kept.size()) ? kept[span + 1] : numSamples;
+			const int count = end - kept[span];
+			if( count > longestCount )
+			{
+				longest      = span;
+				longestCount = count;
+			}
+		}
+		kept.insert(kept.begin() + longest + 1, kept[longest] + longestCount / 2);
+	}
+}
+
+/* decimateTask() - parallelFor task, decimates one chunk --------- */
+void TrackFitter::decimateTask(const int index, void *pFitter)
+{
+	TrackFitter *fitter = reinterpret_cast<TrackFitter*>(pFitter);
+
+	const int first = index * chunkSamples;
+	const int last  = (std::min)(first + chunkSamples, fitter->numSamples);
+	fitter->decimateChunk(first, last);
+}
+
+/* decimateChunk() - Douglas-Peucker on samples [first,last], both - */
+/* of which are kept ----------------------------------------------- */
+void TrackFitter::decimateChunk(const int first, const int last)
+{
+	const float toleranceSq = tolerance * tolerance;
+
+	keep[first] = keep[last] = 1;
+
+	// Explicit stack, a million samples could recurse too deeply
+	vector< pair<int, int> > spans;
+	spans.push_back(std::make_pair(first, last));
+	while( !spans.empty() )
+	{
+		const int a = spans.back().first;
+		const int b = spans.back().second;
+		spans.pop_back();
+
+		int   farthest   = -1;
+		float farthestSq = toleranceSq;
+		for(int i = a + 1; i < b; ++i)
+		{
+			const float d = distanceSq(sample(i), sample(a), sample(b));
+			if( d > farthestSq )
+			{
+				farthest   = i;
+				farthestSq = d;
+			}
+		}
+
+		if( farthest < 0 )
+			continue;
+
+		keep[farthest] = 1;
+		spans.push_back(std::make_pair(a, farthest));
+		spans.push_back(std::make_pair(farthest, b));
+	}
+}
+
+/* spreadTask() - parallelFor task, spreads the samples of the new - */
+/* spans in one chunk ---------------------------------------------- */
+void TrackFitter::spreadTask(const int index, void *pFitter)
+{
+	TrackFitter *fitter = reinterpret_cast<TrackFitter*>(pFitter);
+
+	const int n     = fitter->kept.size();
+	const int first = static_cast<int>(static_cast<__int64>(n) * index       / fitter->numChunks);
+	const int last  = static_cast<int>(static_cast<__int64>(n) * (index + 1) / fitter->numChunks);
+	for(int span = first; span < last; ++span)
+	{
+		if( fitter->fresh[span] )
+			fitter->spreadSpan(span);
+	}
+}
+
+/* sumTask() - parallelFor task, sums one chunk of spans ---------- */
+void TrackFitter::sumTask(const int index, void *pFitter)
+{
+	TrackFitter *fitter = reinterpret_cast<TrackFitter*>(pFitter);
+
+	const int n     = fitter->kept.size();
+	const int first = static_cast<int>(static_cast<__int64>(n) * index       / fitter->numChunks);
+	const int last  = static_cast<int>(static_cast<__int64>(n) * (index + 1) / fitter->numChunks);
+	for(int span = first; span < last; ++span)
+		fitter->sumSpan(span);
+}
+
+/* measureTask() - parallelFor task, measures one chunk of spans -- */
+void TrackFitter::measureTask(const int index, void *pFitter)
+{
+	TrackFitter *fitter = reinterpret_cast<TrackFitter*>(pFitter);
+
+	const int n     = fitter->kept.size();
+	const int first = static_cast<int>(static_cast<__int64>(n) * index       / fitter->numChunks);
+	const int last  = static_cast<int>(static_cast<__int64>(n) * (index + 1) / fitter->numChunks);
+	for(int span = first; span < last; ++span)
+		fitter->measureSpan(span);
+}
+
+/* spreadSpan() - Places each of a span's samples at its length --- */
+/* along the span -------------------------------------------------- */
+void TrackFitter::spreadSpan(const int span)
+{
+	const int first = kept[span];
+	const int last  = (span + 1 < static_cast<int>(kept.size())) ? kept[span + 1] : numSamples;
+
+	// Spans can run over many samples, so the lengths are summed in doubles
+	double length = 0.0;
+	for(int i = first; i < last; ++i)
+		length += distance(sample(i + 1), sample(i));
+
+	double along = 0.0;
+	for(int i = first; i < last; ++i)
+	{
+		params[i] = (length > 0.0) ? static_cast<float>(along / length) : 0.f;
+		along += distance(sample(i + 1), sample(i));
+	}
+}
+
+/* sumSpan() - Sums the least squares terms of a span's samples ---- */
+void TrackFitter::sumSpan(const int span)
+{
+	const int first = kept[span];
+	const int last  = (span + 1 < static_cast<int>(kept.size())) ? kept[span + 1] : numSamples;
+
+	SpanSums& s = sums[span];
+	std::fill(&s.weights[0][0],   &s.weights[0][0]   + 16, 0.0);
+	std::fill(&s.positions[0][0], &s.positions[0][0] + 12, 0.0);
+
+	for(int i = first; i < last; ++i)
+	{
+		float w[4];
+		weightsAt(params[i], w);
+
+		const float *p = sample(i).v();
+		for(int r = 0; r < 4; ++r)
+		{
+			for(int c = 0; c < 4; ++c)
+				s.weights[r][c] += static_cast<double>(w[r]) * w[c];
+			for(int axis = 0; axis < 3; ++axis)
+				s.positions[r][axis] += static_cast<double>(w[r]) * p[axis];
+		}
+	}
+}
+
+/* spanCubic() - The span's fitted cubic, c[axis][j] is the ------- */
+/* coefficient of t^j ---------------------------------------------- */
+void TrackFitter::spanCubic(const int span, float c[3][4]) const
+{
+	const int n = kept.size();
+	const int index[4] = { (span + n - 1) % n, span, (span + 1) % n, (span + 2) % n };
+	for(int axis = 0; axis < 3; ++axis)
+	{
+		for(int j = 0; j < 4; ++j)
+		{
+			c[axis][j] = 0.f;
+			for(int k = 0; k < 4; ++k)
+				c[axis][j] += basis[k][j] * fitted[axis][index[k]];
+		}
+	}
+}
+
+/* closest() - Moves 't' toward where cubic 'c' is closest to 'q' -- */
+/* and returns the squared distance there -------------------------- */
+float TrackFitter::closest(const float c[3][4], const float q[3], float& t)
+{
+	// Newton's method on (p(t) - q).p'(t), as TrackProjector does
+	float gapSq = 0.f;
+	for(int step = 0; ; ++step)
+	{
+		float f = 0.f, speedSq = 0.f, bend = 0.f;
+		gapSq = 0.f;
+		for(int axis = 0; axis < 3; ++axis)
+		{
+			const float *ca = c[axis];
+			const float d  = ((ca[3] * t + ca[2]) * t + ca[1]) * t + ca[0] - q[axis];
+			const float d1 = (3.f * ca[3] * t + 2.f * ca[2]) * t + ca[1];
+			const float d2 = 6.f * ca[3] * t + 2.f * ca[2];
+			f       += d * d1;
+			speedSq += d1 * d1;
+			bend    += d * d2;
+			gapSq   += d * d;
+		}
+
+		const float df = (speedSq + bend > 0.f) ? speedSq + bend : speedSq;
+		if( step == newtonSteps || df <= 0.f )
+			return gapSq;
+		t = (std::min)(1.f, (std::max)(0.f, t - f / df));
+	}
+}
+
+/* measureSpan() - Moves each of the span's samples to where the --- */
+/* fitted curve is closest to it, and finds the furthest ----------- */
+void TrackFitter::measureSpan(const int span)
+{
+	const int n     = kept.size();
+	const int first = kept[span];
+	const int last  = (span + 1 < n) ? kept[span + 1] : numSamples;
+
+	errors[span] = 0.f;
+	worst[span]  = first;
+
+	if( type == lines )
+	{
+		// The chord between kept samples, whatever their spacing
+		for(int i = first + 1; i < last; ++i)
+		{
+			const float d = std::sqrt(distanceSq(sample(i), sample(first), sample(last)));
+			if( d > errors[span] )
+			{
+				errors[span] = d;
+				worst[span]  = i;
+			}
+		}
+		return;
+	}
+
+	float c[3][4], before[3][4], after[3][4];
+	spanCubic(span, c);
+	spanCubic((span + n - 1) % n, before);
+	spanCubic((span + 1) % n, after);
+
+	for(int i = first; i < last; ++i)
+	{
+		const float *q = sample(i).v();
+		float gapSq = closest(c, q, params[i]);
+
+		// A sample held at an end of its span may be closer to the
+		// next span over, which is what its distance to the track is
+		if( params[i] == 0.f )
+		{
+			float t = 1.f;
+			gapSq = (std::min)(gapSq, closest(before, q, t));
+		}
+		else if( params[i] == 1.f )
+		{
+			float t = 0.f;
+			gapSq = (std::min)(gapSq, closest(after, q, t));
+		}
+
+		const float d = std::sqrt(gapSq);
+		if( d > errors[span] )
+		{
+			errors[span] = d;
+			worst[span]  = i;
+		}
+	}
+}
+
+/* multiply() - y = (A'A + ridge I) x, from each span's sums ------- */
+void TrackFitter::multiply(const double ridge, const vector<double>& x, vector<double>& y) const
+{
+	const int n = kept.size();
+	for(int i = 0; i < n; ++i)
+		y[i] = ridge * x[i];
+
+	for(int span = 0; span < n; ++span)
+	{
+		const int index[4] = { (span + n - 1) % n, span, (span + 1) % n, (span + 2) % n };
+		const SpanSums& s = sums[span];
+		for(int r = 0; r < 4; ++r)
+		{
+			double sum = 0.0;
+			for(int c = 0; c < 4; ++c)
+				sum += s.weights[r][c] * x[index[c]];
+			y[index[r]] += sum;
+		}
+	}
+}
+
+/* solve() - Solves the normal equations for each axis by ---------- */
+/* conjugate gradients, starting from the current fit -------------- */
+void TrackFitter::solve()
+{
+	const int n = kept.size();
+
+	// A small ridge toward the current fit, for spans with few samples
+	double trace = 0.0;
+	for(int span = 0; span < n; ++span)
+	{
+		for(int k = 0; k < 4; ++k)
+			trace += sums[span].weights[k][k];
+	}
+	const double ridge = ridgeScale * trace / n;
+
+	vector<double> x(n), b(n), r(n), p(n), ap(n);
+	for(int axis = 0; axis < 3; ++axis)
+	{
+		for(int i = 0; i < n; ++i)
+		{
+			x[i] = fitted[axis][i];
+			b[i] = ridge * x[i];
+		}
+		for(int span = 0; span < n; ++span)
+		{
+			const int index[4] = { (span + n - 1) % n, span, (span + 1) % n, (span + 2) % n };
+			for(int k = 0; k < 4; ++k)
+				b[index[k]] += sums[span].positions[k][axis];
+		}
+
+		double bb = 0.0;
+		for(int i = 0; i < n; ++i)
+			bb += b[i] * b[i];
+
+		multiply(ridge, x, ap);
+		double rr = 0.0;
+		for(int i = 0; i < n; ++i)
+		{
+			r[i] = b[i] - ap[i];
+			p[i] = r[i];
+			rr  += r[i] * r[i];
+		}
+
+		for(int iteration = 0; iteration < maxIterations; ++iteration)
+		{
+			if( rr <= solveTolerance * solveTolerance * bb )
+				break;
+
+			multiply(ridge, p, ap);
+			double pap = 0.0;
+			for(int i = 0; i < n; ++i)
+				pap += p[i] * ap[i];
+			if( pap <= 0.0 )
+				break;
+
+			const double alpha = rr / pap;
+			double next = 0.0;
+			for(int i = 0; i < n; ++i)
+			{
+				x[i] += alpha * p[i];
+				r[i] -= alpha * ap[i];
+				next += r[i] * r[i];
+			}
+
+			const double beta = next / rr;
+			for(int i = 0; i < n; ++i)
+				p[i] = r[i] + beta * p[i];
+			rr = next;
+		}
+
+		for(int i = 0; i < n; ++i)
+			fitted[axis][i] = static_cast<float>(x[i]);
+	}
+}
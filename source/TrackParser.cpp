@@ -0,0 +1,380 @@
+/*
+ * TrackParser.cpp
+ */
+#include "TrackParser.h"
+
+#include <algorithm>
+#include <sstream>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+using std::stringstream;
+using std::string;
+
+
+// Powers of ten that are exactly representable as doubles
+static const double powersOfTen[] = {
+	1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+static const int maxExactPower = 22;
+
+// And as floats
+static const float floatPowersOfTen[] = {
+	1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f
+};
+static const int maxExactFloatPower = 10;
+
+// The shortest line a point can take ("0 0 0\n"), and a count no track
+// could ever reach, which bounds the count line of a chunk
+static const size_t minBytesPerPoint = 6;
+static const double maxPointCount    = 2147483647.0;
+
+static inline bool isDigit(const char c)      { return c >= '0' && c <= '9'; }
+static inline bool isSeparator(const char c)  { return c <= ' ' || c == '#'; }
+
+
+/* parseFloat() - Converts the number at the start of [first,last) */
+/* Returns the end of the number, or 'first' if there wasn't one - */
+/* Decimals of up to 7 digits (which is every number our tracks hold) */
+/* are correctly rounded: one float multiply or divide of two exact -- */
+/* floats. Up to 19 digits are exact as doubles but then rounded again */
+/* to float, which can be one ulp off strtof in rare halfway cases, -- */
+/* and anything else goes through strtod the same way -------------- */
+const char* parseFloat(const char *first, const char *last, float& value)
+{
+	const char *p = first;
+
+	bool negative = false;
+	if( p != last && (*p == '-' || *p == '+') )
+	{
+		negative = (*p == '-');
+		++p;
+	}
+
+	unsigned __int64 mantissa  = 0;
+	int              exponent  = 0;
+	int              numDigits = 0; // significant digits in mantissa
+	bool             anyDigits = false;
+	bool             truncated = false;
+
+	for(; p != last && isDigit(*p); ++p)
+	{
+		anyDigits = true;
+		if( numDigits < 19 )
+		{
+			mantissa = mantissa * 10 + (*p - '0');
+			if( mantissa != 0 )
+				++numDigits;
+		}
+		else
+		{
+			truncated = true;
+		}
+	}
+
+	if( p != last && *p == '.' )
+	{
+		for(++p; p != last && isDigit(*p); ++p)
+		{
+			anyDigits = true;
+			if( numDigits < 19 )
+			{
+				mantissa = mantissa * 10 + (*p - '0');
+				if( mantissa != 0 )
+					++numDigits;
+				--exponent;
+			}
+			else
+			{
+				truncated = true;
+			}
+		}
+	}
+
+	if( anyDigits && p != last && (*p == 'e' || *p == 'E') )
+	{
+		// Only consume the exponent if it has digits, like strtod
+		const char *e = p + 1;
+		bool negativeExponent = false;
+		if( e != last && (*e == '-' || *e == '+') )
+		{
+			negativeExponent = (*e == '-');
+			++e;
+		}
+
+		if( e != last && isDigit(*e) )
+		{
+			int explicitExponent = 0;
+			for(; e != last && isDigit(*e); ++e)
+			{
+				if( explicitExponent < 10000 )
+					explicitExponent = explicitExponent * 10 + (*e - '0');
+			}
+			exponent += negativeExponent ? -explicitExponent : explicitExponent;
+			p = e;
+		}
+	}
+
+	// Even evaluated in double or x87 precision, a single operation on
+	// floats rounds to the same float, the wider format being more than
+	// twice as precise
+	if( anyDigits && !truncated
+	 && mantissa <= (static_cast<unsigned __int64>(1) << 24)
+	 && exponent >= -maxExactFloatPower && exponent <= maxExactFloatPower )
+	{
+		float result = static_cast<float>(mantissa);
+		result = (exponent < 0) ? result / floatPowersOfTen[-exponent]
+								: result * floatPowersOfTen[exponent];
+		value = negative ? -result : result;
+		return p;
+	}
+
+	if( anyDigits && !truncated
+	 && mantissa <= (static_cast<unsigned __int64>(1) << 53)
+	 && exponent >= -maxExactPower && exponent <= maxExactPower )
+	{
+		double result = static_cast<double>(mantissa);
+		result = (exponent < 0) ? result / powersOfTen[-exponent]
+								: result * powersOfTen[exponent];
+		value = static_cast<float>(negative ? -result : result);
+		return p;
+	}
+
+	// Slow path: long or extreme numbers, inf and nan
+	const char *tokenEnd = first;
+	while( tokenEnd != last && !isSeparator(*tokenEnd) )
+		++tokenEnd;
+
+	const string token(first, tokenEnd);
+	char *parsedEnd = nullptr;
+	const double result = strtod(token.c_str(), &parsedEnd);
+	if( parsedEnd == token.c_str() )
+		return first;
+
+	value = static_cast<float>(result);
+	return first + (parsedEnd - token.c_str());
+}
+
+
+/* ==================================================================
+ * TrackParser class
+ * ==================================================================
+ */
+
+TrackParser::TrackParser(const string& filename)
+	: filename(filename)
+	, file(nullptr)
+	, buffer(bufferSize)
+	, cursor(nullptr)
+	, limit(nullptr)
+	, atEof(false)
+	, lineNumber(0)
+	, expected(0)
+	, maxExpected(maxPointCount)
+	, pending()
+	, hasPending(false)
+{
+	cursor = limit = &buffer[0];
+
+	if( fopen_s(&file, filename.c_str(), "rb") != 0 || file == nullptr )
+	{
+		file = nullptr;
+		throw TrackParseError("Error - failed to open file: " + filename, 0);
+	}
+
+	// Read ahead to the first point, so the count line (if any) is known up front
+	try {
+		if( _fseeki64(file, 0, SEEK_END) == 0 )
+		{
+			const __int64 size = _ftelli64(file);
+			if( size >= 0 )
+				maxExpected = (std::min)(maxExpected, static_cast<double>(size / minBytesPerPoint));
+		}
+		if( _fseeki64(file, 0, SEEK_SET) != 0 )
+			error("seek failed");
+
+		hasPending = readRow(pending, true);
+	} catch(...) {
+		fclose(file);
+		throw;
+	}
+}
+
+/* Parses [first,last) as though it started on line firstLine+1 of 'filename' */
+TrackParser::TrackParser(const string& filename, const char *first, const char *last,
+						 const int firstLine, const bool allowCount)
+	: filename(filename)
+	, file(nullptr)
+	, buffer()
+	, cursor(first)
+	, limit(last)
+	, atEof(true)
+	, lineNumber(firstLine)
+	, expected(0)
+	, maxExpected(maxPointCount)
+	, pending()
+	, hasPending(false)
+{
+	hasPending = readRow(pending, allowCount);
+}
+
+TrackParser::~TrackParser()
+{
+	if( file != nullptr )
+		fclose(file);
+}
+
+/* next() - Gets the next point in the file ---------------------- */
+/* Returns false at the end of the file -------------------------- */
+bool TrackParser::next(TrackRow& row)
+{
+	if( hasPending )
+	{
+		row        = pending;
+		hasPending = false;
+		return true;
+	}
+	return readRow(row, false);
+}
+
+/* readRow() - Parses lines until one holds a point -------------- */
+/* The first non-empty line may instead be the point count ------- */
+bool TrackParser::readRow(TrackRow& row, bool allowCount)
+{
+	const char *first = nullptr;
+	const char *last  = nullptr;
+	float values[6];
+
+	while( nextLine(first, last) )
+	{
+		const int numValues = parseLine(first, last, values, 6);
+		if( numValues == 0 )
+			continue;
+
+		if( numValues == 1 && allowCount )
+		{
+			if( values[0] < 0.f )
+				error("the point count can't be negative");
+			if( values[0] != std::floor(values[0]) )
+				error("the point count has to be a whole number");
+			if( values[0] > maxExpected )
+				error("the point count is more than the file could hold");
+			expected   = static_cast<size_t>(values[0]);
+			allowCount = false;
+			continue;
+		}
+
+		if( numValues != 3 && numValues != 6 )
+		{
+			stringstream ss;
+			ss << "expected 3 or 6 numbers but found " << numValues;
+			error(ss.str());
+		}
+
+		row.pos[0] = values[0];
+		row.pos[1] = values[1];
+		row.pos[2] = values[2];
+		if( numValues == 6 )
+		{
+			row.orient[0] = values[3];
+			row.orient[1] = values[4];
+			row.orient[2] = values[5];
+		} else {
+			row.orient[0] = 0.f;
+			row.orient[1] = 1.f;
+			row.orient[2] = 0.f;
+		}
+		row.line = lineNumber;
+		return true;
+	}
+	return false;
+}
+
+/* parseLine() - Converts the numbers on a line, up to 'maxValues' of them */
+/* Returns how many numbers the line holds, ignoring any comment - */
+int TrackParser::parseLine(const char *first, const char *last, float *values, const int maxValues)
+{
+	int numValues = 0;
+	const char *p = first;
+	for(;;)
+	{
+		while( p != last && *p <= ' ' )
+			++p;
+		if( p == last || *p == '#' )
+			break;
+
+		float value = 0.f;
+		const char *next = parseFloat(p, last, value);
+		if( next == p || (next != last && !isSeparator(*next)) )
+		{
+			const char *tokenEnd = p;
+			while( tokenEnd != last && !isSeparator(*tokenEnd) )
+				++tokenEnd;
+			error("bad number '" + string(p, tokenEnd) + "'");
+		}
+
+		if( numValues < maxValues )
+			values[numValues] = value;
+		++numValues;
+		p = next;
+	}
+	return numValues;
+}
+
+/* nextLine() - Finds the next line in the buffer, refilling it as needed */
+/* Returns false once the whole file has been consumed ----------- */
+bool TrackParser::nextLine(const char *&first, const char *&last)
+{
+	for(;;)
+	{
+		const char *newline = static_cast<const char*>(memchr(cursor, '\n', limit - cursor));
+		if( newline != nullptr )
+		{
+			first  = cursor;
+			last   = newline;
+			cursor = newline + 1;
+			++lineNumber;
+			return true;
+		}
+
+		if( atEof )
+		{
+			if( cursor == limit )
+				return false;
+
+			// Last line without a trailing newline
+			first  = cursor;
+			last   = limit;
+			cursor = limit;
+			++lineNumber;
+			return true;
+		}
+
+		// Keep the partial line, growing the buffer if a single line fills it
+		const size_t remaining = limit - cursor;
+		memmove(&buffer[0], cursor, remaining);
+		if( remaining == buffer.size() )
+			buffer.resize(buffer.size() * 2);
+
+		const size_t numRead = fread(&buffer[remaining], 1, buffer.size() - remaining, file);
+		cursor = &buffer[0];
+		limit  = cursor + remaining + numRead;
+		if( numRead == 0 )
+		{
+			if( ferror(file) )
+				error("read failed");
+			atEof = true;
+		}
+	}
+}
+
+/* error() - Throws a TrackParseError for the current line ------- */
+void TrackParser::error(const string& message) const
+{
+	stringstream ss;
+	ss << "Error - " << filename << "(" << lineNumber << "): " << message;
+	throw TrackParseError(ss.str(), lineNumber);
+}
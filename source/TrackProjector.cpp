@@ -0,0 +1,328 @@
+/*
+ * TrackProjector.cpp
+ */
+#include "TrackProjector.h"
+#include "CurveSegments.h"
+#include "Threads.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+using std::vector;
+
+
+const float TrackProjector::turnPerSample = 0.5f;
+const int   TrackProjector::maxIterations = 6;
+
+static const int   maxTreeDepth    = 64;      // traversal stack size
+static const int   pointsPerChunk  = 1024;
+static const float tEpsilon        = 1e-5f;
+
+
+/* turnAngle() - Angle between unit vectors 'a' and 'b' ---------- */
+static inline float turnAngle(const Vec3f& a, const Vec3f& b)
+{
+	return std::acos((std::min)(1.f, (std::max)(-1.f, dot(a, b))));
+}
+
+/* distanceSq() - Squared distance from 'point' to 'box' ---------- */
+static inline float distanceSq(const BoundingBox& box, const float point[3])
+{
+	const float *lo = box.minimum.v();
+	const float *hi = box.maximum.v();
+
+	float sum = 0.f;
+	for(int axis = 0; axis < 3; ++axis)
+	{
+		const float below = lo[axis] - point[axis];
+		const float above = point[axis] - hi[axis];
+		if(      below > 0.f ) sum += below * below;
+		else if( above > 0.f ) sum += above * above;
+	}
+	return sum;
+}
+
+/* distanceSq() - Squared distance from 'point' to the cubic at t */
+static inline float distanceSq(const TrackProjector::Cubic& cubic, const float point[3], const float t)
+{
+	float sum = 0.f;
+	for(int axis = 0; axis < 3; ++axis)
+	{
+		const float *c = cubic.c[axis];
+		const float d  = ((c[3] * t + c[2]) * t + c[1]) * t + c[0] - point[axis];
+		sum += d * d;
+	}
+	return sum;
+}
+
+/* refine() - Newton's method on the derivative of the squared ---- */
+/* distance from 'point' to the cubic, starting from t, returns ---- */
+/* the squared distance at the t it finishes at -------------------- */
+static float refine(const TrackProjector::Cubic& cubic, const float point[3], float& t)
+{
+	// f(t) = (p(t) - q).p'(t), f'(t) = p'(t).p'(t) + (p(t) - q).p''(t)
+	for(int i = 0; i < TrackProjector::maxIterations; ++i)
+	{
+		float f = 0.f, speedSq = 0.f, bend = 0.f;
+		for(int axis = 0; axis < 3; ++axis)
+		{
+			const float *c = cubic.c[axis];
+			const float d  = ((c[3] * t + c[2]) * t + c[1]) * t + c[0] - point[axis];
+			const float d1 = (3.f * c[3] * t + 2.f * c[2]) * t + c[1];
+			const float d2 = 6.f * c[3] * t + 2.f * c[2];
+			f       += d * d1;
+			speedSq += d1 * d1;
+			bend    += d * d2;
+		}
+
+		// Where the curve bends away faster than it approaches, f'(t)
+		// isn't positive, so fall back to the Gauss-Newton step
+		const float df = (speedSq + bend > 0.f) ? speedSq + bend : speedSq;
+		if( df <= 0.f )
+			break;
+
+		const float next = (std::min)(1.f, (std::max)(0.f, t - f / df));
+		const bool  done = std::fabs(next - t) < tEpsilon;
+		t = next;
+		if( done )
+			break;
+	}
+	return distanceSq(cubic, point, t);
+}
+
+/* ==================================================================
+ * TrackProjector class
+ * ==================================================================
+ */
+TrackProjector::TrackProjector()
+	: cubics()
+	, boxes()
+	, tree()
+	, curve(nullptr)
+	, revision(0)
+	, batchPoints(nullptr)
+	, batchResults(nullptr)
+	, numChunks(0)
+{ }
+
+/* project() - Finds the closest point on the track to 'point' ---- */
+TrackProjection TrackProjector::project(Curve& trackCurve, const Vec3f& point)
+{
+	update(trackCurve);
+
+	TrackProjection result;
+	projectPoint(point, -1, result);
+	return result;
+}
+
+/* project() - Finds the closest point on the track to each of ---- */
+/* 'points', in parallel ------------------------------------------ */
+void TrackProjector::project(Curve& trackCurve, const vector<Vec3f>& points,
+							 vector<TrackProjection>& results)
+{
+	update(trackCurve);
+
+	results.resize(points.size());
+	batchPoints  = &points;
+	batchResults = &results;
+	numChunks    = static_cast<int>((points.size() + pointsPerChunk - 1) / pointsPerChunk);
+
+	parallelFor(numChunks, &TrackProjector::projectTask, this);
+
+	batchPoints  = nullptr;
+	batchResults = nullptr;
+}
+
+/* projectTask() - parallelFor task, projects one chunk of points -- */
+void TrackProjector::projectTask(const int index, void *pProjector)
+{
+	TrackProjector *projector = reinterpret_cast<TrackProjector*>(pProjector);
+
+	const vector<Vec3f>&     points  = *projector->batchPoints;
+	vector<TrackProjection>& results = *projector->batchResults;
+
+	const size_t first = static_cast<size_t>(index) * pointsPerChunk;
+	const size_t last  = (std::min)(first + pointsPerChunk, points.size());
+
+	// Batches usually follow the track, so each point starts from
+	// where the last one was closest
+	int hint = -1;
+	for(size_t i = first; i < last; ++i)
+	{
+		projector->projectPoint(points[i], hint, results[i]);
+		hint = results[i].segment;
+	}
+}
+
+/* update() - Rebuilds the segment tables and tree if the curve --- */
+/* has changed since they were built ------------------------------ */
+void TrackProjector::update(Curve& trackCurve)
+{
+	if( curve == &trackCurve && revision == trackCurve.getRevision() )
+		return;
+
+	curve    = &trackCurve;
+	revision = trackCurve.getRevision();
+
+	const int n = curve->numSegments();
+	cubics.resize(n);
+	boxes.resize(n);
+
+	for(int i = 0; i < n; ++i)
+	{
+		// The segment keeps its cubic with its bounds, which are padded
+		// for the rails, so the box is taken from the cubic's own hull
+		const CubicCoefficients& coefficients = curve->getSegment(i)->getCubic();
+		Vec3f hull[4];
+		bezierPoints(coefficients, hull);
+
+		Cubic& cubic = cubics[i];
+		std::copy(&coefficients.c[0][0], &coefficients.c[0][0] + 12, &cubic.c[0][0]);
+
+		// The curve turns no further than its control polygon
+		const Vec3f leg0(normalize(difference(hull[1], hull[0])));
+		const Vec3f leg1(normalize(difference(hull[2], hull[1])));
+		const Vec3f leg2(normalize(difference(hull[3], hull[2])));
+		const float turn = turnAngle(leg0, leg1) + turnAngle(leg1, leg2);
+		cubic.numSamples = (std::min)(static_cast<int>(maxStartSamples),
+			minStartSamples + static_cast<int>(std::ceil(turn / turnPerSample)));
+
+		boxes[i] = BoundingBox();
+		for(int k = 0; k < 4; ++k)
+			boxes[i].add(hull[k]);
+	}
+
+	tree.build(boxes);
+}
+
+/* closestOnSegment() - Finds the t where 'segment' is closest to -- */
+/* 'point', returns the squared distance between them ------------- */
+float TrackProjector::closestOnSegment(const int segment, const float point[3], float& t) const
+{
+	const Cubic& cubic = cubics[segment];
+
+	const int numSamples = cubic.numSamples;
+
+	float sampled[maxStartSamples + 1];
+	for(int k = 0; k <= numSamples; ++k)
+		sampled[k] = distanceSq(cubic, point, static_cast<float>(k) / numSamples);
+
+	// The squared distance can have more than one local minimum, so
+	// refine each one the samples bracket and keep the nearest
+	float best = (std::numeric_limits<float>::max)();
+	for(int k = 0; k <= numSamples; ++k)
+	{
+		if( (k > 0          && sampled[k - 1] < sampled[k])
+		 || (k < numSamples && sampled[k + 1] < sampled[k]) )
+			continue;
+
+		float s = static_cast<float>(k) / numSamples;
+		const float distance = (std::min)(sampled[k], refine(cubic, point, s));
+		if( distance < best )
+		{
+			best = distance;
+			t    = (distance < sampled[k]) ? s : static_cast<float>(k) / numSamples;
+		}
+	}
+	return best;
+}
+
+/* projectPoint() - Finds the closest point on the track to ------- */
+/* 'point' and the track's frame there, trying segment 'hint' ------ */
+/* first (if it isn't -1) so the tree walk can skip more ----------- */
+void TrackProjector::projectPoint(const Vec3f& point, const int hint, TrackProjection& result) const
+{
+	const float *q = point.v();
+
+	float best    = (std::numeric_limits<float>::max)();
+	int   segment = -1;
+	float t       = 0.f;
+
+	if( hint >= 0 )
+	{
+		best    = closestOnSegment(hint, q, t);
+		segment = hint;
+	}
+
+	if( !tree.isEmpty() && distanceSq(tree.getNode(0).bounds, q) < best )
+	{
+		// Nodes waiting to be visited and their distances when pushed
+		int   stack[maxTreeDepth];
+		float stackDistance[maxTreeDepth];
+		int   top = 0;
+		stack[top] = 0;
+		stackDistance[top++] = 0.f;
+		while( top > 0 )
+		{
+			--top;
+			if( stackDistance[top] >= best )
+				continue;
+
+			const SegmentTree::Node& node = tree.getNode(stack[top]);
+			if( node.left >= 0 )
+			{
+				// Visit the nearer child first, so it can prune the other
+				const float left  = distanceSq(tree.getNode(node.left).bounds,  q);
+				const float right = distanceSq(tree.getNode(node.right).bounds, q);
+				const int   nearer = (left < right) ? node.left : node.right;
+				const int   farther = (left < right) ? node.right : node.left;
+				const float nearDistance = (std::min)(left, right);
+				const float farDistance  = (std::max)(left, right);
+				if( farDistance < best )
+				{
+					stack[top] = farther;
+					stackDistance[top++] = farDistance;
+				}
+				if( nearDistance < best )
+				{
+					stack[top] = nearer;
+					stackDistance[top++] = nearDistance;
+				}
+				continue;
+			}
+
+			for(int i = node.first; i < node.first + node.count; ++i)
+			{
+				const int other = tree.segment(i);
+				if( other == hint || distanceSq(boxes[other], q) >= best )
+					continue;
+
+				float s;
+				const float distance = closestOnSegment(other, q, s);
+				if( distance < best )
+				{
+					best    = distance;
+					segment = other;
+					t       = s;
+				}
+			}
+		}
+	}
+
+	result.segment = segment;
+	result.t       = t;
+	if( segment < 0 )
+	{
+		result.distance = (std::numeric_limits<float>::max)();
+		result.point = result.direction = result.up = result.side = Vec3f();
+		return;
+	}
+
+	const Cubic& cubic = cubics[segment];
+	float p[3], d[3];
+	for(int axis = 0; axis < 3; ++axis)
+	{
+		const float *c = cubic.c[axis];
+		p[axis] = ((c[3] * t + c[2]) * t + c[1]) * t + c[0];
+		d[axis] = (3.f * c[3] * t + 2.f * c[2]) * t + c[1];
+	}
+
+	// Same frame as the rails are drawn with
+	result.distance  = std::sqrt(best);
+	result.point     = Vec3f(p[0], p[1], p[2]);
+	result.direction = normalize(Vec3f(d[0], d[1], d[2]));
+	result.side      = normalize(cross(result.direction, normalize(curve->getSegment(segment)->getOrientation(t))));
+	result.up        = cross(result.side, result.direction);
+}
@@ -0,0 +1,282 @@
+/*
+ * TrainSimulation.cpp
+ */
+#include "TrainSimulation.h"
+#include "Curve.h"
+#include "PackedPoints.h"
+
+#include <cmath>
+#include <ctime>
+
+
+TrainPose::TrainPose()
+	: valid(false)
+	, t(0.f)
+	, position()
+	, tangent(0.f, 0.f, 1.f)
+	, normal(0.f, 1.f, 0.f)
+	, binormal(1.f, 0.f, 0.f)
+	, revision(0)
+	, positions(0)
+{ }
+
+
+/* ==================================================================
+ * TrainSimulation class
+ * ==================================================================
+ */
+const int TrainSimulation::stepsPerSecond = 30;
+
+TrainSimulation::TrainSimulation()
+	: curve(nullptr)
+	, thread()
+	, stopping(0)
+	, commands()
+	, poses()
+	, overflow()
+	, positionsPosted(0)
+	, t(0.f)
+	, speed(0.f)
+	, animating(false)
+	, arcLength(false)
+	, positionsApplied(0)
+{ }
+
+TrainSimulation::~TrainSimulation()
+{
+	stop();
+}
+
+/* start() - Starts stepping the train from 't' on 'curve', which -- */
+/* has to outlive the simulation ----------------------------------- */
+void TrainSimulation::start(const Curve& simulatedCurve, const float startT, const float startSpeed,
+							const bool startAnimating, const bool startArcLength)
+{
+	if( isRunning() )
+		return;
+
+	curve     = &simulatedCurve;
+	t         = startT;
+	speed     = startSpeed;
+	animating = startAnimating;
+	arcLength = startArcLength;
+	stopping  = 0;
+
+	thread.start(&TrainSimulation::run, this);
+}
+
+/* stop() - Stops the simulation thread and waits for it ----------- */
+void TrainSimulation::stop()
+{
+	InterlockedExchange(&stopping, 1);
+	thread.join();
+}
+
+/* post() - Queues a command for the simulation's next step ------- */
+/* If the queue is full it waits for flush(), merged into the last - */
+/* waiting command if that's the same kind, so nothing is lost ----- */
+/* Only ever called from the interface thread ---------------------- */
+void TrainSimulation::post(const CommandType type, const float value)
+{
+	Command command;
+	command.type  = type;
+	command.value = value;
+
+	flush();
+	if( !overflow.empty() && overflow.back().type == type )
+	{
+		// Steps add up, anything else is only the latest value
+		if( type == step ) overflow.back().value += value;
+		else               overflow.back().value  = value;
+		return;
+	}
+
+	if( type == setPosition )
+		++positionsPosted;
+	if( !overflow.empty() || !commands.push(command) )
+		overflow.push_back(command);
+}
+
+/* flush() - Moves the commands waiting for room into the queue ---- */
+/* Only ever called from the interface thread ---------------------- */
+void TrainSimulation::flush()
+{
+	size_t sent = 0;
+	while( sent < overflow.size() && commands.push(overflow[sent]) )
+		++sent;
+
+	overflow.erase(overflow.begin(), overflow.begin() + sent);
+}
+
+/* readPose() - Copies the latest pose the simulation handed over, -- */
+/* returns false if there hasn't been one yet, or it was placed ---- */
+/* before the last position posted was applied --------------------- */
+/* Only ever called from the interface thread ---------------------- */
+bool TrainSimulation::readPose(TrainPose& pose)
+{
+	poses.acquire();
+	if( !poses.getFront().valid || poses.getFront().positions != positionsPosted )
+		return false;
+
+	pose = poses.getFront();
+	return true;
+}
+
+/* run() - Thread function, runs the simulation until stopped ------ */
+void TrainSimulation::run(void *pSimulation)
+{
+	reinterpret_cast<TrainSimulation*>(pSimulation)->simulate();
+}
+
+/* simulate() - Steps the train at a fixed rate, without trying to - */
+/* catch up if it ever falls behind -------------------------------- */
+void TrainSimulation::simulate()
+{
+	const clock_t interval = CLOCKS_PER_SEC / stepsPerSecond;
+
+	unsigned int placedRevision  = 0;
+	unsigned int placedPositions = positionsApplied;
+	float        placedT         = -1.f;
+	clock_t      next           = clock();
+
+	while( stopping == 0 )
+	{
+		const CurveSnapshotPtr snapshot(curve->getSnapshot());
+		const bool onTrack = snapshot && snapshot->numSegments() > 0;
+
+		Command command;
+		while( commands.pop(command) )
+		{
+			switch(command.type)
+			{
+			case setAnimating: animating = (command.value != 0.f); break;
+			case setArcLength: arcLength = (command.value != 0.f); break;
+			case setSpeed:     speed     = command.value;          break;
+			case setPosition:  t         = command.value; ++positionsApplied; break;
+			case step:
+				if( onTrack )
+					t = advance(*snapshot, t, command.value, speed, arcLength);
+				break;
+			}
+		}
+
+		if( onTrack )
+		{
+			if( animating )
+				t = advance(*snapshot, t, 1.f, speed, arcLength);
+
+			// Points may have been deleted from under the train
+			const float length = static_cast<float>(snapshot->numSegments());
+			if( t >= length || t < 0.f )
+				t = 0.f;
+
+			// A new position is handed over even if it's where the train
+			// already was, so the interface knows it's been applied
+			if( t != placedT || snapshot->getRevision() != placedRevision
+				|| positionsApplied != placedPositions )
+			{
+				poses.getBack() = poseAt(*snapshot, t);
+				poses.getBack().positions = positionsApplied;
+				poses.publish();
+
+				placedT         = t;
+				placedRevision  = snapshot->getRevision();
+				placedPositions = positionsApplied;
+			}
+		}
+
+		next += interval;
+		const clock_t now = clock();
+		if( next > now )
+			Sleep(static_cast<DWORD>((next - now) * 1000 / CLOCKS_PER_SEC));
+		else
+			next = now;
+	}
+}
+
+/* trackPoseAt() - The train's pose at 't' on 'curve', a snapshot -- */
+/* or packed points, which answer the same calls ------------------- */
+template<class Track>
+static TrainPose trackPoseAt(const Track& curve, const float t)
+{
+	TrainPose pose;
+	if( curve.numSegments() == 0 )
+		return pose;
+
+	const float length = static_cast<float>(curve.numSegments());
+	const float wrapped = (t >= 0.f && t < length) ? t : 0.f;
+
+	pose.valid    = true;
+	pose.t        = wrapped;
+	pose.position = curve.getPosition(wrapped);
+	pose.tangent  = normalize(curve.getDirection(wrapped));
+
+	Vec3f normal;
+	if( curve.getCurveType() != lines )
+		normal = curve.getOrientation(wrapped);
+	else // lines shouldn't interpolate orientation
+		normal = curve.getPoint(static_cast<int>(std::floor(wrapped))).orient();
+
+	pose.binormal = normalize(cross(normal, pose.tangent));
+	pose.normal   = normalize(cross(pose.tangent, pose.binormal));
+	return pose;
+}
+
+/* trackAdvance() - Moves 't' along 'curve' by 'steps' simulation --- */
+/* steps at 'speed', either evenly in t or evenly along the track -- */
+template<class Track>
+static float trackAdvance(const Track& curve, const float t, const float steps,
+						  const float speed, const bool arcLength)
+{
+	const float length = static_cast<float>(curve.numSegments());
+
+	float next = t;
+	if( arcLength )
+	{
+		float ahead = t + 0.1f;
+		if( ahead >= length )
+			ahead -= length;
+
+		const float distance = magnitude(difference(curve.getPosition(ahead), curve.getPosition(t)));
+		if( distance > 0.f )
+			next += steps * speed * 0.07f / distance;
+	}
+	else
+	{
+		next += steps * speed * 0.01f;
+	}
+
+	if( next >= length )
+		next = 0.f;
+	if( next < 0.f )
+		next += length;
+	return next;
+}
+
+/* poseAt() - The train's pose at 't' on 'curve' ------------------- */
+TrainPose TrainSimulation::poseAt(const CurveSnapshot& curve, const float t)
+{
+	TrainPose pose(trackPoseAt(curve, t));
+	if( pose.valid )
+		pose.revision = curve.getRevision();
+	return pose;
+}
+
+TrainPose TrainSimulation::poseAt(const PackedPoints& track, const float t)
+{
+	return trackPoseAt(track, t);
+}
+
+/* advance() - Moves 't' along 'curve' by 'steps' simulation steps - */
+/* at 'speed', either evenly in t or evenly along the track -------- */
+float TrainSimulation::advance(const CurveSnapshot& curve, const float t, const float steps,
+							   const float speed, const bool arcLength)
+{
+	return trackAdvance(curve, t, steps, speed, arcLength);
+}
+
+float TrainSimulation::advance(const PackedPoints& track, const float t, const float steps,
+							   const float speed, const bool arcLength)
+{
+	return trackAdvance(track, t, steps, speed, arcLength);
+}
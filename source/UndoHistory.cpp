@@ -0,0 +1,326 @@
+/*
+ * UndoHistory.cpp
+ */
+#include "UndoHistory.h"
+#include "Curve.h"
+
+#include <vector>
+
+using std::vector;
+
+
+UndoHistory::UndoHistory(const size_t memoryBudget)
+	: steps()
+	, position(0)
+	, current()
+	, currentType(lines)
+	, currentTension(1.f)
+	, pending()
+	, stepDepth(0)
+	, applying(false)
+	, memoryUsed(0)
+	, memoryBudget(memoryBudget)
+{
+	pending.kind = noEdits;
+}
+
+/* reset() - Forgets every step, 'curve' becomes the oldest state - */
+void UndoHistory::reset(const Curve& curve)
+{
+	// Whatever an open step held is gone with the rest
+	stepDepth      = 0;
+	pending.kind   = noEdits;
+	pending.before = PointTree();
+
+	steps.clear();
+	position   = 0;
+	memoryUsed = 0;
+
+	current        = PointTree(curve.getControlPoints());
+	currentType    = curve.getCurveType();
+	currentTension = curve.tension;
+}
+
+/* recordReplace() - Records a step for all of the curve's points - */
+/* being replaced at once, such as by loading a track ------------ */
+void UndoHistory::recordReplace(const Curve& curve)
+{
+	closeSteps();
+
+	Step step;
+	step.kind          = replaceCurve;
+	step.index         = 0;
+	step.before        = current;
+	step.typeBefore    = currentType;
+	step.tensionBefore = currentTension;
+	step.bytes         = 0;
+
+	current        = PointTree(curve.getControlPoints(), &step.bytes);
+	currentType    = curve.getCurveType();
+	currentTension = curve.tension;
+
+	step.after        = current;
+	step.typeAfter    = currentType;
+	step.tensionAfter = currentTension;
+	push(step);
+}
+
+/* beginStep() - Groups the edits until the matching endStep() --- */
+/* into one step. Calls may be nested ---------------------------- */
+void UndoHistory::beginStep()
+{
+	if( stepDepth++ > 0 )
+		return;
+
+	pending.kind          = noEdits;
+	pending.index         = 0;
+	pending.before        = current;
+	pending.typeBefore    = currentType;
+	pending.tensionBefore = currentTension;
+	pending.bytes         = 0;
+}
+
+/* endStep() - Records the edits since beginStep() as one step ---- */
+void UndoHistory::endStep()
+{
+	if( stepDepth == 0 || --stepDepth > 0 )
+		return;
+
+	if( pending.kind != noEdits )
+	{
+		pending.after        = current;
+		pending.typeAfter    = currentType;
+		pending.tensionAfter = currentTension;
+		push(pending);
+	}
+
+	// Don't hold on to the old points until the next step
+	pending.before = PointTree();
+	pending.after  = PointTree();
+}
+
+/* closeSteps() - Ends every open step, recording its edits as if - */
+/* each beginStep() had had its endStep(). For when the event that - */
+/* would have ended one, like a drag's mouse release, never comes -- */
+void UndoHistory::closeSteps()
+{
+	if( stepDepth == 0 )
+		return;
+
+	stepDepth = 1;
+	endStep();
+}
+
+/* pointChanged() - The point at 'index' was moved or reoriented -- */
+void UndoHistory::pointChanged(const int index, const CtrlPoint& point)
+{
+	if( applying )
+		return;
+
+	beginStep();
+	edited(editPoints, index, current.set(index, point));
+	endStep();
+}
+
+/* pointInserted() - A point was inserted before 'index' --------- */
+void UndoHistory::pointInserted(const int index, const CtrlPoint& point)
+{
+	if( applying )
+		return;
+
+	beginStep();
+	edited(insertPoint, index, current.insert(index, point));
+	endStep();
+}
+
+/* pointErased() - The point at 'index' was deleted -------------- */
+void UndoHistory::pointErased(const int index)
+{
+	if( applying )
+		return;
+
+	beginStep();
+	edited(deletePoint, index, current.erase(index));
+	endStep();
+}
+
+/* settingsChanged() - The curve type or tension changed --------- */
+void UndoHistory::settingsChanged(const CurveType type, const float tension)
+{
+	if( applying || (type == currentType && tension == currentTension) )
+		return;
+
+	// Another tension change straight after a tension change only
+	// moves where that step ends up
+	if( stepDepth == 0 && position > 0 && position == steps.size() )
+	{
+		Step& last = steps.back();
+		if( last.kind == changeSettings && last.typeBefore == last.typeAfter && type == currentType )
+		{
+			last.tensionAfter = tension;
+			currentTension    = tension;
+			return;
+		}
+	}
+
+	beginStep();
+	currentType    = type;
+	currentTension = tension;
+	edited(changeSettings, 0, 0);
+	endStep();
+}
+
+/* edited() - Folds one edit into the pending step --------------- */
+/* Every step keeps the settings, so a settings change only makes - */
+/* a step of its own if nothing else is in it --------------------- */
+void UndoHistory::edited(const StepKind kind, const int index, const size_t bytes)
+{
+	pending.bytes += bytes;
+
+	if( kind == changeSettings )
+	{
+		if( pending.kind == noEdits )
+			pending.kind = changeSettings;
+	}
+	else if( pending.kind == noEdits || pending.kind == changeSettings )
+	{
+		pending.kind  = kind;
+		pending.index = index;
+	}
+	else if( pending.kind != editPoints || kind != editPoints )
+	{
+		// More than one insert or delete can only be undone wholesale
+		pending.kind = replacePoints;
+	}
+}
+
+/* push() - Makes 'step' the most recent step, dropping any that -- */
+/* could have been redone, then the oldest ones over the budget --- */
+void UndoHistory::push(const Step& step)
+{
+	while( steps.size() > position )
+	{
+		memoryUsed -= steps.back().bytes;
+		steps.pop_back();
+	}
+
+	steps.push_back(step);
+	++position;
+	memoryUsed += step.bytes;
+	trim();
+}
+
+/* trim() - Drops the oldest steps until the history fits the ----- */
+/* budget, though the most recent step is always kept ------------- */
+void UndoHistory::trim()
+{
+	size_t numDropped = 0;
+	while( memoryUsed > memoryBudget && steps.size() - numDropped > 1 && numDropped < position )
+		memoryUsed -= steps[numDropped++].bytes;
+
+	steps.erase(steps.begin(), steps.begin() + numDropped);
+	position -= numDropped;
+}
+
+/* setMemoryBudget() - Sets roughly how much memory the steps may - */
+/* hold on to ---------------------------------------------------- */
+void UndoHistory::setMemoryBudget(const size_t bytes)
+{
+	memoryBudget = bytes;
+	trim();
+}
+
+/* undo() - Takes the curve back to before the most recent step ---- */
+UndoHistory::Result UndoHistory::undo(Curve& curve)
+{
+	if( !canUndo() || stepDepth > 0 )
+		return nothingDone;
+
+	return apply(curve, steps[--position], false);
+}
+
+/* redo() - Takes the curve forward through the next undone step -- */
+UndoHistory::Result UndoHistory::redo(Curve& curve)
+{
+	if( !canRedo() || stepDepth > 0 )
+		return nothingDone;
+
+	return apply(curve, steps[position++], true);
+}
+
+/* apply() - Moves the curve from one side of 'step' to the other - */
+/* Points are edited in place where the step allows, so only ------ */
+/* their segments are rebuilt, anything else replaces all of them, - */
+/* and the curve type and tension are restored whatever the step -- */
+UndoHistory::Result UndoHistory::apply(Curve& curve, const Step& step, const bool forward)
+{
+	const PointTree& from = forward ? step.before : step.after;
+	const PointTree& to   = forward ? step.after  : step.before;
+
+	Result result = pointsEdited;
+	vector<int> changed;
+
+	applying = true;
+	curve.beginEdit();
+
+	switch(step.kind)
+	{
+	case editPoints:
+		// (set() never reshapes a tree, so the diff should always work)
+		if( !PointTree::diff(from, to, changed) )
+		{
+			result = pointsReplaced;
+			break;
+		}
+		for each(auto i in changed)
+		{
+			const CtrlPoint& p = to.at(i);
+			curve.moveControlPoint(i, p.pos());
+			curve.orientControlPoint(i, p.orient());
+		}
+		break;
+
+	case insertPoint:
+		if( forward ) curve.insertControlPoint(step.index, to.at(step.index));
+		else          curve.delControlPoint(step.index);
+		break;
+
+	case deletePoint:
+		if( forward ) curve.delControlPoint(step.index);
+		else          curve.insertControlPoint(step.index, to.at(step.index));
+		break;
+
+	case changeSettings:
+		break;
+
+	case replaceCurve:
+		result = curveReplaced;
+		break;
+
+	default:
+		result = pointsReplaced;
+		break;
+	}
+
+	if( result != pointsEdited )
+	{
+		ControlPointVector points;
+		to.copyTo(points);
+		curve.swapPoints(points);
+	}
+
+	const CurveType type    = forward ? step.typeAfter    : step.typeBefore;
+	const float     tension = forward ? step.tensionAfter : step.tensionBefore;
+	if( curve.getCurveType() != type )
+		curve.setCurveType(type);
+	if( curve.tension != tension )
+		curve.setTension(tension);
+
+	curve.commitEdit();
+	applying = false;
+
+	current        = to;
+	currentType    = curve.getCurveType();
+	currentTension = curve.tension;
+	return result;
+}
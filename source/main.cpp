@@ -12,6 +12,8 @@
  *          Matthew Bayer
  */
 #include "MainWindow.h"
+#include "CommandLine.h"
+#include "JobSystem.h"
 
 #pragma warning(push)
 #pragma warning(disable:4312)
@@ -31,6 +33,14 @@ int main(int argc, char* argv[])
 	using std::endl;
 
 	cout << "CS559 - Project 2 - Train on a track" << endl;
+
+	// Start the workers before any other thread could ask for them
+	JobSystem::get();
+
+	// Batch modes (see CommandLine.h) run without showing the window
+	if( argc > 1 && isCommand(argv[1]) )
+		return runCommand(argc, argv);
+
 	if( argc > 3 )
 	{
 		cout << "Invalid number of arguments." << endl
@@ -45,9 +55,10 @@ int main(int argc, char* argv[])
 	if( argc > 1 )
 	{
 		const std::string inputTrackFilename(argv[1]);
-		window.loadPoints(inputTrackFilename);
+		window.loadPointsAsync(inputTrackFilename);
 	}
 
+	window.startSimulation();
 	window.show();
 	Fl::run();
 